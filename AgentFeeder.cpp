@@ -26,17 +26,22 @@
 
 void AgentFeeder::feed(NoteHypothesis::Estimate e)
 {
+    m_inNote = false;
+
     if (m_haveCurrent) {
         if (m_current.accept(e)) {
+            m_inNote = true;
+            if (m_sink) m_sink->onEstimate(e);
             return;
         }
         if (m_current.getState() == NoteHypothesis::Expired) {
-            m_accepted.push_back(m_current);
+            complete(m_current);
             m_haveCurrent = false;
         }
     }
 
     bool swallowed = false;
+    int offered = m_candidates.size();
 
     Hypotheses newCandidates;
 
@@ -64,6 +69,9 @@ void AgentFeeder::feed(NoteHypothesis::Estimate e)
                         m_current.getState() == NoteHypothesis::Rejected) {
                         m_current = h;
                         m_haveCurrent = true;
+                        m_inNote = true;
+                        begin(m_current);
+                        --offered; // promoted, not rejected
                     } else {
                         newCandidates.push_back(h);
                     }
@@ -76,13 +84,17 @@ void AgentFeeder::feed(NoteHypothesis::Estimate e)
     }
     
     if (!swallowed) {
-        NoteHypothesis h;
+        NoteHypothesis h(m_rules);
         if (h.accept(e)) {
             newCandidates.push_back(h);
+            ++offered;
         }
     }
     
     m_candidates = reap(newCandidates);
+
+    TRACKER_STATS_ADD(m_stats, hypothesesRejected,
+                      offered - (int)m_candidates.size());
 }
 
 AgentFeeder::Hypotheses
@@ -107,7 +119,29 @@ void
 AgentFeeder::finish()
 {
     if (m_current.getState() == NoteHypothesis::Satisfied) {
-	m_accepted.push_back(m_current);
+        complete(m_current);
+    }
+}
+
+void
+AgentFeeder::begin(const NoteHypothesis &h)
+{
+    if (!m_sink) return;
+    m_sink->onNoteOn(h.getAveragedNote());
+    NoteHypothesis::Estimates es = h.getAcceptedEstimates();
+    for (int i = 0; i < (int)es.size(); ++i) {
+        m_sink->onEstimate(es[i]);
+    }
+}
+
+void
+AgentFeeder::complete(const NoteHypothesis &h)
+{
+    if (m_sink) {
+        m_sink->onNoteComplete(h.getAveragedNote());
+    } else {
+        m_accepted.push_back(h);
     }
+    TRACKER_STATS_ADD(m_stats, hypothesesAccepted, 1);
 }
 
@@ -26,6 +26,8 @@
 #define _AGENT_FEEDER_H_
 
 #include "NoteHypothesis.h"
+#include "ResultSink.h"
+#include "TrackerStats.h"
 
 #include <vector>
 
@@ -45,11 +47,24 @@
  * observations have been provided. The set of hypotheses returned by
  * getAcceptedHypotheses() will not be complete unless finish() has
  * been called.
+ *
+ * If a TrackerStats object is provided through setStats(), the
+ * candidate, acceptance and rejection counters in it will be updated
+ * as observations are fed (only in builds with WITH_TRACKER_STATS).
+ *
+ * The hypotheses follow the rules given on construction, by default
+ * those the plugin uses.
+ *
+ * If a ResultSink is provided through setSink(), each note and its
+ * estimates are passed to it as they are accepted, and the accepted
+ * hypotheses are not kept: getAcceptedHypotheses() remains empty.
  */
 class AgentFeeder
 {
 public:
-    AgentFeeder() : m_haveCurrent(false) { }
+    AgentFeeder(const NoteHypothesis::Rules &rules = NoteHypothesis::Rules()) :
+        m_rules(rules), m_current(rules), m_haveCurrent(false),
+        m_inNote(false), m_stats(0), m_sink(0) { }
 
     void feed(NoteHypothesis::Estimate);
     void finish();
@@ -62,11 +77,48 @@ public:
 
     Hypotheses reap(Hypotheses);
 
+    /**
+     * Return true if the most recent observation was accepted by a
+     * satisfied hypothesis, i.e. we are part way through a stable
+     * note.
+     */
+    bool isInNote() const {
+        return m_inNote;
+    }
+
+    /**
+     * If we are part way through a note (see isInNote()), return the
+     * mean frequency of the accepted hypothesis for that note so
+     * far. Otherwise return 0.
+     */
+    double getNoteFrequency() const {
+        return m_inNote ? m_current.getMeanFrequency() : 0.0;
+    }
+
+    int getCandidateCount() const {
+        return m_candidates.size();
+    }
+
+    void setStats(TrackerStats *stats) {
+        m_stats = stats;
+    }
+
+    void setSink(ResultSink *sink) {
+        m_sink = sink;
+    }
+
 private:
+    NoteHypothesis::Rules m_rules;
     Hypotheses m_candidates;
     NoteHypothesis m_current;
     bool m_haveCurrent;
+    bool m_inNote;
     Hypotheses m_accepted;
+    TrackerStats *m_stats;
+    ResultSink *m_sink;
+
+    void begin(const NoteHypothesis &h);
+    void complete(const NoteHypothesis &h);
 };
 
 
@@ -0,0 +1,252 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "AudioFile.h"
+
+#include <cstring>
+#include <cstdint>
+
+using std::string;
+
+static unsigned int
+readLE(const unsigned char *p, int bytes)
+{
+    unsigned int v = 0;
+    for (int i = bytes - 1; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+AudioFile::AudioFile() :
+    m_data(0),
+    m_sampleRate(0),
+    m_channels(0),
+    m_frames(0),
+    m_encoding(Float32),
+    m_bytesPerSample(4)
+{
+}
+
+AudioFile::~AudioFile()
+{
+    close();
+}
+
+void
+AudioFile::close()
+{
+    m_file.close();
+    m_data = 0;
+    m_sampleRate = 0;
+    m_channels = 0;
+    m_frames = 0;
+}
+
+bool
+AudioFile::map(string path)
+{
+    close();
+    m_error = "";
+
+    // The file is read from start to end, once
+    if (!m_file.open(path, MappedFile::Sequential)) {
+        m_error = m_file.getError();
+        return false;
+    }
+    return true;
+}
+
+bool
+AudioFile::open(string path)
+{
+    if (!map(path)) return false;
+    if (!parseWave()) {
+        m_error = path + ": " + m_error;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool
+AudioFile::openRaw(string path, float sampleRate, int channels)
+{
+    if (sampleRate <= 0 || channels < 1) {
+        m_error = "Raw input needs a sample rate and channel count";
+        return false;
+    }
+    if (!map(path)) return false;
+    m_data = m_file.getData();
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_encoding = Float32;
+    m_bytesPerSample = 4;
+    m_frames = m_file.getSize() / (4 * channels);
+    return true;
+}
+
+bool
+AudioFile::parseWave()
+{
+    const unsigned char *base = m_file.getData();
+    size_t size = m_file.getSize();
+
+    if (size < 12 ||
+        memcmp(base, "RIFF", 4) || memcmp(base + 8, "WAVE", 4)) {
+        m_error = "Not a RIFF WAVE file";
+        return false;
+    }
+
+    bool haveFormat = false;
+    int format = 0, bits = 0;
+    size_t pos = 12;
+    size_t dataLength = 0;
+
+    while (pos + 8 <= size) {
+
+        const unsigned char *chunk = base + pos;
+        size_t length = readLE(chunk + 4, 4);
+
+        if (!memcmp(chunk, "fmt ", 4) && length >= 16 &&
+            pos + 8 + length <= size) {
+            format = readLE(chunk + 8, 2);
+            m_channels = readLE(chunk + 10, 2);
+            m_sampleRate = readLE(chunk + 12, 4);
+            bits = readLE(chunk + 22, 2);
+            if (format == 0xfffe && length >= 26) {
+                // Extensible: the real format is the first two bytes
+                // of the subformat GUID
+                format = readLE(chunk + 32, 2);
+            }
+            haveFormat = true;
+        }
+
+        if (!memcmp(chunk, "data", 4)) {
+            if (!haveFormat) {
+                m_error = "Data chunk comes before format chunk";
+                return false;
+            }
+            // Tolerate a truncated file, or a streamed one whose
+            // header was never filled in, by taking what is there
+            if (pos + 8 + length > size || length == 0) {
+                length = size - (pos + 8);
+            }
+            m_data = chunk + 8;
+            dataLength = length;
+            break;
+        }
+
+        pos += 8 + length + (length & 1);
+    }
+
+    if (!m_data) {
+        m_error = "No data chunk found";
+        return false;
+    }
+
+    if (format == 1 && bits == 16) m_encoding = Int16;
+    else if (format == 1 && bits == 24) m_encoding = Int24;
+    else if (format == 1 && bits == 32) m_encoding = Int32;
+    else if (format == 3 && bits == 32) m_encoding = Float32;
+    else if (format == 3 && bits == 64) m_encoding = Float64;
+    else {
+        m_error = "Unsupported sample format";
+        return false;
+    }
+
+    if (m_channels < 1 || m_sampleRate <= 0) {
+        m_error = "Invalid channel count or sample rate";
+        return false;
+    }
+
+    // Only the data chunk is audio: metadata chunks (LIST, id3, cue)
+    // often follow it
+    m_bytesPerSample = bits / 8;
+    m_frames = dataLength / (m_bytesPerSample * m_channels);
+    return true;
+}
+
+const float *
+AudioFile::getMonoFloatData() const
+{
+    // WAVE data is little-endian, as is every machine we build for
+    if (m_data && m_channels == 1 && m_encoding == Float32 &&
+        (uintptr_t(m_data) % sizeof(float)) == 0) {
+        return (const float *)m_data;
+    }
+    return 0;
+}
+
+double
+AudioFile::sampleAt(const unsigned char *p) const
+{
+    switch (m_encoding) {
+    case Int16:
+        return int16_t(readLE(p, 2)) / 32768.0;
+    case Int24:
+        return (int32_t(readLE(p, 3) << 8) >> 8) / 8388608.0;
+    case Int32:
+        return int32_t(readLE(p, 4)) / 2147483648.0;
+    case Float32: {
+        float f;
+        memcpy(&f, p, 4);
+        return f;
+    }
+    case Float64: {
+        double d;
+        memcpy(&d, p, 8);
+        return d;
+    }
+    }
+    return 0.0;
+}
+
+void
+AudioFile::readMono(long from, long count, float *out, int channel) const
+{
+    int frameBytes = m_bytesPerSample * m_channels;
+
+    for (long i = 0; i < count; ++i) {
+
+        long frame = from + i;
+        if (frame < 0 || frame >= m_frames) {
+            out[i] = 0.f;
+            continue;
+        }
+
+        const unsigned char *p = m_data + frame * frameBytes;
+
+        if (channel >= 0 && channel < m_channels) {
+            out[i] = float(sampleAt(p + channel * m_bytesPerSample));
+        } else {
+            double sum = 0.0;
+            for (int c = 0; c < m_channels; ++c) {
+                sum += sampleAt(p + c * m_bytesPerSample);
+            }
+            out[i] = float(sum / m_channels);
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _AUDIO_FILE_H_
+#define _AUDIO_FILE_H_
+
+#include "MappedFile.h"
+
+#include <string>
+
+/**
+ * Read-only access to an audio file through a memory mapping, so
+ * that a long file is paged in as it is read rather than loaded up
+ * front.
+ *
+ * Two kinds of file are supported: RIFF WAVE files of 16, 24 or
+ * 32-bit integer PCM or 32 or 64-bit float samples (including the
+ * extensible format), and headerless raw files of 32-bit float
+ * samples in the machine's byte order, for which the sample rate
+ * and channel count must be given. Multi-channel samples are
+ * interleaved, as usual.
+ */
+class AudioFile
+{
+public:
+    AudioFile();
+    ~AudioFile();
+
+    /**
+     * Map a WAVE file. Return false, with a message available from
+     * getError(), if it cannot be opened or is not of a supported
+     * format.
+     */
+    bool open(std::string path);
+
+    /**
+     * Map a raw file of 32-bit float samples at the given rate, with
+     * the given number of interleaved channels.
+     */
+    bool openRaw(std::string path, float sampleRate, int channels = 1);
+
+    void close();
+
+    std::string getError() const { return m_error; }
+
+    float getSampleRate() const { return m_sampleRate; }
+    int getChannelCount() const { return m_channels; }
+    long getFrameCount() const { return m_frames; }
+
+    /**
+     * If the file holds mono 32-bit float samples, return a pointer
+     * to them in the mapping, so that they may be used with no copy
+     * or conversion. Otherwise return 0.
+     */
+    const float *getMonoFloatData() const;
+
+    /**
+     * Convert count sample frames, starting at the given frame, to
+     * mono floats in the range -1 to 1, writing them to out. If
+     * channel is negative, the channels are mixed down by averaging;
+     * otherwise only the given channel is used.
+     */
+    void readMono(long from, long count, float *out, int channel = -1) const;
+
+private:
+    AudioFile(const AudioFile &); // not provided
+    AudioFile &operator=(const AudioFile &); // not provided
+
+    enum Encoding { Int16, Int24, Int32, Float32, Float64 };
+
+    bool map(std::string path);
+    bool parseWave();
+    double sampleAt(const unsigned char *p) const;
+
+    MappedFile m_file;
+    const unsigned char *m_data;
+    float m_sampleRate;
+    int m_channels;
+    long m_frames;
+    Encoding m_encoding;
+    int m_bytesPerSample;
+    std::string m_error;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _AUDIO_FILE_SOURCE_H_
+#define _AUDIO_FILE_SOURCE_H_
+
+#include "AudioFile.h"
+#include "OfflineAnalyser.h"
+
+/**
+ * An AudioFile as the input of an OfflineAnalyser. Mono float input
+ * is used straight from the mapping; anything else is converted a
+ * block at a time as the frames are cut, either mixed down or taking
+ * only the given channel, as for AudioFile::readMono().
+ */
+class AudioFileSource : public OfflineAnalyser::Source
+{
+public:
+    AudioFileSource(const AudioFile &file, int channel = -1) :
+        m_file(file), m_channel(channel) { }
+
+    long getLength() const { return m_file.getFrameCount(); }
+    void read(long from, long count, float *out) const {
+        m_file.readMono(from, count, out, m_channel);
+    }
+    const float *getData() const { return m_file.getMonoFloatData(); }
+
+private:
+    const AudioFile &m_file;
+    int m_channel;
+};
+
+#endif
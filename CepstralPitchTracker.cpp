@@ -21,21 +21,13 @@
     CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
     WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
-
 #include "CepstralPitchTracker.h"
-#include "Cepstrum.h"
-#include "MeanFilter.h"
-#include "PeakInterpolator.h"
-#include "AgentFeeder.h"
-
-#include "vamp-sdk/FFT.h"
+#include "ThreadPool.h"
 
 #include <vector>
 #include <algorithm>
 
-#include <cstdio>
-#include <cmath>
-#include <complex>
+#include <sstream>
 
 using std::string;
 using std::vector;
@@ -47,20 +39,18 @@ CepstralPitchTracker::CepstralPitchTracker(float inputSampleRate) :
     m_channels(0),
     m_stepSize(256),
     m_blockSize(1024),
-    m_fmin(50),
-    m_fmax(900),
-    m_vflen(1),
-    m_binFrom(0),
-    m_binTo(0),
-    m_bins(0),
-    m_nAccepted(0),
-    m_feeder(0)
+    m_pool(0),
+    m_channelOutputBase(0)
 {
+    m_engines.push_back(new PitchTrackerEngine(inputSampleRate));
 }
 
 CepstralPitchTracker::~CepstralPitchTracker()
 {
-    delete m_feeder;
+    for (int c = 0; c < (int)m_engines.size(); ++c) {
+        delete m_engines[c];
+    }
+    delete m_pool;
 }
 
 string
@@ -128,25 +118,95 @@ CepstralPitchTracker::getMinChannelCount() const
 size_t
 CepstralPitchTracker::getMaxChannelCount() const
 {
-    return 1;
+    return 64;
 }
 
 CepstralPitchTracker::ParameterList
 CepstralPitchTracker::getParameterDescriptors() const
 {
     ParameterList list;
+
+    ParameterDescriptor d;
+    d.identifier = "bandlimit";
+    d.name = "Cepstrum bandwidth limit";
+    d.description = "Calculate the cepstrum from only the part of the spectrum below this frequency, using a correspondingly shorter transform. This makes high sample-rate input much cheaper to analyse. Zero means use the whole spectrum.";
+    d.unit = "Hz";
+    d.minValue = 0;
+    d.maxValue = 20000;
+    d.defaultValue = 0;
+    d.isQuantized = false;
+    list.push_back(d);
+
+    d.identifier = "skip";
+    d.name = "Frame skipping within stable notes";
+    d.description = "While a note is stable, calculate the cepstrum only for every Nth frame, interpolating estimates for the frames in between. Any change in pitch or level reverts to analysing every frame. 1 means analyse every frame.";
+    d.unit = "";
+    d.minValue = 1;
+    d.maxValue = 8;
+    d.defaultValue = 1;
+    d.isQuantized = true;
+    d.quantizeStep = 1;
+    list.push_back(d);
+
+    d.identifier = "refine";
+    d.name = "Peak refinement";
+    d.description = "Number of points per cepstral bin at which to evaluate the cepstrum around the peak, to locate it more precisely than the block size alone allows. 1 means no refinement beyond quadratic interpolation.";
+    d.unit = "";
+    d.minValue = 1;
+    d.maxValue = 16;
+    d.defaultValue = 1;
+    d.isQuantized = true;
+    d.quantizeStep = 1;
+    list.push_back(d);
+
+    d.identifier = "dual";
+    d.name = "Dual resolution";
+    d.description = "Estimate higher pitches from a block of half the size, taken from the middle of each input block, for finer time resolution in the upper range.";
+    d.unit = "";
+    d.minValue = 0;
+    d.maxValue = 1;
+    d.defaultValue = 0;
+    d.isQuantized = true;
+    d.quantizeStep = 1;
+    list.push_back(d);
+
+    d.identifier = "narrow";
+    d.name = "Narrow search within notes";
+    d.description = "While a note is in progress, calculate and search the cepstrum only close to the note's pitch, with a full search every few frames or whenever the narrow search fails.";
+    d.unit = "";
+    d.minValue = 0;
+    d.maxValue = 1;
+    d.defaultValue = 0;
+    d.isQuantized = true;
+    d.quantizeStep = 1;
+    list.push_back(d);
+
     return list;
 }
 
 float
 CepstralPitchTracker::getParameter(string identifier) const
 {
+    const PitchTrackerEngine *e = m_engines[0];
+    if (identifier == "bandlimit") return e->getBandLimit();
+    if (identifier == "skip") return e->getSkip();
+    if (identifier == "narrow") return e->getNarrow() ? 1.f : 0.f;
+    if (identifier == "refine") return e->getRefine();
+    if (identifier == "dual") return e->getDual() ? 1.f : 0.f;
     return 0.f;
 }
 
 void
 CepstralPitchTracker::setParameter(string identifier, float value) 
 {
+    for (int c = 0; c < (int)m_engines.size(); ++c) {
+        PitchTrackerEngine *e = m_engines[c];
+        if (identifier == "bandlimit") e->setBandLimit(value);
+        if (identifier == "skip") e->setSkip(int(value + 0.5));
+        if (identifier == "narrow") e->setNarrow(value > 0.5f);
+        if (identifier == "refine") e->setRefine(int(value + 0.5));
+        if (identifier == "dual") e->setDual(value > 0.5f);
+    }
 }
 
 CepstralPitchTracker::ProgramList
@@ -181,8 +241,8 @@ CepstralPitchTracker::getOutputDescriptors() const
     d.hasFixedBinCount = true;
     d.binCount = 1;
     d.hasKnownExtents = true;
-    d.minValue = m_fmin;
-    d.maxValue = m_fmax;
+    d.minValue = m_engines[0]->getMinFrequency();
+    d.maxValue = m_engines[0]->getMaxFrequency();
     d.isQuantized = false;
     d.sampleType = OutputDescriptor::FixedSampleRate;
     d.sampleRate = (m_inputSampleRate / m_stepSize);
@@ -196,17 +256,57 @@ CepstralPitchTracker::getOutputDescriptors() const
     d.hasFixedBinCount = true;
     d.binCount = 1;
     d.hasKnownExtents = true;
-    d.minValue = m_fmin;
-    d.maxValue = m_fmax;
+    d.minValue = m_engines[0]->getMinFrequency();
+    d.maxValue = m_engines[0]->getMaxFrequency();
     d.isQuantized = false;
     d.sampleType = OutputDescriptor::FixedSampleRate;
     d.sampleRate = (m_inputSampleRate / m_stepSize);
     d.hasDuration = true;
     outputs.push_back(d);
 
+#ifdef WITH_TRACKER_STATS
+    d.identifier = "diagnostics";
+    d.name = "Diagnostics";
+    d.description = "Per-frame stage timings in nanoseconds, and hypothesis counters";
+    d.unit = "";
+    d.hasFixedBinCount = true;
+    d.binCount = TrackerStats::StageCount + 4;
+    d.binNames.clear();
+    for (int i = 0; i < TrackerStats::StageCount; ++i) {
+        d.binNames.push_back(TrackerStats::getStageName(TrackerStats::Stage(i)));
+    }
+    d.binNames.push_back("candidates");
+    d.binNames.push_back("accepted");
+    d.binNames.push_back("rejected");
+    d.binNames.push_back("gated");
+    d.hasKnownExtents = false;
+    d.isQuantized = false;
+    d.sampleType = OutputDescriptor::FixedSampleRate;
+    d.sampleRate = (m_inputSampleRate / m_stepSize);
+    d.hasDuration = false;
+    outputs.push_back(d);
+#endif
+
+    // Each channel after the first has its own f0 and notes outputs,
+    // following all of the above
+    OutputDescriptor f0 = outputs[0], notes = outputs[1];
+    for (int c = 1; c < (int)m_channels; ++c) {
+        std::ostringstream n;
+        n << c + 1;
+        d = f0;
+        d.identifier = f0.identifier + "-" + n.str();
+        d.name = f0.name + " (channel " + n.str() + ")";
+        outputs.push_back(d);
+        d = notes;
+        d.identifier = notes.identifier + "-" + n.str();
+        d.name = notes.name + " (channel " + n.str() + ")";
+        outputs.push_back(d);
+    }
+
     return outputs;
 }
 
+
 bool
 CepstralPitchTracker::initialise(size_t channels, size_t stepSize, size_t blockSize)
 {
@@ -221,30 +321,78 @@ CepstralPitchTracker::initialise(size_t channels, size_t stepSize, size_t blockS
     m_stepSize = stepSize;
     m_blockSize = blockSize;
 
-    m_binFrom = int(m_inputSampleRate / m_fmax);
-    m_binTo = int(m_inputSampleRate / m_fmin); 
+    // Channels after the first are each analysed by a separate
+    // engine with the same parameters, and all channels are
+    // processed together across m_pool
 
-    if (m_binTo >= (int)m_blockSize / 2) {
-        m_binTo = m_blockSize / 2 - 1;
+    for (int c = 1; c < (int)m_engines.size(); ++c) {
+        delete m_engines[c];
     }
-    if (m_binFrom >= m_binTo) {
-        // shouldn't happen except for degenerate samplerate / blocksize combos
-        m_binFrom = m_binTo - 1;
+    m_engines.resize(1);
+    delete m_pool;
+    m_pool = 0;
+
+    if (!m_engines[0]->initialise(stepSize, blockSize)) {
+        return false;
     }
 
-    m_bins = (m_binTo - m_binFrom) + 1;
+    if (m_channels > 1) {
+
+        ParameterList params = getParameterDescriptors();
+
+        for (int c = 1; c < (int)m_channels; ++c) {
+            PitchTrackerEngine *e = new PitchTrackerEngine(m_inputSampleRate);
+            if (c < (int)m_sinks.size()) e->setResultSink(m_sinks[c]);
+            e->setNoteRules(m_engines[0]->getNoteRules());
+            m_engines.push_back(e);
+        }
+        for (int i = 0; i < (int)params.size(); ++i) {
+            setParameter(params[i].identifier,
+                         getParameter(params[i].identifier));
+        }
+        for (int c = 1; c < (int)m_channels; ++c) {
+            if (!m_engines[c]->initialise(stepSize, blockSize)) {
+                return false;
+            }
+        }
+
+        int threads = std::thread::hardware_concurrency();
+        if (threads < 1) threads = 1;
+        if (threads > (int)m_channels) threads = m_channels;
+        m_pool = new ThreadPool(threads);
+    }
 
-    reset();
+    m_channelOutputBase =
+        getOutputDescriptors().size() - 2 * (m_channels - 1);
 
     return true;
 }
 
+void
+CepstralPitchTracker::setResultSink(ResultSink *sink, int channel)
+{
+    if (channel < 0) return;
+    if (channel >= (int)m_sinks.size()) m_sinks.resize(channel + 1, 0);
+    m_sinks[channel] = sink;
+    if (channel < (int)m_engines.size()) {
+        m_engines[channel]->setResultSink(sink);
+    }
+}
+
+void
+CepstralPitchTracker::setNoteRules(const NoteHypothesis::Rules &rules)
+{
+    for (int c = 0; c < (int)m_engines.size(); ++c) {
+        m_engines[c]->setNoteRules(rules);
+    }
+}
+
 void
 CepstralPitchTracker::reset()
 {
-    delete m_feeder;
-    m_feeder = new AgentFeeder();
-    m_nAccepted = 0;
+    for (int c = 0; c < (int)m_engines.size(); ++c) {
+        m_engines[c]->reset();
+    }
 }
 
 void
@@ -271,90 +419,160 @@ CepstralPitchTracker::addFeaturesFrom(NoteHypothesis h, FeatureSet &fs)
 }
 
 void
-CepstralPitchTracker::addNewFeatures(FeatureSet &fs)
+CepstralPitchTracker::addNewFeatures(PitchTrackerEngine *engine,
+                                     FeatureSet &fs)
 {
-    int n = m_feeder->getAcceptedHypotheses().size();
-    if (n == m_nAccepted) return;
-
-    AgentFeeder::Hypotheses accepted = m_feeder->getAcceptedHypotheses();
-
-    for (int i = m_nAccepted; i < n; ++i) {
-        addFeaturesFrom(accepted[i], fs);
+    // Read the engine's records through a small buffer, converting
+    // each to a feature
+    const int bufsize = 64;
+    int n = 0;
+
+    PitchTrackerEngine::Pitch pitches[bufsize];
+    while ((n = engine->readPitches(pitches, bufsize)) > 0) {
+        for (int i = 0; i < n; ++i) {
+            Feature f;
+            f.hasTimestamp = true;
+            f.timestamp = pitches[i].time;
+            f.values.push_back(pitches[i].freq);
+            fs[0].push_back(f);
+        }
     }
 
-    m_nAccepted = n;
+    PitchTrackerEngine::Note notes[bufsize];
+    while ((n = engine->readNotes(notes, bufsize)) > 0) {
+        for (int i = 0; i < n; ++i) {
+            Feature f;
+            f.hasTimestamp = true;
+            f.hasDuration = true;
+            f.timestamp = notes[i].time;
+            f.duration = notes[i].duration;
+            f.values.push_back(notes[i].freq);
+            fs[1].push_back(f);
+        }
+    }
 }
 
-CepstralPitchTracker::FeatureSet
-CepstralPitchTracker::process(const float *const *inputBuffers, RealTime timestamp)
+#ifdef WITH_TRACKER_STATS
+void
+CepstralPitchTracker::addDiagnosticFeature(const TrackerStats &prior,
+                                           bool gated,
+                                           RealTime timestamp,
+                                           FeatureSet &fs)
 {
-    double *rawcep = new double[m_blockSize];
-    double magmean = Cepstrum(m_blockSize).process(inputBuffers[0], rawcep);
-
-    int n = m_bins;
-    double *data = new double[n];
-    MeanFilter(m_vflen).filterSubsequence
-        (rawcep, data, m_blockSize, n, m_binFrom);
-
-    delete[] rawcep;
-
-    double maxval = 0.0;
-    int maxbin = -1;
+    const TrackerStats &stats = m_engines[0]->getStats();
+    Feature f;
+    f.hasTimestamp = true;
+    f.timestamp = timestamp;
+    for (int i = 0; i < TrackerStats::StageCount; ++i) {
+        f.values.push_back(stats.stageNanos[i] - prior.stageNanos[i]);
+    }
+    f.values.push_back(m_engines[0]->getCandidateCount());
+    f.values.push_back(stats.hypothesesAccepted);
+    f.values.push_back(stats.hypothesesRejected);
+    f.values.push_back(gated ? 1.f : 0.f);
+    fs[2].push_back(f);
+}
+#endif
 
-    for (int i = 0; i < n; ++i) {
-        if (data[i] > maxval) {
-            maxval = data[i];
-            maxbin = i;
+class CepstralPitchTracker::ChannelTask : public ThreadPool::Task
+{
+public:
+    ChannelTask(CepstralPitchTracker *tracker,
+                const float *const *inputBuffers,
+                RealTime timestamp) :
+        results(tracker->m_channels), m_tracker(tracker),
+        m_inputBuffers(inputBuffers), m_timestamp(timestamp) { }
+
+    std::vector<FeatureSet> results;
+
+    void run(int c) {
+        // Called with m_inputBuffers == 0 to finish the channels
+        if (m_inputBuffers) {
+            results[c] = m_tracker->processChannel
+                (c, m_inputBuffers[c], m_timestamp);
+        } else {
+            results[c] = m_tracker->getRemainingChannelFeatures(c);
         }
     }
 
-    if (maxbin < 0) {
-        delete[] data;
-        return FeatureSet();
-    }
+private:
+    CepstralPitchTracker *m_tracker;
+    const float *const *m_inputBuffers;
+    RealTime m_timestamp;
+};
 
-    double nextPeakVal = 0.0;
-    for (int i = 1; i+1 < n; ++i) {
-        if (data[i] > data[i-1] &&
-            data[i] > data[i+1] &&
-            i != maxbin &&
-            data[i] > nextPeakVal) {
-            nextPeakVal = data[i];
-        }
+CepstralPitchTracker::FeatureSet
+CepstralPitchTracker::mergeChannels(std::vector<FeatureSet> &results)
+{
+    // The first channel's features go to the first outputs as they
+    // are; those of each later channel go to its own f0 and notes
+    // outputs, after the first channel's (possible) diagnostics
+    FeatureSet fs = results[0];
+
+    for (int c = 1; c < (int)results.size(); ++c) {
+        int f0 = m_channelOutputBase + 2 * (c - 1);
+        fs[f0] = results[c][0];
+        fs[f0 + 1] = results[c][1];
     }
 
-    PeakInterpolator pi;
-    double cimax = pi.findPeakLocation(data, m_bins, maxbin);
-    double peakfreq = m_inputSampleRate / (cimax + m_binFrom);
-
-    double confidence = 0.0;
-    double threshold = 0.1; // for magmean
+    return fs;
+}
 
-    if (nextPeakVal != 0.0) {
-        confidence = (maxval - nextPeakVal) * 10.0;
-        if (magmean < threshold) confidence = 0.0;
+CepstralPitchTracker::FeatureSet
+CepstralPitchTracker::process(const float *const *inputBuffers, RealTime timestamp)
+{
+    if (m_channels < 2) {
+        return processChannel(0, inputBuffers[0], timestamp);
     }
 
-    delete[] data;
+    ChannelTask task(this, inputBuffers, timestamp);
+    m_pool->run(task, m_channels);
+    return mergeChannels(task.results);
+}
 
-    NoteHypothesis::Estimate e;
-    e.freq = peakfreq;
-    e.time = timestamp;
-    e.confidence = confidence;
+CepstralPitchTracker::FeatureSet
+CepstralPitchTracker::getRemainingFeatures()
+{
+    if (m_channels < 2) {
+        return getRemainingChannelFeatures(0);
+    }
 
-    m_feeder->feed(e);
+    ChannelTask task(this, 0, RealTime::zeroTime);
+    m_pool->run(task, m_channels);
+    return mergeChannels(task.results);
+}
 
+CepstralPitchTracker::FeatureSet
+CepstralPitchTracker::processChannel(int channel, const float *in,
+                                     RealTime timestamp)
+{
     FeatureSet fs;
-    addNewFeatures(fs);
+    PitchTrackerEngine *engine = m_engines[channel];
+
+#ifdef WITH_TRACKER_STATS
+    TrackerStats prior = engine->getStats();
+#endif
+
+    engine->process(in, m_blockSize + 2, timestamp);
+    addNewFeatures(engine, fs);
+
+#ifdef WITH_TRACKER_STATS
+    if (channel == 0) {
+        addDiagnosticFeature
+            (prior, engine->getStats().gatedFrames > prior.gatedFrames,
+             timestamp, fs);
+    }
+#endif
     return fs;
 }
 
 CepstralPitchTracker::FeatureSet
-CepstralPitchTracker::getRemainingFeatures()
+CepstralPitchTracker::getRemainingChannelFeatures(int channel)
 {
-    m_feeder->finish();
+    PitchTrackerEngine *engine = m_engines[channel];
+    engine->finish();
 
     FeatureSet fs;
-    addNewFeatures(fs);
+    addNewFeatures(engine, fs);
     return fs;
 }
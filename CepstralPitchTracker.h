@@ -27,10 +27,16 @@
 
 #include <vamp-sdk/Plugin.h>
 
-#include "NoteHypothesis.h"
+#include "PitchTrackerEngine.h"
 
-class AgentFeeder;
+#include <vector>
 
+class ThreadPool;
+
+/**
+ * The Vamp plugin. This is an adapter over a PitchTrackerEngine for
+ * each channel, turning the engines' records into features.
+ */
 class CepstralPitchTracker : public Vamp::Plugin
 {
 public:
@@ -68,23 +74,84 @@ public:
 
     FeatureSet getRemainingFeatures();
 
+    /**
+     * Add the f0 and note features for an accepted hypothesis to the
+     * given feature set, in the form this plugin returns them.
+     */
+    static void addFeaturesFrom(NoteHypothesis h, FeatureSet &fs);
+
+    /**
+     * Calculate the pitch estimate for a single-channel frame as
+     * process() would, but without passing it on to the note
+     * tracking. Return false if there is no estimate for the frame.
+     */
+    bool estimateFrame(const float *in, Vamp::RealTime timestamp,
+                       NoteHypothesis::Estimate &e) {
+        return m_engines[0]->estimateFrame(in, timestamp, e);
+    }
+
+    /**
+     * Return true if the estimate for each frame is independent of
+     * the note tracking, and so of the frames before it. This is the
+     * case unless the skip or narrow parameters are in use.
+     */
+    bool hasIndependentEstimates() const {
+        return m_engines[0]->hasIndependentEstimates();
+    }
+
+    /**
+     * Set a sink to receive the results for the given channel as
+     * they are found. While it is set, the features for that channel
+     * are passed to the sink instead of being returned from
+     * process() and getRemainingFeatures(). The sink is not owned by
+     * the plugin. Pass 0 to go back to returning features.
+     */
+    void setResultSink(ResultSink *sink, int channel = 0);
+
+    /**
+     * Set the rules of the note tracking, in place of the defaults.
+     * These are not plugin parameters, and take effect on the next
+     * initialise() or reset().
+     */
+    void setNoteRules(const NoteHypothesis::Rules &rules);
+
+    /**
+     * Return the per-stage timings and event counters accumulated
+     * since the last reset, for the first channel. These are only
+     * gathered in builds with WITH_TRACKER_STATS defined, and are all
+     * zero otherwise.
+     */
+    const TrackerStats &getStats() const { return m_engines[0]->getStats(); }
+
 protected:
     size_t m_channels;
     size_t m_stepSize;
     size_t m_blockSize;
-    float m_fmin;
-    float m_fmax;
-    int m_vflen;
-
-    int m_binFrom;
-    int m_binTo;
-    int m_bins; // count of "interesting" bins, those returned in m_cepOutput
 
-    int m_nAccepted;
-
-    AgentFeeder *m_feeder;
-    void addFeaturesFrom(NoteHypothesis h, FeatureSet &fs);
-    void addNewFeatures(FeatureSet &fs);
+    // One engine per channel. The first always exists, and holds the
+    // parameters until initialise() creates the others
+    std::vector<PitchTrackerEngine *> m_engines;
+
+    // Result sinks by channel, applied to the engines as they are
+    // created
+    std::vector<ResultSink *> m_sinks;
+
+    // Threads the channels are processed on, when there is more than
+    // one channel
+    ThreadPool *m_pool;
+    int m_channelOutputBase; // index of the second channel's f0 output
+    class ChannelTask;
+    FeatureSet processChannel(int channel, const float *in,
+                              Vamp::RealTime timestamp);
+    FeatureSet getRemainingChannelFeatures(int channel);
+    FeatureSet mergeChannels(std::vector<FeatureSet> &results);
+
+    void addNewFeatures(PitchTrackerEngine *engine, FeatureSet &fs);
+
+#ifdef WITH_TRACKER_STATS
+    void addDiagnosticFeature(const TrackerStats &prior, bool gated,
+                              Vamp::RealTime timestamp, FeatureSet &fs);
+#endif
 };
 
 #endif
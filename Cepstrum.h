@@ -61,9 +61,45 @@ public:
      */
     double process(const float *in, double *out) {
 
-	int hs = m_n/2 + 1;
-	double *io = new double[m_n];
 	double *logmag = new double[m_n];
+	double magmean = logMagnitude(in, logmag);
+	transform(logmag, out);
+	delete[] logmag;
+
+	return magmean;
+    }
+
+    /**
+     * Return the mean magnitude of the given frequency-domain data
+     * (in the same format as for process()). This is the same value
+     * as process() and logMagnitude() return, but is much cheaper to
+     * calculate on its own.
+     */
+    double magnitudeMean(const float *in) const {
+
+	int hs = m_n/2 + 1;
+	double magmean = 0.0;
+
+	for (int i = 0; i < hs; ++i) {
+            double re = in[i*2];
+            double im = in[i*2+1];
+            double power = re * re + im * im;
+	    magmean += sqrt(power);
+	}
+
+	return magmean / hs;
+    }
+
+    /**
+     * Calculate the first stage of process(), converting the given
+     * frequency-domain data (in the same format as for process()) to
+     * a synthetically symmetrical log magnitude spectrum of length n.
+     *
+     * Returns the mean magnitude of the input spectrum.
+     */
+    double logMagnitude(const float *in, double *logmag) {
+
+	int hs = m_n/2 + 1;
 	double epsilon = 1e-10;
 
 	double magmean = 0.0;
@@ -92,12 +128,64 @@ public:
 	}
 	std::cerr << std::endl;
 	*/
+	return magmean;
+    }
+
+    /**
+     * Calculate the second stage of process(), converting a log
+     * magnitude spectrum of length n as returned by logMagnitude()
+     * to the raw cepstrum of length n.
+     */
+    void transform(const double *logmag, double *out) {
+
+	double *io = new double[m_n];
 	Vamp::FFT::inverse(m_n, logmag, 0, out, io);
-    
-	delete[] logmag;
 	delete[] io;
+    }
 
-	return magmean;
+    /**
+     * Calculate only cepstral bins from..to inclusive of the result
+     * of transform(), writing them to out[0..to-from]. This evaluates
+     * the inverse transform directly at each bin, taking time
+     * proportional to n per bin, so it is cheaper than transform()
+     * only when a small number of bins is wanted.
+     */
+    void transformRange(const double *logmag, int from, int to, double *out) {
+	for (int q = from; q <= to; ++q) {
+	    out[q - from] = evaluate(logmag, q);
+	}
+    }
+
+    /**
+     * Evaluate the cepstrum at the possibly fractional bin q, given
+     * the log magnitude from logMagnitude(). At whole bins this is
+     * the same as the corresponding bin of transform(); between them
+     * it interpolates the cepstrum as the inverse transform would if
+     * it were zero-padded. Takes time proportional to n.
+     */
+    double evaluate(const double *logmag, double q) const {
+
+	int hn = m_n/2;
+
+	// Because the log magnitude is real and symmetrical, its
+	// inverse transform is a cosine sum. The cosines are
+	// generated by the Chebyshev recurrence cos((k+1)w) =
+	// 2cos(w)cos(kw) - cos((k-1)w)
+	double w = (2.0 * M_PI * q) / m_n;
+	double c1 = cos(w);
+	double twoc1 = 2.0 * c1;
+	double cprev = 1.0, c = c1;
+
+	double acc = 0.0;
+	for (int k = 1; k < hn; ++k) {
+	    acc += logmag[k] * c;
+	    double cnext = twoc1 * c - cprev;
+	    cprev = c;
+	    c = cnext;
+	}
+
+	// c is now cos(hn * w) = cos(pi * q)
+	return (logmag[0] + 2.0 * acc + logmag[hn] * c) / m_n;
     }
 
 private:
@@ -0,0 +1,406 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "CorpusRunner.h"
+#include "AudioFile.h"
+#include "AudioFileSource.h"
+#include "NoteIndex.h"
+#include "OfflineAnalyser.h"
+#include "Seconds.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <cstdio>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+typedef Vamp::Plugin::FeatureList FeatureList;
+
+static long long
+nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * One worker's queue of file indices, longest file first. The owner
+ * takes from the front and thieves from the back. Each deque has its
+ * own lock, which only a thief ever contends for.
+ */
+class CorpusRunner::Deque
+{
+public:
+    void push(int index) {
+        m_items.push_back(index);
+    }
+
+    bool takeFront(int &index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty()) return false;
+        index = m_items.front();
+        m_items.pop_front();
+        return true;
+    }
+
+    bool takeBack(int &index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty()) return false;
+        index = m_items.back();
+        m_items.pop_back();
+        return true;
+    }
+
+private:
+    std::deque<int> m_items;
+    std::mutex m_mutex;
+};
+
+class CorpusRunner::Worker
+{
+public:
+    Worker(CorpusRunner *runner, int index, const vector<string> &paths,
+           FILE *out) :
+        m_runner(runner), m_index(index), m_paths(paths), m_out(out),
+        m_analyser(0), m_rate(0) { }
+
+    ~Worker() {
+        delete m_analyser;
+    }
+
+    void run() {
+        int i = 0;
+        while (m_runner->take(m_index, i)) {
+            analyse(i);
+            ++m_runner->m_done;
+        }
+    }
+
+private:
+    CorpusRunner *m_runner;
+    int m_index;
+    const vector<string> &m_paths;
+    FILE *m_out;
+
+    OfflineAnalyser *m_analyser;
+    float m_rate;
+
+    void fail(int i, string message) {
+        std::replace(message.begin(), message.end(), '\n', ' ');
+        fprintf(m_out, "%d,error,%s\n", i, message.c_str());
+        ++m_runner->m_failed;
+    }
+
+    void prepare(float rate) {
+
+        // The same analyser is reused for every file at the same
+        // rate. A file at a different rate needs a new one, as the
+        // rate is fixed on construction. The workers already run in
+        // parallel, so each analyser has a single thread
+        if (m_analyser && rate == m_rate) {
+            return;
+        }
+
+        delete m_analyser;
+        m_analyser = new OfflineAnalyser
+            (rate, m_runner->m_stepSize, m_runner->m_blockSize, 1);
+        m_rate = rate;
+
+        for (std::map<string, float>::const_iterator i =
+                 m_runner->m_params.begin();
+             i != m_runner->m_params.end(); ++i) {
+            m_analyser->setParameter(i->first, i->second);
+        }
+        m_analyser->setNoteRules(m_runner->m_rules);
+    }
+
+    void analyse(int i) {
+
+        AudioFile file;
+        bool opened = (m_runner->m_rawRate > 0.f ?
+                       file.openRaw(m_paths[i], m_runner->m_rawRate,
+                                    m_runner->m_rawChannels) :
+                       file.open(m_paths[i]));
+        if (!opened) {
+            fail(i, file.getError());
+            return;
+        }
+
+        int channel = m_runner->m_channel;
+        if (channel >= file.getChannelCount()) {
+            fail(i, m_paths[i] + ": no such channel");
+            return;
+        }
+
+        float rate = file.getSampleRate();
+        prepare(rate);
+
+        AudioFileSource source(file, channel);
+        FeatureSet fs;
+        if (!m_analyser->analyse(source, fs)) {
+            fail(i, m_paths[i] + ": failed to initialise tracker");
+            return;
+        }
+
+        const FeatureList &f0 = fs[0];
+        const FeatureList &notes = fs[1];
+
+        for (int j = 0; j < (int)f0.size(); ++j) {
+            fprintf(m_out, "%d,f0,%.6f,%.6f\n", i,
+                    toSeconds(f0[j].timestamp), f0[j].values[0]);
+        }
+        for (int j = 0; j < (int)notes.size(); ++j) {
+            fprintf(m_out, "%d,note,%.6f,%.6f,%.6f\n", i,
+                    toSeconds(notes[j].timestamp),
+                    toSeconds(notes[j].duration), notes[j].values[0]);
+        }
+
+        if (m_runner->m_indexPath != "") {
+            NoteIndex::Notes &indexNotes = m_runner->m_indexNotes[i];
+            for (int j = 0; j < (int)notes.size(); ++j) {
+                indexNotes.push_back(NoteHypothesis::Note
+                                     (notes[j].values[0], notes[j].timestamp,
+                                      notes[j].duration));
+            }
+        }
+
+        long n = file.getFrameCount();
+        m_runner->m_frames += m_analyser->getFrameCount(n);
+        m_runner->m_audioMicros += (long long)((n * 1e6) / rate);
+    }
+};
+
+CorpusRunner::CorpusRunner(int threads) :
+    m_threads(threads),
+    m_blockSize(1024),
+    m_stepSize(256),
+    m_rawRate(0),
+    m_rawChannels(1),
+    m_channel(-1),
+    m_progressInterval(0),
+    m_files(0),
+    m_done(0),
+    m_failed(0),
+    m_frames(0),
+    m_audioMicros(0),
+    m_startMicros(0),
+    m_endMicros(0)
+{
+    if (m_threads < 1) {
+        m_threads = std::thread::hardware_concurrency();
+        if (m_threads < 1) m_threads = 1;
+    }
+}
+
+CorpusRunner::~CorpusRunner()
+{
+    for (int i = 0; i < (int)m_deques.size(); ++i) {
+        delete m_deques[i];
+    }
+}
+
+void
+CorpusRunner::setParameter(string identifier, float value)
+{
+    m_params[identifier] = value;
+}
+
+void
+CorpusRunner::setRawInput(float sampleRate, int channels)
+{
+    m_rawRate = sampleRate;
+    m_rawChannels = channels;
+}
+
+bool
+CorpusRunner::readManifest(string path, vector<string> &paths)
+{
+    std::ifstream f(path.c_str());
+    if (!f) return false;
+    string line;
+    while (std::getline(f, line)) {
+        if (!line.empty() && line[line.size()-1] == '\r') {
+            line.erase(line.size()-1);
+        }
+        if (line == "" || line[0] == '#') continue;
+        paths.push_back(line);
+    }
+    return true;
+}
+
+bool
+CorpusRunner::take(int worker, int &index)
+{
+    if (m_deques[worker]->takeFront(index)) {
+        return true;
+    }
+    for (int i = 1; i < m_threads; ++i) {
+        if (m_deques[(worker + i) % m_threads]->takeBack(index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CorpusRunner::Progress
+CorpusRunner::getProgress() const
+{
+    Progress p;
+    p.files = m_files;
+    p.done = m_done;
+    p.failed = m_failed;
+    p.frames = m_frames;
+    p.audio = m_audioMicros / 1e6;
+    long long start = m_startMicros, end = m_endMicros;
+    p.elapsed = (start == 0 ? 0.0 :
+                 ((end == 0 ? nowMicros() : end) - start) / 1e6);
+    return p;
+}
+
+void
+CorpusRunner::reportProgress() const
+{
+    Progress p = getProgress();
+    double rate = (p.elapsed > 0.0 ? p.done / p.elapsed : 0.0);
+    double speed = (p.elapsed > 0.0 ? p.audio / p.elapsed : 0.0);
+    fprintf(stderr, "%ld/%ld files (%ld failed), %.1f files/s, "
+            "%.1fx real time, %.1fs elapsed\n",
+            p.done, p.files, p.failed, rate, speed, p.elapsed);
+}
+
+bool
+CorpusRunner::run(const vector<string> &paths, string outputPrefix)
+{
+    m_files = paths.size();
+    m_done = 0;
+    m_failed = 0;
+    m_frames = 0;
+    m_audioMicros = 0;
+    m_endMicros = 0;
+    m_startMicros = nowMicros();
+
+    m_indexNotes.clear();
+    if (m_indexPath != "") {
+        m_indexNotes.resize(paths.size());
+    }
+
+    // Longest first, by size on disk, which for files of one format
+    // is proportional to duration. Files that can't be found sort
+    // last, and fail quickly when their turn comes
+    vector<std::pair<long long, int> > order;
+    for (int i = 0; i < (int)paths.size(); ++i) {
+        struct stat st;
+        long long size = (stat(paths[i].c_str(), &st) == 0 ? st.st_size : 0);
+        order.push_back(std::make_pair(-size, i));
+    }
+    std::sort(order.begin(), order.end());
+
+    for (int i = 0; i < (int)m_deques.size(); ++i) {
+        delete m_deques[i];
+    }
+    m_deques.clear();
+    for (int w = 0; w < m_threads; ++w) {
+        m_deques.push_back(new Deque);
+    }
+    for (int i = 0; i < (int)order.size(); ++i) {
+        m_deques[i % m_threads]->push(order[i].second);
+    }
+
+    bool ok = true;
+    vector<FILE *> outputs;
+    vector<Worker *> workers;
+    vector<std::thread> threads;
+
+    for (int w = 0; w < m_threads; ++w) {
+        std::ostringstream name;
+        name << outputPrefix << "." << w << ".csv";
+        FILE *out = fopen(name.str().c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Failed to open output file %s\n",
+                    name.str().c_str());
+            ok = false;
+            break;
+        }
+        setvbuf(out, 0, _IOFBF, 1 << 20);
+        outputs.push_back(out);
+        workers.push_back(new Worker(this, w, paths, out));
+    }
+
+    if (ok) {
+        for (int w = 0; w < m_threads; ++w) {
+            threads.push_back(std::thread(&Worker::run, workers[w]));
+        }
+
+        if (m_progressInterval > 0.0) {
+            long long next = nowMicros() + (long long)(m_progressInterval * 1e6);
+            while (m_done < m_files) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                if (nowMicros() >= next) {
+                    reportProgress();
+                    next += (long long)(m_progressInterval * 1e6);
+                }
+            }
+        }
+
+        for (int w = 0; w < m_threads; ++w) {
+            threads[w].join();
+        }
+    }
+
+    m_endMicros = nowMicros();
+
+    for (int w = 0; w < (int)outputs.size(); ++w) {
+        delete workers[w];
+        if (fclose(outputs[w]) != 0) ok = false;
+    }
+
+    if (m_progressInterval > 0.0) {
+        reportProgress();
+    }
+
+    if (ok && m_indexPath != "") {
+        FILE *out = fopen(m_indexPath.c_str(), "wb");
+        bool written = out && NoteIndex::write(out, paths, m_indexNotes, true);
+        if (out && fclose(out) != 0) written = false;
+        if (!written) {
+            fprintf(stderr, "Failed to write note index %s\n",
+                    m_indexPath.c_str());
+            ok = false;
+        }
+        m_indexNotes.clear();
+    }
+
+    return ok;
+}
@@ -0,0 +1,174 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _CORPUS_RUNNER_H_
+#define _CORPUS_RUNNER_H_
+
+#include "NoteHypothesis.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Analyse a large corpus of short audio files on a fixed set of
+ * worker threads. Each worker runs its files through a
+ * single-threaded OfflineAnalyser, kept for as long as the sample
+ * rate stays the same, reading non-float input a block at a time
+ * through an AudioFileSource.
+ *
+ * The files are sorted longest first (by size on disk) and dealt out
+ * in turn to per-worker deques. A worker takes the longest file left
+ * in its own deque, and when that is empty steals the shortest from
+ * another worker's, so the long files start early and the short ones
+ * fill in at the end. Each worker writes its results to its own
+ * buffered output file, so the workers never share a stream.
+ *
+ * Output files are named <prefix>.<worker>.csv, and hold lines of the
+ * form
+ *   <index>,f0,<time>,<hz>
+ *   <index>,note,<time>,<duration>,<hz>
+ *   <index>,error,<message>
+ * where index is the file's position in the list given to run(),
+ * counting from 0. All the lines for one file are together, f0 first
+ * and then notes, as for cepstral-pitchtrack. Frames are laid out as
+ * for OfflineAnalyser. A file that cannot be analysed with the block
+ * and step sizes and parameters given (for example, because the
+ * block size is not a power of two) is reported as an error.
+ *
+ * If an index path is set, a NoteIndex of the notes of every file,
+ * named by their paths as given, is also written there at the end of
+ * the run.
+ */
+class CorpusRunner
+{
+public:
+    /**
+     * Construct a runner with the given number of worker threads, or
+     * one per CPU core if threads is zero.
+     */
+    CorpusRunner(int threads = 0);
+    ~CorpusRunner();
+
+    int getThreadCount() const { return m_threads; }
+
+    void setParameter(std::string identifier, float value);
+    void setNoteRules(const NoteHypothesis::Rules &rules) { m_rules = rules; }
+    void setBlockSize(int blockSize) { m_blockSize = blockSize; }
+    void setStepSize(int stepSize) { m_stepSize = stepSize; }
+
+    /**
+     * Treat every input as a raw float file at the given rate, with
+     * the given number of channels, rather than as a WAVE file.
+     */
+    void setRawInput(float sampleRate, int channels);
+
+    /**
+     * Track only the given channel of each file, rather than a
+     * mixdown of all of them.
+     */
+    void setChannel(int channel) { m_channel = channel; }
+
+    /**
+     * Report progress to standard error every given number of
+     * seconds while running, or never if zero.
+     */
+    void setProgressInterval(double seconds) { m_progressInterval = seconds; }
+
+    /**
+     * Write a NoteIndex, with a pitch table, to the given path at the
+     * end of each run, or none if the path is empty.
+     */
+    void setIndexPath(std::string path) { m_indexPath = path; }
+
+    struct Progress {
+        long files;        // total to analyse
+        long done;         // completed, including failures
+        long failed;       // could not be read or analysed
+        long frames;       // analysed so far
+        double audio;      // seconds of audio analysed so far
+        double elapsed;    // seconds since run() started
+    };
+
+    /**
+     * Return the progress of the current or last run. May be called
+     * from any thread.
+     */
+    Progress getProgress() const;
+
+    /**
+     * Analyse the given files, writing to output files named from the
+     * given prefix. Return false if any output file, or the index,
+     * could not be written; failures to read or analyse individual files are
+     * reported in the output and counted in the progress instead.
+     */
+    bool run(const std::vector<std::string> &paths, std::string outputPrefix);
+
+    /**
+     * Read a manifest file of paths, one per line. Blank lines and
+     * lines starting with # are skipped. Return false if the file
+     * could not be read.
+     */
+    static bool readManifest(std::string path,
+                             std::vector<std::string> &paths);
+
+private:
+    CorpusRunner(const CorpusRunner &); // not provided
+    CorpusRunner &operator=(const CorpusRunner &); // not provided
+
+    class Worker;
+    class Deque;
+
+    int m_threads;
+    int m_blockSize;
+    int m_stepSize;
+    float m_rawRate;
+    int m_rawChannels;
+    int m_channel;
+    double m_progressInterval;
+    std::string m_indexPath;
+    std::map<std::string, float> m_params;
+    NoteHypothesis::Rules m_rules;
+
+    // The notes of each file, by index, when writing a note index.
+    // Each worker writes only the entries for the files it takes
+    std::vector<std::vector<NoteHypothesis::Note> > m_indexNotes;
+
+    std::vector<Deque *> m_deques;
+
+    long m_files;
+    std::atomic<long> m_done;
+    std::atomic<long> m_failed;
+    std::atomic<long> m_frames;
+    std::atomic<long long> m_audioMicros;
+    std::atomic<long long> m_startMicros;
+    std::atomic<long long> m_endMicros;
+
+    bool take(int worker, int &index);
+    void reportProgress() const;
+};
+
+#endif
@@ -0,0 +1,235 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "EstimateCache.h"
+#include "CepstralPitchTracker.h"
+#include "PitchTrackerEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+static const uint32_t version = 1;
+static const uint32_t byteOrder = 0x01020304;
+
+static_assert(sizeof(EstimateCache::Header) == 48 &&
+              sizeof(EstimateCache::FrameRecord) == 16,
+              "estimate cache records must have no padding");
+
+// 64-bit FNV-1a
+static const uint64_t fnvBasis = 14695981039346656037ULL;
+static const uint64_t fnvPrime = 1099511628211ULL;
+
+static uint64_t
+hashBytes(uint64_t h, const void *data, size_t bytes)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < bytes; ++i) {
+        h = (h ^ p[i]) * fnvPrime;
+    }
+    return h;
+}
+
+// Samples from a source that is not an array are hashed through a
+// buffer of this many at a time
+static const long hashBuffer = 65536;
+
+EstimateCache::Key
+EstimateCache::makeKey(const float *samples, long n, float sampleRate,
+                       int stepSize, int blockSize,
+                       const std::map<string, float> &params)
+{
+    return makeKey(OfflineAnalyser::ArraySource(samples, n), sampleRate,
+                   stepSize, blockSize, params);
+}
+
+EstimateCache::Key
+EstimateCache::makeKey(const OfflineAnalyser::Source &source,
+                       float sampleRate, int stepSize, int blockSize,
+                       const std::map<string, float> &params)
+{
+    Key key;
+
+    long n = source.getLength();
+    uint64_t count = n;
+    key.content = hashBytes(fnvBasis, &count, sizeof(count));
+    const float *samples = source.getData();
+    if (samples) {
+        if (n > 0) {
+            key.content = hashBytes(key.content, samples, n * sizeof(float));
+        }
+    } else {
+        vector<float> buffer(std::min(n, hashBuffer));
+        for (long i = 0; i < n; i += hashBuffer) {
+            long c = std::min(n - i, hashBuffer);
+            source.read(i, c, &buffer[0]);
+            key.content = hashBytes(key.content, &buffer[0],
+                                    c * sizeof(float));
+        }
+    }
+
+    key.frameCount = OfflineAnalyser::getFrameCount(n, stepSize);
+
+    uint32_t layout[4] = { version, uint32_t(PitchTrackerEngine::Revision),
+                           uint32_t(stepSize), uint32_t(blockSize) };
+    key.analysis = hashBytes(fnvBasis, layout, sizeof(layout));
+    key.analysis = hashBytes(key.analysis, &sampleRate, sizeof(sampleRate));
+
+    // Hash the value the plugin ends up with for every parameter,
+    // rather than only those given, so that a default set explicitly
+    // keys the same as one left alone
+    CepstralPitchTracker tracker(sampleRate);
+    for (std::map<string, float>::const_iterator i = params.begin();
+         i != params.end(); ++i) {
+        tracker.setParameter(i->first, i->second);
+    }
+    Vamp::Plugin::ParameterList descriptors =
+        tracker.getParameterDescriptors();
+    for (int i = 0; i < (int)descriptors.size(); ++i) {
+        const string &id = descriptors[i].identifier;
+        float value = tracker.getParameter(id);
+        // include the terminating nul, so that names run together
+        // cannot hash the same
+        key.analysis = hashBytes(key.analysis, id.c_str(), id.size() + 1);
+        key.analysis = hashBytes(key.analysis, &value, sizeof(value));
+    }
+
+    return key;
+}
+
+string
+EstimateCache::getFileName(const Key &key)
+{
+    char buf[64];
+    sprintf(buf, "%016llx-%016llx.cpte",
+            (unsigned long long)key.content,
+            (unsigned long long)key.analysis);
+    return buf;
+}
+
+bool
+EstimateCache::write(string path, const Key &key, float sampleRate,
+                     int stepSize, int blockSize,
+                     const OfflineAnalyser::Frames &frames)
+{
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "CPTE", 4);
+    h.version = version;
+    h.byteOrder = byteOrder;
+    h.frameCount = frames.size();
+    h.content = key.content;
+    h.analysis = key.analysis;
+    h.sampleRate = sampleRate;
+    h.stepSize = stepSize;
+    h.blockSize = blockSize;
+
+    vector<FrameRecord> records(frames.size());
+    for (int i = 0; i < (int)frames.size(); ++i) {
+        if (frames[i].present) {
+            records[i].frequency = frames[i].estimate.freq;
+            records[i].confidence = frames[i].estimate.confidence;
+        } else {
+            records[i].frequency = NAN;
+            records[i].confidence = 0.0;
+        }
+    }
+
+    // Write to a temporary file and rename it into place, so that a
+    // reader never sees a partial entry
+    string temporary = path + ".tmp";
+    FILE *out = fopen(temporary.c_str(), "wb");
+    if (!out) return false;
+
+    bool ok = (fwrite(&h, sizeof(h), 1, out) == 1);
+    if (ok && !records.empty()) {
+        ok = (fwrite(&records[0], sizeof(FrameRecord), records.size(), out)
+              == records.size());
+    }
+    if (fclose(out) != 0) ok = false;
+
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool
+EstimateCache::read(string path, const Key &key,
+                    OfflineAnalyser::Frames &frames)
+{
+    frames.clear();
+
+    FILE *in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+
+    Header h;
+    if (fread(&h, sizeof(h), 1, in) != 1 ||
+        memcmp(h.magic, "CPTE", 4) ||
+        h.version != version ||
+        h.byteOrder != byteOrder ||
+        h.content != key.content ||
+        h.analysis != key.analysis ||
+        h.frameCount != uint32_t(key.frameCount)) {
+        fclose(in);
+        return false;
+    }
+
+    // Check the length before allocating, so that a damaged header
+    // cannot ask for more than the file holds
+    uint64_t expected = sizeof(Header) +
+        uint64_t(h.frameCount) * sizeof(FrameRecord);
+    if (fseek(in, 0, SEEK_END) != 0 ||
+        uint64_t(ftell(in)) != expected ||
+        fseek(in, sizeof(Header), SEEK_SET) != 0) {
+        fclose(in);
+        return false;
+    }
+
+    vector<FrameRecord> records(h.frameCount);
+    bool ok = (records.empty() ||
+               fread(&records[0], sizeof(FrameRecord), records.size(), in)
+               == records.size());
+    fclose(in);
+    if (!ok) return false;
+
+    frames.resize(records.size());
+    for (int i = 0; i < (int)records.size(); ++i) {
+        if (std::isnan(records[i].frequency)) continue;
+        frames[i].present = true;
+        frames[i].estimate.freq = records[i].frequency;
+        frames[i].estimate.confidence = records[i].confidence;
+        frames[i].estimate.time = RealTime::frame2RealTime
+            (long(i) * h.stepSize + h.blockSize/2,
+             (unsigned int)h.sampleRate);
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _ESTIMATE_CACHE_H_
+#define _ESTIMATE_CACHE_H_
+
+#include "OfflineAnalyser.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/**
+ * A file cache of the per-frame estimates of an OfflineAnalyser, so
+ * that the note tracking may be run again, for example with other
+ * rules, without repeating the estimate stage.
+ *
+ * Each entry is keyed by a hash of the mono samples analysed and a
+ * hash of everything else the estimates depend on (the sample rate,
+ * step and block sizes, the effective value of every plugin
+ * parameter, and the estimator revision). The note tracking rules
+ * are not part of the key, as they do not affect the estimates.
+ *
+ * An entry file is, in the writing machine's byte order:
+ *
+ *   Header      48 bytes, see below
+ *   frames      frameCount x FrameRecord (16 bytes each)
+ *
+ * The frames are numbered as for OfflineAnalyser, whose frame layout
+ * gives the time of each. A frame with no estimate at all has a NaN
+ * frequency (one whose spectrum was too quiet has an estimate, of
+ * frequency and confidence zero).
+ */
+class EstimateCache
+{
+public:
+    struct Key {
+        Key() : content(0), analysis(0), frameCount(0) { }
+        bool operator==(const Key &k) const {
+            return k.content == content && k.analysis == analysis &&
+                k.frameCount == frameCount;
+        }
+        uint64_t content;
+        uint64_t analysis;
+        int frameCount;         // expected, for the samples and step size
+    };
+
+    struct Header {
+        char magic[4];          // "CPTE"
+        uint32_t version;       // 1
+        uint32_t byteOrder;     // 0x01020304, as written
+        uint32_t frameCount;
+        uint64_t content;       // the key
+        uint64_t analysis;
+        float sampleRate;
+        uint32_t stepSize;
+        uint32_t blockSize;
+        uint32_t reserved;
+    };
+
+    struct FrameRecord {
+        double frequency;
+        double confidence;
+    };
+
+    /**
+     * Return the key for an analysis of the given n mono samples,
+     * with the given sizes and plugin parameters. A parameter not in
+     * params is keyed at its default, so that setting it explicitly
+     * to that value gives the same key.
+     */
+    static Key makeKey(const float *samples, long n, float sampleRate,
+                       int stepSize, int blockSize,
+                       const std::map<std::string, float> &params);
+
+    /**
+     * Return the key for an analysis of the samples of the given
+     * source, as above. The key is the same as for the same samples
+     * given as an array.
+     */
+    static Key makeKey(const OfflineAnalyser::Source &source,
+                       float sampleRate, int stepSize, int blockSize,
+                       const std::map<std::string, float> &params);
+
+    /**
+     * Return the name, without directory, of the entry file for the
+     * given key.
+     */
+    static std::string getFileName(const Key &key);
+
+    /**
+     * Write the given frames to an entry file at the given path,
+     * replacing any existing one only once it is complete. Return
+     * false if the output fails.
+     */
+    static bool write(std::string path, const Key &key, float sampleRate,
+                      int stepSize, int blockSize,
+                      const OfflineAnalyser::Frames &frames);
+
+    /**
+     * Read the frames from the entry file at the given path. Return
+     * false if there is no such file, or if it is not a complete
+     * entry for the given key, of the key's frame count, written on a
+     * machine of the same byte order.
+     */
+    static bool read(std::string path, const Key &key,
+                     OfflineAnalyser::Frames &frames);
+};
+
+#endif
@@ -0,0 +1,413 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "LockstepTracker.h"
+#include "AgentFeeder.h"
+#include "Cepstrum.h"
+#include "PeakInterpolator.h"
+
+#include <cmath>
+
+using std::string;
+using Vamp::RealTime;
+
+LockstepTracker::LockstepTracker(int streams, float sampleRate, int blockSize) :
+    m_streams(streams),
+    m_sampleRate(sampleRate),
+    m_blockSize(blockSize),
+    m_layout(sampleRate)
+{
+    if (blockSize & (blockSize-1)) {
+        throw "N must be a power of two";
+    }
+
+    m_magmean.resize(streams);
+    m_maxval.resize(streams);
+    m_nextPeakVal.resize(streams);
+    m_maxbin.resize(streams);
+
+    for (int s = 0; s < streams; ++s) {
+        m_feeders.push_back(new AgentFeeder(m_rules));
+        m_nAccepted.push_back(0);
+    }
+
+    setUp();
+}
+
+void
+LockstepTracker::setUp()
+{
+    // The step size makes no difference to the layout
+    m_layout.initialise(1, m_blockSize);
+
+    m_cepSize = m_layout.getCepstrumSize();
+    m_cepRate = m_layout.getCepstrumRate();
+    m_vflen = m_layout.getFilterLength();
+    m_binFrom = m_layout.getFirstBin();
+    m_bins = m_layout.getBinCount();
+
+    m_re.resize(m_cepSize * m_streams);
+    m_im.resize(m_cepSize * m_streams);
+    m_data.resize(m_bins * m_streams);
+
+    m_cos.clear();
+    m_sin.clear();
+    for (int i = 0; i < m_cepSize / 2; ++i) {
+        m_cos.push_back(cos((2.0 * M_PI * i) / m_cepSize));
+        m_sin.push_back(sin((2.0 * M_PI * i) / m_cepSize));
+    }
+}
+
+bool
+LockstepTracker::setParameter(string identifier, float value)
+{
+    if (identifier == "bandlimit") {
+        m_layout.setBandLimit(value);
+        setUp();
+        reset();
+        return true;
+    }
+    if (identifier == "skip" || identifier == "refine") {
+        return int(value + 0.5) == 1;
+    }
+    if (identifier == "narrow" || identifier == "dual") {
+        return value <= 0.5f;
+    }
+    return false;
+}
+
+LockstepTracker::~LockstepTracker()
+{
+    for (int s = 0; s < m_streams; ++s) {
+        delete m_feeders[s];
+    }
+}
+
+void
+LockstepTracker::reset()
+{
+    for (int s = 0; s < m_streams; ++s) {
+        delete m_feeders[s];
+        m_feeders[s] = new AgentFeeder(m_rules);
+        m_nAccepted[s] = 0;
+    }
+}
+
+void
+LockstepTracker::setNoteRules(const NoteHypothesis::Rules &rules)
+{
+    m_rules = rules;
+    reset();
+}
+
+std::vector<LockstepTracker::FeatureSet>
+LockstepTracker::process(const float *const *spectra, RealTime timestamp)
+{
+    std::vector<RealTime> timestamps(m_streams, timestamp);
+    return process(spectra, &timestamps[0]);
+}
+
+std::vector<LockstepTracker::FeatureSet>
+LockstepTracker::process(const float *const *spectra,
+                         const RealTime *timestamps)
+{
+    std::vector<FeatureSet> out(m_streams);
+
+    // Only streams whose frame is above the gate get a cepstrum, as
+    // in PitchTrackerEngine::estimate(). Frames below it have
+    // estimates of zero confidence, or none at all if entirely zero
+    Cepstrum cepstrum(m_blockSize);
+    m_active.clear();
+    for (int s = 0; s < m_streams; ++s) {
+        if (!spectra[s]) continue;
+        m_magmean[s] = cepstrum.magnitudeMean(spectra[s]);
+        if (m_magmean[s] >= PitchTrackerEngine::MagnitudeGate) {
+            m_active.push_back(s);
+        }
+    }
+
+    if (!m_active.empty()) {
+        logMagnitude(spectra);
+        transform();
+        filter();
+        findPeaks();
+    }
+
+    int na = m_active.size();
+    int k = 0;
+
+    for (int s = 0; s < m_streams; ++s) {
+
+        if (!spectra[s]) continue;
+
+        NoteHypothesis::Estimate e(0.0, timestamps[s], 0.0);
+        bool have = false;
+
+        if (k < na && m_active[k] == s) {
+            if (m_maxbin[k] >= 0) {
+                have = true;
+                int maxbin = m_maxbin[k];
+                double cimax = maxbin;
+                if (maxbin > 0 && maxbin < m_bins - 1) {
+                    double around[3];
+                    for (int j = 0; j < 3; ++j) {
+                        around[j] = m_data[(maxbin - 1 + j) * na + k];
+                    }
+                    PeakInterpolator pi;
+                    cimax = maxbin - 1 + pi.findPeakLocation(around, 3, 1);
+                }
+                e.freq = m_cepRate / (cimax + m_binFrom);
+                if (m_nextPeakVal[k] != 0.0) {
+                    e.confidence = (m_maxval[k] - m_nextPeakVal[k]) * 10.0;
+                }
+            }
+            ++k;
+        } else {
+            have = (m_magmean[s] > 0.0);
+        }
+
+        if (have) {
+            m_feeders[s]->feed(e);
+        }
+
+        addNewFeatures(s, out[s]);
+    }
+
+    return out;
+}
+
+LockstepTracker::FeatureSet
+LockstepTracker::finishStream(int s)
+{
+    FeatureSet fs;
+    m_feeders[s]->finish();
+    addNewFeatures(s, fs);
+
+    delete m_feeders[s];
+    m_feeders[s] = new AgentFeeder(m_rules);
+    m_nAccepted[s] = 0;
+
+    return fs;
+}
+
+std::vector<LockstepTracker::FeatureSet>
+LockstepTracker::finish()
+{
+    std::vector<FeatureSet> out;
+    for (int s = 0; s < m_streams; ++s) {
+        out.push_back(finishStream(s));
+    }
+    return out;
+}
+
+void
+LockstepTracker::logMagnitude(const float *const *spectra)
+{
+    // As Cepstrum::logMagnitude() at the cepstrum size, for the
+    // active streams, into m_re, with m_im zeroed ready for the
+    // transform
+
+    int n = m_cepSize;
+    int hs = n/2 + 1;
+    int ns = m_active.size();
+    double epsilon = 1e-10;
+
+    for (int i = 0; i < hs; ++i) {
+
+        double *lm = &m_re[i * ns];
+
+        for (int k = 0; k < ns; ++k) {
+            const float *in = spectra[m_active[k]];
+            double re = in[i*2];
+            double im = in[i*2+1];
+            lm[k] = log10(sqrt(re * re + im * im) + epsilon);
+        }
+
+        if (i > 0 && i < n/2) {
+            // make the log magnitude spectrum symmetrical
+            double *mirror = &m_re[(n - i) * ns];
+            for (int k = 0; k < ns; ++k) {
+                mirror[k] = lm[k];
+            }
+        }
+    }
+
+    for (int i = 0; i < n * ns; ++i) {
+        m_im[i] = 0.0;
+    }
+}
+
+void
+LockstepTracker::transform()
+{
+    // In-place radix-2 inverse FFT of m_re, m_im, for all active
+    // streams at once, with the innermost loop of each butterfly
+    // across streams
+
+    int n = m_cepSize;
+    int ns = m_active.size();
+    double *re = &m_re[0];
+    double *im = &m_im[0];
+
+    for (int i = 0, j = 0; i < n; ++i) {
+        if (i < j) {
+            for (int s = 0; s < ns; ++s) {
+                double t = re[i*ns + s];
+                re[i*ns + s] = re[j*ns + s];
+                re[j*ns + s] = t;
+                t = im[i*ns + s];
+                im[i*ns + s] = im[j*ns + s];
+                im[j*ns + s] = t;
+            }
+        }
+        int bit = n >> 1;
+        while (bit > 0 && (j & bit)) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+
+    for (int size = 2; size <= n; size *= 2) {
+        int half = size / 2;
+        int tstep = n / size;
+        for (int start = 0; start < n; start += size) {
+            for (int k = 0; k < half; ++k) {
+                double wr = m_cos[k * tstep];
+                double wi = m_sin[k * tstep];
+                double *ar = re + (start + k) * ns;
+                double *ai = im + (start + k) * ns;
+                double *br = re + (start + k + half) * ns;
+                double *bi = im + (start + k + half) * ns;
+                for (int s = 0; s < ns; ++s) {
+                    double tr = br[s] * wr - bi[s] * wi;
+                    double ti = br[s] * wi + bi[s] * wr;
+                    br[s] = ar[s] - tr;
+                    bi[s] = ai[s] - ti;
+                    ar[s] += tr;
+                    ai[s] += ti;
+                }
+            }
+        }
+    }
+
+    double scale = 1.0 / n;
+    for (int i = 0; i < n * ns; ++i) {
+        re[i] *= scale;
+    }
+}
+
+void
+LockstepTracker::filter()
+{
+    // As MeanFilter::filterSubsequence() on the cepstrum in m_re,
+    // from m_binFrom for m_bins bins, into m_data
+
+    int n = m_cepSize;
+    int ns = m_active.size();
+    int half = m_vflen / 2;
+
+    for (int i = 0; i < m_bins; ++i) {
+
+        double *out = &m_data[i * ns];
+        for (int s = 0; s < ns; ++s) {
+            out[s] = 0.0;
+        }
+
+        int count = 0;
+        for (int j = -half; j <= half; ++j) {
+            int ix = i + j + m_binFrom;
+            if (ix < 0 || ix >= n) continue;
+            const double *in = &m_re[ix * ns];
+            for (int s = 0; s < ns; ++s) {
+                double value = in[s];
+                if (value == value) { // i.e. not NaN
+                    out[s] += value;
+                }
+            }
+            ++count;
+        }
+
+        if (count > 1) {
+            for (int s = 0; s < ns; ++s) {
+                out[s] /= count;
+            }
+        }
+    }
+}
+
+void
+LockstepTracker::findPeaks()
+{
+    // As in PitchTrackerEngine::searchCepstrum(), the highest value in
+    // m_data and the highest of the other local maxima
+
+    int ns = m_active.size();
+    int n = m_bins;
+
+    for (int s = 0; s < ns; ++s) {
+        m_maxval[s] = 0.0;
+        m_maxbin[s] = -1;
+        m_nextPeakVal[s] = 0.0;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        const double *d = &m_data[i * ns];
+        for (int s = 0; s < ns; ++s) {
+            bool higher = (d[s] > m_maxval[s]);
+            m_maxval[s] = higher ? d[s] : m_maxval[s];
+            m_maxbin[s] = higher ? i : m_maxbin[s];
+        }
+    }
+
+    for (int i = 1; i+1 < n; ++i) {
+        const double *prev = &m_data[(i-1) * ns];
+        const double *d = &m_data[i * ns];
+        const double *next = &m_data[(i+1) * ns];
+        for (int s = 0; s < ns; ++s) {
+            bool peak = (d[s] > prev[s] &&
+                         d[s] > next[s] &&
+                         i != m_maxbin[s] &&
+                         d[s] > m_nextPeakVal[s]);
+            m_nextPeakVal[s] = peak ? d[s] : m_nextPeakVal[s];
+        }
+    }
+}
+
+void
+LockstepTracker::addNewFeatures(int s, FeatureSet &fs)
+{
+    int n = m_feeders[s]->getAcceptedHypotheses().size();
+    if (n == m_nAccepted[s]) return;
+
+    const AgentFeeder::Hypotheses &accepted =
+        m_feeders[s]->getAcceptedHypotheses();
+
+    for (int i = m_nAccepted[s]; i < n; ++i) {
+        CepstralPitchTracker::addFeaturesFrom(accepted[i], fs);
+    }
+
+    m_nAccepted[s] = n;
+}
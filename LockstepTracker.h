@@ -0,0 +1,169 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _LOCKSTEP_TRACKER_H_
+#define _LOCKSTEP_TRACKER_H_
+
+#include "CepstralPitchTracker.h"
+#include "NoteHypothesis.h"
+#include "PitchTrackerEngine.h"
+
+#include <string>
+#include <vector>
+
+class AgentFeeder;
+
+/**
+ * Track the pitch of a number of independent mono streams together,
+ * all with the same sample rate and block size, advancing them in
+ * lockstep a frame at a time. This is for serving many real-time
+ * streams at once, where no single stream has a batch of frames to
+ * offer but every stream has one frame ready at each step.
+ *
+ * The per-frame analysis (log magnitude, cepstrum, filter and peak
+ * search) runs for all streams at once on data interleaved by
+ * stream, so that value i of the k'th stream analysed is at index
+ * i * count + k. Streams with no frame, or whose frame is below
+ * PitchTrackerEngine::MagnitudeGate, are left out of it.
+ * The innermost loop of each stage is across streams, with no
+ * dependency between them, so that the compiler can vectorise it
+ * with one stream per SIMD lane. Stream counts of 4, 8 or 16 fill the
+ * usual vector widths. Each stream has its own AgentFeeder, so the
+ * note tracking is independent.
+ *
+ * The f0 and notes features returned are those that
+ * CepstralPitchTracker would return with the same parameters, give
+ * or take rounding in the transform. The pitch range, cepstrum
+ * layout and peak interpolation are those of PitchTrackerEngine.
+ * Input spectra are in the same format as for the plugin.
+ */
+class LockstepTracker
+{
+public:
+    typedef Vamp::Plugin::FeatureSet FeatureSet;
+
+    /**
+     * Construct a tracker for the given number of streams, at the
+     * given sample rate and block size. The block size must be a
+     * power of two.
+     */
+    LockstepTracker(int streams, float sampleRate, int blockSize);
+    ~LockstepTracker();
+
+    int getStreamCount() const { return m_streams; }
+
+    /**
+     * Process one frame for every stream, given one spectrum pointer
+     * per stream. A null pointer means the stream has no frame at
+     * this step and is left as it is. Returns one feature set per
+     * stream, with f0 features in output 0 and notes in output 1 as
+     * for CepstralPitchTracker.
+     */
+    std::vector<FeatureSet> process(const float *const *spectra,
+                                    Vamp::RealTime timestamp);
+
+    /**
+     * Process one frame for every stream, as above, with a separate
+     * timestamp for each stream, for streams that did not all start
+     * at the same time.
+     */
+    std::vector<FeatureSet> process(const float *const *spectra,
+                                    const Vamp::RealTime *timestamps);
+
+    /**
+     * End a single stream, returning its remaining features. The
+     * stream is then reset, ready to be used for a new input.
+     */
+    FeatureSet finishStream(int stream);
+
+    /**
+     * End all streams, as finishStream() for each.
+     */
+    std::vector<FeatureSet> finish();
+
+    void reset();
+
+    /**
+     * Set the rules of the note tracking for every stream, in place
+     * of the defaults. This resets all streams.
+     */
+    void setNoteRules(const NoteHypothesis::Rules &rules);
+
+    /**
+     * Set a plugin parameter for every stream, by its identifier,
+     * resetting all streams. Only bandlimit can be applied in
+     * lockstep: skip, narrow, refine and dual make the analysis of
+     * a frame differ from one stream to another. Return false, and
+     * change nothing, for any of those set to other than its
+     * default, or for an unknown identifier.
+     */
+    bool setParameter(std::string identifier, float value);
+
+private:
+    LockstepTracker(const LockstepTracker &); // not provided
+    LockstepTracker &operator=(const LockstepTracker &); // not provided
+
+    int m_streams;
+    float m_sampleRate;
+    int m_blockSize;
+
+    // Holds the parameters, and gives the cepstrum layout for them
+    PitchTrackerEngine m_layout;
+    int m_cepSize;
+    float m_cepRate;
+    int m_vflen;
+    int m_binFrom;
+    int m_bins;
+
+    NoteHypothesis::Rules m_rules;
+    std::vector<AgentFeeder *> m_feeders;
+    std::vector<int> m_nAccepted;
+
+    // The streams analysed in the current frame
+    std::vector<int> m_active;
+
+    // Working data, interleaved by active stream
+    std::vector<double> m_re;
+    std::vector<double> m_im;
+    std::vector<double> m_data;
+    std::vector<double> m_magmean;
+
+    // Per-active-stream peak search results
+    std::vector<double> m_maxval;
+    std::vector<double> m_nextPeakVal;
+    std::vector<int> m_maxbin;
+
+    std::vector<double> m_cos;
+    std::vector<double> m_sin;
+
+    void setUp();
+    void logMagnitude(const float *const *spectra);
+    void transform();
+    void filter();
+    void findPeaks();
+    void addNewFeatures(int stream, FeatureSet &fs);
+};
+
+#endif
@@ -0,0 +1,102 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MappedFile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+using std::string;
+
+MappedFile::MappedFile() :
+    m_data(0),
+    m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void
+MappedFile::close()
+{
+    if (m_data) {
+        munmap((void *)m_data, m_size);
+    }
+    m_data = 0;
+    m_size = 0;
+}
+
+bool
+MappedFile::open(string path, Access access)
+{
+    close();
+    m_error = "";
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_error = "Failed to open " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        m_error = "Failed to find size of " + path + ", or it is empty";
+        ::close(fd);
+        return false;
+    }
+
+    void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED) {
+        m_error = "Failed to map " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    if (access != Normal) {
+        madvise(p, st.st_size,
+                access == Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+
+    m_data = (const unsigned char *)p;
+    m_size = st.st_size;
+    return true;
+}
+
+bool
+MappedFile::writePadded(FILE *out, const void *data, size_t bytes)
+{
+    static const char zeros[8] = { 0 };
+    if (bytes > 0 && fwrite(data, 1, bytes, out) != bytes) return false;
+    size_t pad = padded(bytes) - bytes;
+    return pad == 0 || fwrite(zeros, 1, pad, out) == pad;
+}
@@ -0,0 +1,89 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * A whole file mapped read-only into memory, as AudioFile, TrackFile
+ * and NoteIndex read their files. Also provides the padding used in
+ * writing files whose records are to be read straight from such a
+ * mapping.
+ */
+class MappedFile
+{
+public:
+    /**
+     * How the mapping will be read, as advice to the system.
+     */
+    enum Access {
+        Normal,
+        Sequential,
+        Random
+    };
+
+    MappedFile();
+    ~MappedFile();
+
+    /**
+     * Map the given file, unmapping any already mapped. Return false,
+     * with a message available from getError(), if it cannot be
+     * opened or mapped, or is empty.
+     */
+    bool open(std::string path, Access access);
+
+    void close();
+
+    const unsigned char *getData() const { return m_data; }
+    size_t getSize() const { return m_size; }
+    std::string getError() const { return m_error; }
+
+    /**
+     * Return the given byte count rounded up to a multiple of 8, the
+     * alignment of every table in the mapped file formats.
+     */
+    static uint64_t padded(uint64_t bytes) {
+        return (bytes + 7) & ~uint64_t(7);
+    }
+
+    /**
+     * Write the given bytes followed by zeros up to padded(bytes).
+     * Return false if the output fails.
+     */
+    static bool writePadded(FILE *out, const void *data, size_t bytes);
+
+private:
+    MappedFile(const MappedFile &); // not provided
+    MappedFile &operator=(const MappedFile &); // not provided
+
+    const unsigned char *m_data;
+    size_t m_size;
+    std::string m_error;
+};
+
+#endif
@@ -28,7 +28,25 @@
 
 using Vamp::RealTime;
 
-NoteHypothesis::NoteHypothesis()
+bool
+NoteHypothesis::Rules::set(std::string identifier, double value)
+{
+    if (identifier == "last-tolerance") {
+        lastTolerance = int(value);
+    } else if (identifier == "mean-tolerance") {
+        meanTolerance = int(value);
+    } else if (identifier == "max-gap") {
+        maximumGap = RealTime::fromSeconds(value / 1000.0);
+    } else if (identifier == "required-confidence") {
+        requiredConfidence = value;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+NoteHypothesis::NoteHypothesis(const Rules &rules) :
+    m_rules(rules)
 {
     m_state = New;
 }
@@ -49,13 +67,17 @@ NoteHypothesis::isWithinTolerance(Estimate s) const
     Estimate last = m_pending[m_pending.size()-1];
     double r = s.freq / last.freq;
     int cents = lrint(1200.0 * (log(r) / log(2.0)));
-    if (cents < -60 || cents > 60) return false;
+    if (cents < -m_rules.lastTolerance || cents > m_rules.lastTolerance) {
+        return false;
+    }
 
     // and within a slightly bigger tolerance of the current mean
     double meanFreq = getMeanFrequency();
     r = s.freq / meanFreq;
     cents = lrint(1200.0 * (log(r) / log(2.0)));
-    if (cents < -80 || cents > 80) return false;
+    if (cents < -m_rules.meanTolerance || cents > m_rules.meanTolerance) {
+        return false;
+    }
     
     return true;
 }
@@ -65,7 +87,7 @@ NoteHypothesis::isOutOfDateFor(Estimate s) const
 {
     if (m_pending.empty()) return false;
     return ((s.time - m_pending[m_pending.size()-1].time) > 
-            RealTime::fromMilliseconds(40));
+            m_rules.maximumGap);
 }
 
 bool 
@@ -81,7 +103,7 @@ NoteHypothesis::isSatisfied() const
 
     int lengthRequired = 100;
     if (meanConfidence > 0.0) {
-        lengthRequired = int(2.0 / meanConfidence + 0.5);
+        lengthRequired = int(m_rules.requiredConfidence / meanConfidence + 0.5);
     }
 
     return ((int)m_pending.size() > lengthRequired);
@@ -92,9 +114,7 @@ NoteHypothesis::accept(Estimate s)
 {
     bool accept = false;
 
-    static double negligibleConfidence = 0.0001;
-
-    if (s.confidence < negligibleConfidence) {
+    if (isNegligible(s)) {
         // avoid piling up a lengthy sequence of estimates that are
         // all acceptable but are in total not enough to cause us to
         // be satisfied
@@ -26,6 +26,7 @@
 #define _NOTE_HYPOTHESIS_H_
 
 #include "vamp-sdk/RealTime.h"
+#include <string>
 #include <vector>
 
 /**
@@ -57,10 +58,50 @@ public:
     };
     
     /**
-     * Construct an empty hypothesis. This will be in New state and
-     * will provisionally accept any estimate.
+     * The rules deciding which estimates belong together in a note,
+     * and when there are enough of them. The defaults are those the
+     * plugin uses.
      */
-    NoteHypothesis();
+    struct Rules {
+        Rules() :
+            lastTolerance(60),
+            meanTolerance(80),
+            maximumGap(Vamp::RealTime::fromMilliseconds(40)),
+            requiredConfidence(2.0) { }
+
+        /**
+         * Set a rule by its identifier: last-tolerance,
+         * mean-tolerance, max-gap (in milliseconds) or
+         * required-confidence. Return false if there is no such
+         * rule.
+         */
+        bool set(std::string identifier, double value);
+
+        /// Largest distance in cents from the last accepted estimate
+        int lastTolerance;
+
+        /// Largest distance in cents from the mean of those accepted
+        int meanTolerance;
+
+        /// Longest time allowed between consecutive accepted
+        /// estimates. A hypothesis offered a non-negligible estimate
+        /// any later than this after its last one is rejected, or
+        /// expires if it was satisfied
+        Vamp::RealTime maximumGap;
+
+        /// A hypothesis is satisfied once it has accepted more
+        /// estimates than this divided by their mean confidence,
+        /// that is, roughly once their confidences sum to more than
+        /// this
+        double requiredConfidence;
+    };
+
+    /**
+     * Construct an empty hypothesis, following the given rules. This
+     * will be in New state and will provisionally accept any
+     * estimate.
+     */
+    NoteHypothesis(const Rules &rules = Rules());
 
     /**
      * Destroy the hypothesis
@@ -80,6 +121,20 @@ public:
     };
     typedef std::vector<Estimate> Estimates;
 
+    /**
+     * Return true if the given estimate's confidence is too low for
+     * it to be accepted by any hypothesis. Such an estimate leaves a
+     * hypothesis that has already accepted something unchanged.
+     */
+    static bool isNegligible(const Estimate &e) {
+        return e.confidence < 0.0001;
+    }
+
+    /**
+     * Return the rules this hypothesis follows.
+     */
+    const Rules &getRules() const { return m_rules; }
+
     /**
      * Test the given estimate to see whether it is consistent with
      * this hypothesis, and adjust the hypothesis' internal state
@@ -134,6 +189,7 @@ private:
     
     State m_state;
     Estimates m_pending;
+    Rules m_rules;
 };
 
 #endif
@@ -0,0 +1,317 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "NoteIndex.h"
+#include "Seconds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+static const uint32_t version = 1;
+static const uint32_t byteOrder = 0x01020304;
+
+static_assert(sizeof(NoteIndex::Header) == 72 &&
+              sizeof(NoteIndex::FileRecord) == 32 &&
+              sizeof(NoteIndex::NoteRecord) == 32 &&
+              sizeof(NoteIndex::PitchRecord) == 8,
+              "note index records must have no padding");
+
+// Returned by the header accessors while no index is open
+static const NoteIndex::Header emptyHeader = NoteIndex::Header();
+
+static bool
+earlierStart(const NoteIndex::Note &a, const NoteIndex::Note &b)
+{
+    return a.time < b.time;
+}
+
+static bool
+lowerPitch(const NoteIndex::PitchRecord &a, const NoteIndex::PitchRecord &b)
+{
+    if (a.frequency != b.frequency) return a.frequency < b.frequency;
+    return a.note < b.note;
+}
+
+NoteIndex::NoteIndex() :
+    m_header(&emptyHeader),
+    m_files(0),
+    m_notes(0),
+    m_pitches(0),
+    m_names(0)
+{
+}
+
+NoteIndex::~NoteIndex()
+{
+    close();
+}
+
+void
+NoteIndex::close()
+{
+    m_file.close();
+    m_header = &emptyHeader;
+    m_files = 0;
+    m_notes = 0;
+    m_pitches = 0;
+    m_names = 0;
+}
+
+bool
+NoteIndex::open(string path)
+{
+    close();
+    m_error = "";
+
+    // Queries touch only a few pages each, scattered through the file
+    if (!m_file.open(path, MappedFile::Random)) {
+        m_error = m_file.getError();
+        return false;
+    }
+
+    const unsigned char *base = m_file.getData();
+    size_t size = m_file.getSize();
+
+    if (size < sizeof(Header)) {
+        m_error = path + ": Too short to be a note index";
+        close();
+        return false;
+    }
+
+    const Header *h = (const Header *)base;
+
+    if (memcmp(h->magic, "CPTI", 4)) {
+        m_error = path + ": Not a note index";
+    } else if (h->byteOrder != byteOrder) {
+        m_error = path + ": Written on a machine of different byte order";
+    } else if (h->version != version) {
+        m_error = path + ": Unsupported note index version";
+    } else {
+
+        // Each table must lie within the file and be aligned for its
+        // records. The counts are limited first, so that the lengths
+        // cannot overflow
+        uint64_t offsets[4] = {
+            h->fileOffset, h->noteOffset,
+            h->hasPitches ? h->pitchOffset : h->noteOffset, h->nameOffset
+        };
+        uint64_t lengths[4] = {
+            h->fileCount * uint64_t(sizeof(FileRecord)),
+            h->noteCount * sizeof(NoteRecord),
+            h->hasPitches ? h->noteCount * sizeof(PitchRecord) : 0,
+            h->nameBytes
+        };
+        if (h->noteCount > size || h->nameBytes > size) {
+            m_error = path + ": Truncated or corrupt note index";
+        }
+        for (int i = 0; i < 4 && m_error == ""; ++i) {
+            if ((offsets[i] & 7) ||
+                offsets[i] < sizeof(Header) ||
+                offsets[i] > size ||
+                lengths[i] > size - offsets[i]) {
+                m_error = path + ": Truncated or corrupt note index";
+            }
+        }
+    }
+
+    if (m_error != "") {
+        close();
+        return false;
+    }
+
+    m_header = h;
+    m_files = (const FileRecord *)(base + h->fileOffset);
+    m_notes = (const NoteRecord *)(base + h->noteOffset);
+    m_pitches = (h->hasPitches ?
+                 (const PitchRecord *)(base + h->pitchOffset) : 0);
+    m_names = (const char *)(base + h->nameOffset);
+    return true;
+}
+
+string
+NoteIndex::getFileName(int file) const
+{
+    const FileRecord &f = m_files[file];
+    if (f.nameStart > m_header->nameBytes ||
+        f.nameLength > m_header->nameBytes - f.nameStart) {
+        return "";
+    }
+    return string(m_names + f.nameStart, f.nameLength);
+}
+
+int
+NoteIndex::findFile(string name) const
+{
+    int lo = 0, hi = getFileCount();
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = getFileName(mid).compare(name);
+        if (c == 0) return mid;
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return -1;
+}
+
+void
+NoteIndex::findOverlapping(int file, double from, double to,
+                           vector<long> &notes) const
+{
+    const FileRecord &f = m_files[file];
+    if (f.firstNote > m_header->noteCount ||
+        f.noteCount > m_header->noteCount - f.firstNote) {
+        return;
+    }
+
+    // The first note that might overlap is the first by which some
+    // note has reached the start of the range
+    long lo = long(f.firstNote), hi = long(f.firstNote + f.noteCount);
+    long end = hi;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (m_notes[mid].maxEnd < from) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (long i = lo; i < end && m_notes[i].start <= to; ++i) {
+        if (m_notes[i].end >= from) {
+            notes.push_back(i);
+        }
+    }
+}
+
+bool
+NoteIndex::findNear(double hz, double cents, vector<long> &notes) const
+{
+    if (!m_pitches) return false;
+
+    double low = hz * pow(2.0, -cents / 1200.0);
+    double high = hz * pow(2.0, cents / 1200.0);
+
+    long lo = 0, hi = getNoteCount();
+    long end = hi;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (m_pitches[mid].frequency < low) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (long i = lo; i < end && m_pitches[i].frequency <= high; ++i) {
+        if (m_pitches[i].note < m_header->noteCount) {
+            notes.push_back(m_pitches[i].note);
+        }
+    }
+
+    return true;
+}
+
+bool
+NoteIndex::write(FILE *out, const vector<string> &names,
+                 const vector<Notes> &notes, bool pitchIndex)
+{
+    if (names.size() != notes.size()) return false;
+
+    vector<std::pair<string, int> > order;
+    for (int i = 0; i < (int)names.size(); ++i) {
+        order.push_back(std::make_pair(names[i], i));
+    }
+    std::sort(order.begin(), order.end());
+
+    vector<FileRecord> files(order.size());
+    vector<NoteRecord> records;
+    string nameData;
+
+    for (int i = 0; i < (int)order.size(); ++i) {
+
+        if (i > 0 && order[i].first == order[i-1].first) {
+            return false;
+        }
+
+        FileRecord &f = files[i];
+        f.nameStart = nameData.size();
+        f.nameLength = uint32_t(order[i].first.size());
+        f.reserved = 0;
+        f.firstNote = records.size();
+        nameData += order[i].first;
+
+        Notes sorted = notes[order[i].second];
+        std::stable_sort(sorted.begin(), sorted.end(), earlierStart);
+
+        double maxEnd = 0.0;
+        for (int j = 0; j < (int)sorted.size(); ++j) {
+            NoteRecord r;
+            r.start = toSeconds(sorted[j].time);
+            r.end = toSeconds(sorted[j].time + sorted[j].duration);
+            if (j == 0 || r.end > maxEnd) maxEnd = r.end;
+            r.maxEnd = maxEnd;
+            r.frequency = float(sorted[j].freq);
+            r.file = uint32_t(i);
+            records.push_back(r);
+        }
+
+        f.noteCount = records.size() - f.firstNote;
+    }
+
+    if (records.size() > UINT32_MAX) return false;
+
+    vector<PitchRecord> pitches;
+    if (pitchIndex) {
+        pitches.resize(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            pitches[i].frequency = records[i].frequency;
+            pitches[i].note = uint32_t(i);
+        }
+        std::sort(pitches.begin(), pitches.end(), lowerPitch);
+    }
+
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "CPTI", 4);
+    h.version = version;
+    h.byteOrder = byteOrder;
+    h.hasPitches = pitchIndex ? 1 : 0;
+    h.fileCount = uint32_t(files.size());
+    h.noteCount = records.size();
+    h.fileOffset = sizeof(Header);
+    size_t fileBytes = files.size() * sizeof(FileRecord);
+    size_t noteBytes = records.size() * sizeof(NoteRecord);
+    size_t pitchBytes = pitches.size() * sizeof(PitchRecord);
+
+    h.noteOffset = h.fileOffset + fileBytes;
+    h.pitchOffset = (pitchIndex ? h.noteOffset + noteBytes : 0);
+    h.nameOffset = h.noteOffset + noteBytes + pitchBytes;
+    h.nameBytes = nameData.size();
+
+    return MappedFile::writePadded(out, &h, sizeof(h)) &&
+        MappedFile::writePadded(out, files.data(), fileBytes) &&
+        MappedFile::writePadded(out, records.data(), noteBytes) &&
+        MappedFile::writePadded(out, pitches.data(), pitchBytes) &&
+        MappedFile::writePadded(out, nameData.data(), nameData.size());
+}
@@ -0,0 +1,170 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _NOTE_INDEX_H_
+#define _NOTE_INDEX_H_
+
+#include "MappedFile.h"
+#include "NoteHypothesis.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * An on-disk index of the notes found in many files, for time range
+ * and pitch queries over a whole corpus without reading any of the
+ * analysis output. NoteIndex::write() writes one at the end of an
+ * analysis, and NoteIndex maps one for querying.
+ *
+ * All values are in the writing machine's byte order, which the
+ * reader checks. The file is:
+ *
+ *   Header   72 bytes, see below
+ *   files    fileCount x FileRecord (32 bytes each), sorted by name
+ *   notes    noteCount x NoteRecord (32 bytes each)
+ *   pitches  noteCount x PitchRecord (8 bytes each), if present
+ *   names    the file names, not terminated, padded to 8 bytes
+ *
+ * The notes of each file are consecutive, in the order of the file
+ * table, and sorted by start time. Each also holds the latest end
+ * time of any note of its file up to and including itself, so the
+ * first note overlapping a time range is found by binary search even
+ * if the notes of a file overlap one another (which those from a
+ * single tracker never do). The pitch table, if written, lists every
+ * note in order of frequency, so that the notes near a given pitch
+ * are found by binary search too.
+ *
+ * Times are in seconds from the start of each file.
+ */
+class NoteIndex
+{
+public:
+    typedef NoteHypothesis::Note Note;
+    typedef std::vector<Note> Notes;
+
+    struct Header {
+        char magic[4];          // "CPTI"
+        uint32_t version;       // 1
+        uint32_t byteOrder;     // 0x01020304, as written
+        uint32_t hasPitches;    // 1 if the pitch table is present
+        uint32_t fileCount;
+        uint32_t reserved;
+        uint64_t noteCount;
+        uint64_t fileOffset;    // byte offsets from the start of the file
+        uint64_t noteOffset;
+        uint64_t pitchOffset;   // 0 if there is no pitch table
+        uint64_t nameOffset;
+        uint64_t nameBytes;
+    };
+
+    struct FileRecord {
+        uint64_t nameStart;     // offset within the names
+        uint32_t nameLength;
+        uint32_t reserved;
+        uint64_t firstNote;
+        uint64_t noteCount;
+    };
+
+    struct NoteRecord {
+        double start;
+        double end;
+        double maxEnd;          // latest end of this file's notes so far
+        float frequency;
+        uint32_t file;          // index in the file table
+    };
+
+    struct PitchRecord {
+        float frequency;
+        uint32_t note;
+    };
+
+    NoteIndex();
+    ~NoteIndex();
+
+    /**
+     * Map an index. Return false, with a message available from
+     * getError(), if it cannot be opened or is not a valid index
+     * written on a machine of the same byte order.
+     */
+    bool open(std::string path);
+
+    void close();
+
+    std::string getError() const { return m_error; }
+
+    int getFileCount() const { return m_header->fileCount; }
+    long getNoteCount() const { return long(m_header->noteCount); }
+    bool hasPitchIndex() const { return m_pitches != 0; }
+
+    std::string getFileName(int file) const;
+    const FileRecord &getFile(int file) const { return m_files[file]; }
+    const NoteRecord &getNote(long note) const { return m_notes[note]; }
+
+    /**
+     * Return the index in the file table of the file of the given
+     * name, or -1 if there is none.
+     */
+    int findFile(std::string name) const;
+
+    /**
+     * Append to the given vector the indices of the notes of the
+     * given file that overlap the time range from..to, inclusive, in
+     * order of start time.
+     */
+    void findOverlapping(int file, double from, double to,
+                         std::vector<long> &notes) const;
+
+    /**
+     * Append to the given vector the indices of all notes, in any
+     * file, within the given number of cents of the given frequency,
+     * in order of frequency. Return false if there is no pitch table.
+     */
+    bool findNear(double hz, double cents, std::vector<long> &notes) const;
+
+    /**
+     * Write an index of the notes of the given files, given by name,
+     * with notes[i] being those of names[i], as the plugin or
+     * OfflineAnalyser returns them. The names must be distinct.
+     * Return false if they are not, or if the output fails.
+     */
+    static bool write(FILE *out, const std::vector<std::string> &names,
+                      const std::vector<Notes> &notes, bool pitchIndex);
+
+private:
+    NoteIndex(const NoteIndex &); // not provided
+    NoteIndex &operator=(const NoteIndex &); // not provided
+
+    MappedFile m_file;
+    const Header *m_header;
+    const FileRecord *m_files;
+    const NoteRecord *m_notes;
+    const PitchRecord *m_pitches;
+    const char *m_names;
+    std::string m_error;
+};
+
+#endif
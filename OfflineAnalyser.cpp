@@ -0,0 +1,479 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "OfflineAnalyser.h"
+#include "AgentFeeder.h"
+#include "Stft.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <mutex>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+// Frames per unit of work in the estimate stage. Each chunk reuses
+// one set of buffers throughout, and is long enough that taking it
+// from the pool costs little by comparison
+static const int chunkFrames = 64;
+
+/**
+ * Everything one thread needs to estimate a run of frames: its own
+ * plugin instance (whose estimate() keeps working state in the
+ * object) and its own transform buffers.
+ */
+class OfflineAnalyser::Estimator
+{
+public:
+    Estimator(CepstralPitchTracker *tracker, int blockSize) :
+        m_tracker(tracker), m_stft(blockSize),
+        m_block(blockSize), m_spectrum(blockSize + 2) { }
+    ~Estimator() { delete m_tracker; }
+
+    void estimate(const Source &source, const OfflineAnalyser *a,
+                  int frame, OfflineAnalyser::Frame &f) {
+
+        long start = long(frame) * a->m_stepSize;
+        const float *in = a->readBlock(source, start, m_block);
+
+        m_stft.process(in, &m_spectrum[0]);
+
+        f.present = m_tracker->estimateFrame
+            (&m_spectrum[0], a->getFrameTime(frame), f.estimate);
+    }
+
+private:
+    CepstralPitchTracker *m_tracker;
+    Stft m_stft;
+    vector<float> m_block;
+    vector<float> m_spectrum;
+};
+
+class OfflineAnalyser::EstimateTask : public ThreadPool::Task
+{
+public:
+    EstimateTask(OfflineAnalyser *analyser, const Source &source,
+                 Frames &frames, vector<Estimator *> &estimators) :
+        m_analyser(analyser), m_source(source),
+        m_frames(frames), m_estimators(estimators) { }
+
+    void run(int chunk) {
+
+        // Borrow an estimator for the length of the chunk, so that no
+        // two threads use one at the same time
+        Estimator *e = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            e = m_estimators.back();
+            m_estimators.pop_back();
+        }
+
+        int from = chunk * chunkFrames;
+        int to = std::min(from + chunkFrames, int(m_frames.size()));
+        for (int i = from; i < to; ++i) {
+            e->estimate(m_source, m_analyser, i, m_frames[i]);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_estimators.push_back(e);
+    }
+
+private:
+    OfflineAnalyser *m_analyser;
+    const Source &m_source;
+    Frames &m_frames;
+    vector<Estimator *> &m_estimators;
+    std::mutex m_mutex;
+};
+
+class OfflineAnalyser::TrackTask : public ThreadPool::Task
+{
+public:
+    TrackTask(const Frames &frames, const vector<int> &bounds,
+              const NoteHypothesis::Rules &rules) :
+        results(bounds.size() - 1), m_frames(frames), m_bounds(bounds),
+        m_rules(rules) { }
+
+    vector<AgentFeeder::Hypotheses> results;
+
+    void run(int segment) {
+        AgentFeeder feeder(m_rules);
+        for (int i = m_bounds[segment]; i < m_bounds[segment + 1]; ++i) {
+            if (m_frames[i].present) {
+                feeder.feed(m_frames[i].estimate);
+            }
+        }
+        feeder.finish();
+        results[segment] = feeder.getAcceptedHypotheses();
+    }
+
+private:
+    const Frames &m_frames;
+    const vector<int> &m_bounds;
+    NoteHypothesis::Rules m_rules;
+};
+
+/**
+ * Collects the results of the serial analysis as records.
+ */
+class OfflineAnalyser::RecordSink : public ResultSink
+{
+public:
+    RecordSink(NoteHypothesis::Estimates &pitches, Notes &notes) :
+        m_pitches(pitches), m_notes(notes) { }
+
+    void onEstimate(const NoteHypothesis::Estimate &e) {
+        m_pitches.push_back(e);
+    }
+    void onNoteComplete(const NoteHypothesis::Note &n) {
+        m_notes.push_back(n);
+    }
+
+private:
+    NoteHypothesis::Estimates &m_pitches;
+    Notes &m_notes;
+};
+
+OfflineAnalyser::OfflineAnalyser(float sampleRate, int stepSize,
+                                 int blockSize, int threads) :
+    m_sampleRate(sampleRate),
+    m_stepSize(stepSize),
+    m_blockSize(blockSize)
+{
+    if (threads < 1) {
+        threads = std::thread::hardware_concurrency();
+        if (threads < 1) threads = 1;
+    }
+    m_pool = new ThreadPool(threads);
+}
+
+OfflineAnalyser::~OfflineAnalyser()
+{
+    delete m_pool;
+}
+
+void
+OfflineAnalyser::setParameter(string identifier, float value)
+{
+    m_params[identifier] = value;
+}
+
+bool
+OfflineAnalyser::hasIndependentEstimates() const
+{
+    CepstralPitchTracker tracker(m_sampleRate);
+    for (std::map<string, float>::const_iterator i = m_params.begin();
+         i != m_params.end(); ++i) {
+        tracker.setParameter(i->first, i->second);
+    }
+    return tracker.hasIndependentEstimates();
+}
+
+int
+OfflineAnalyser::getFrameCount(long samples) const
+{
+    return getFrameCount(samples, m_stepSize);
+}
+
+int
+OfflineAnalyser::getFrameCount(long samples, int stepSize)
+{
+    return int((samples + stepSize - 1) / stepSize);
+}
+
+RealTime
+OfflineAnalyser::getFrameTime(int frame) const
+{
+    return RealTime::frame2RealTime
+        (long(frame) * m_stepSize + m_blockSize/2,
+         (unsigned int)(m_sampleRate));
+}
+
+const float *
+OfflineAnalyser::readBlock(const Source &source, long start,
+                           vector<float> &buffer) const
+{
+    // A block lying within an array is used in place. Otherwise it
+    // is read into the buffer, padded with zeros if it runs past the
+    // end of the input
+    long n = source.getLength();
+    const float *data = source.getData();
+    if (data && start + m_blockSize <= n) {
+        return data + start;
+    }
+    long count = std::max(0L, std::min(long(m_blockSize), n - start));
+    if (count > 0) {
+        source.read(start, count, &buffer[0]);
+    }
+    std::fill(buffer.begin() + count, buffer.end(), 0.f);
+    return &buffer[0];
+}
+
+CepstralPitchTracker *
+OfflineAnalyser::makeTracker() const
+{
+    CepstralPitchTracker *tracker = new CepstralPitchTracker(m_sampleRate);
+    for (std::map<string, float>::const_iterator i = m_params.begin();
+         i != m_params.end(); ++i) {
+        tracker->setParameter(i->first, i->second);
+    }
+    tracker->setNoteRules(m_rules);
+    if (!tracker->initialise(1, m_stepSize, m_blockSize)) {
+        delete tracker;
+        return 0;
+    }
+    return tracker;
+}
+
+bool
+OfflineAnalyser::analyse(const float *samples, long n, FeatureSet &features)
+{
+    return analyse(ArraySource(samples, n), features);
+}
+
+bool
+OfflineAnalyser::analyse(const Source &source, FeatureSet &features)
+{
+    features.clear();
+
+    if (!hasIndependentEstimates()) {
+        return analyseSerially(source, features);
+    }
+
+    Frames frames;
+    if (!estimate(source, frames)) {
+        return false;
+    }
+
+    features = track(frames);
+    return true;
+}
+
+bool
+OfflineAnalyser::analyse(const float *samples, long n,
+                         NoteHypothesis::Estimates &pitches, Notes &notes)
+{
+    return analyse(ArraySource(samples, n), pitches, notes);
+}
+
+bool
+OfflineAnalyser::analyse(const Source &source,
+                         NoteHypothesis::Estimates &pitches, Notes &notes)
+{
+    pitches.clear();
+    notes.clear();
+
+    if (!hasIndependentEstimates()) {
+        FeatureSet unused;
+        RecordSink sink(pitches, notes);
+        return analyseSerially(source, unused, &sink);
+    }
+
+    Frames frames;
+    if (!estimate(source, frames)) {
+        return false;
+    }
+
+    track(frames, pitches, notes);
+    return true;
+}
+
+bool
+OfflineAnalyser::estimate(const float *samples, long n, Frames &frames)
+{
+    return estimate(ArraySource(samples, n), frames);
+}
+
+bool
+OfflineAnalyser::estimate(const Source &source, Frames &frames)
+{
+    frames.clear();
+
+    if (!hasIndependentEstimates()) {
+        return false;
+    }
+
+    frames.resize(getFrameCount(source.getLength()));
+    int chunks = (int(frames.size()) + chunkFrames - 1) / chunkFrames;
+
+    vector<Estimator *> estimators;
+    int count = std::min(m_pool->getThreadCount(), chunks);
+    for (int i = 0; i < count; ++i) {
+        CepstralPitchTracker *tracker = makeTracker();
+        if (!tracker) break;
+        estimators.push_back(new Estimator(tracker, m_blockSize));
+    }
+
+    if ((int)estimators.size() < count) {
+        for (int i = 0; i < (int)estimators.size(); ++i) {
+            delete estimators[i];
+        }
+        frames.clear();
+        return false;
+    }
+
+    EstimateTask task(this, source, frames, estimators);
+    m_pool->run(task, chunks);
+
+    for (int i = 0; i < (int)estimators.size(); ++i) {
+        delete estimators[i];
+    }
+
+    return true;
+}
+
+vector<int>
+OfflineAnalyser::getSegmentBounds(const Frames &frames) const
+{
+    // Divide the frames at reset points into a few segments per
+    // thread, of roughly equal length where the reset points allow,
+    // for each to be tracked with its own AgentFeeder
+    vector<int> bounds(1, 0);
+    int threads = m_pool->getThreadCount();
+
+    if (threads > 1) {
+        int target = int(frames.size()) / (threads * 4);
+        vector<int> resets = findResetPoints(frames, m_rules);
+        for (int i = 0; i < (int)resets.size(); ++i) {
+            if (resets[i] - bounds.back() >= target && resets[i] > 0) {
+                bounds.push_back(resets[i]);
+            }
+        }
+    }
+
+    bounds.push_back(frames.size());
+    return bounds;
+}
+
+OfflineAnalyser::FeatureSet
+OfflineAnalyser::track(const Frames &frames)
+{
+    vector<int> bounds = getSegmentBounds(frames);
+    TrackTask task(frames, bounds, m_rules);
+    m_pool->run(task, bounds.size() - 1);
+
+    FeatureSet features;
+    features[0];
+    features[1];
+
+    for (int s = 0; s < (int)task.results.size(); ++s) {
+        const AgentFeeder::Hypotheses &accepted = task.results[s];
+        for (int i = 0; i < (int)accepted.size(); ++i) {
+            CepstralPitchTracker::addFeaturesFrom(accepted[i], features);
+        }
+    }
+
+    return features;
+}
+
+void
+OfflineAnalyser::track(const Frames &frames,
+                       NoteHypothesis::Estimates &pitches, Notes &notes)
+{
+    pitches.clear();
+    notes.clear();
+
+    vector<int> bounds = getSegmentBounds(frames);
+    TrackTask task(frames, bounds, m_rules);
+    m_pool->run(task, bounds.size() - 1);
+
+    for (int s = 0; s < (int)task.results.size(); ++s) {
+        const AgentFeeder::Hypotheses &accepted = task.results[s];
+        for (int i = 0; i < (int)accepted.size(); ++i) {
+            NoteHypothesis::Estimates es = accepted[i].getAcceptedEstimates();
+            pitches.insert(pitches.end(), es.begin(), es.end());
+            notes.push_back(accepted[i].getAveragedNote());
+        }
+    }
+}
+
+vector<int>
+OfflineAnalyser::findResetPoints(const Frames &frames,
+                                 const NoteHypothesis::Rules &rules)
+{
+    // Negligible estimates never change a hypothesis that has
+    // accepted anything, and are never accepted by a new one, so
+    // only the gaps between non-negligible ones count
+    vector<int> resets;
+    RealTime maxGap = rules.maximumGap;
+    RealTime last;
+    bool haveLast = false;
+
+    for (int i = 0; i < (int)frames.size(); ++i) {
+        const Frame &f = frames[i];
+        if (!f.present || NoteHypothesis::isNegligible(f.estimate)) {
+            continue;
+        }
+        if (!haveLast || f.estimate.time - last > maxGap) {
+            resets.push_back(i);
+        }
+        last = f.estimate.time;
+        haveLast = true;
+    }
+
+    return resets;
+}
+
+bool
+OfflineAnalyser::analyseSerially(const Source &source,
+                                 FeatureSet &features, ResultSink *sink)
+{
+    CepstralPitchTracker *tracker = makeTracker();
+    if (!tracker) return false;
+
+    // With a sink, the plugin passes its results there instead
+    tracker->setResultSink(sink);
+
+    Stft stft(m_blockSize);
+    vector<float> block(m_blockSize);
+    vector<float> spectrum(m_blockSize + 2);
+    const float *in = &spectrum[0];
+
+    features[0];
+    features[1];
+
+    int frames = getFrameCount(source.getLength());
+
+    for (int i = 0; i <= frames; ++i) {
+
+        FeatureSet fs;
+
+        if (i < frames) {
+            long start = long(i) * m_stepSize;
+            stft.process(readBlock(source, start, block), &spectrum[0]);
+            fs = tracker->process(&in, getFrameTime(i));
+        } else {
+            fs = tracker->getRemainingFeatures();
+        }
+
+        for (int o = 0; o < 2; ++o) {
+            features[o].insert(features[o].end(), fs[o].begin(), fs[o].end());
+        }
+    }
+
+    delete tracker;
+    return true;
+}
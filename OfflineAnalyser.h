@@ -0,0 +1,248 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _OFFLINE_ANALYSER_H_
+#define _OFFLINE_ANALYSER_H_
+
+#include "CepstralPitchTracker.h"
+#include "NoteHypothesis.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Track the pitch of a whole mono recording at once, using several
+ * threads.
+ *
+ * The per-frame estimates of CepstralPitchTracker do not depend on
+ * one another, so they are calculated in parallel, in chunks of
+ * consecutive frames, each chunk converting its own audio to the
+ * frequency domain as it goes. Only the note tracking needs to see
+ * the estimates in order, and that then runs over the whole series
+ * in order. The tracking is also split, at frames where its state is
+ * certain to start afresh (see findResetPoints()), and the pieces
+ * run in parallel. The features returned are exactly those that the
+ * plugin would return for the same frames.
+ *
+ * With the skip or narrow parameters set, the estimate for a frame
+ * depends on the note tracking so far, and the analyser falls back
+ * to running the plugin over the frames in a single thread.
+ *
+ * Frame i covers samples i * step to i * step + block - 1, with
+ * zeros after the end of the input, and has its timestamp at the
+ * centre of the block, as a host would give it. There are enough
+ * frames to start one at every step through the input.
+ */
+class OfflineAnalyser
+{
+public:
+    typedef Vamp::Plugin::FeatureSet FeatureSet;
+
+    /**
+     * The mono input samples, read a block at a time as the frames
+     * are cut from them. This lets input that is not already an
+     * array of floats (for example, a file of another sample format)
+     * be converted as it is analysed rather than all at once. read()
+     * may be called from several threads at the same time.
+     */
+    class Source
+    {
+    public:
+        virtual ~Source() { }
+
+        virtual long getLength() const = 0;
+
+        /**
+         * Write count samples, starting at the given one, to out. The
+         * range always lies within the input.
+         */
+        virtual void read(long from, long count, float *out) const = 0;
+
+        /**
+         * If the samples are available as an array, return it, so
+         * that blocks are taken from it with no copy. Otherwise
+         * return 0.
+         */
+        virtual const float *getData() const { return 0; }
+    };
+
+    /**
+     * A Source for samples that are already an array of floats.
+     */
+    class ArraySource : public Source
+    {
+    public:
+        ArraySource(const float *samples, long n) :
+            m_samples(samples), m_n(n) { }
+
+        long getLength() const { return m_n; }
+        void read(long from, long count, float *out) const {
+            std::copy(m_samples + from, m_samples + from + count, out);
+        }
+        const float *getData() const { return m_samples; }
+
+    private:
+        const float *m_samples;
+        long m_n;
+    };
+
+    /**
+     * Construct an analyser for input at the given sample rate, with
+     * the given step and block sizes (as for the plugin), using the
+     * given number of threads, or as many as the hardware supports
+     * if threads is zero.
+     */
+    OfflineAnalyser(float sampleRate, int stepSize, int blockSize,
+                    int threads = 0);
+    ~OfflineAnalyser();
+
+    /**
+     * Set a parameter of the plugin, by its identifier.
+     */
+    void setParameter(std::string identifier, float value);
+
+    /**
+     * Set the rules of the note tracking, in place of the defaults.
+     */
+    void setNoteRules(const NoteHypothesis::Rules &rules) { m_rules = rules; }
+
+    /**
+     * Return true if the estimate stage may be run separately from
+     * the tracking stage, i.e. if neither the skip nor the narrow
+     * parameter is in use.
+     */
+    bool hasIndependentEstimates() const;
+
+    int getFrameCount(long samples) const;
+    static int getFrameCount(long samples, int stepSize);
+    Vamp::RealTime getFrameTime(int frame) const;
+
+    /**
+     * The estimate for a single frame. If present is false, there is
+     * no estimate and nothing is fed to the note tracking for it (as
+     * for a frame of digital silence).
+     */
+    struct Frame {
+        Frame() : present(false) { }
+        NoteHypothesis::Estimate estimate;
+        bool present;
+    };
+    typedef std::vector<Frame> Frames;
+
+    /**
+     * Analyse the given n samples, returning the f0 features in
+     * output 0 and the notes in output 1. Return false if the plugin
+     * could not be initialised with the sizes and parameters given.
+     */
+    bool analyse(const float *samples, long n, FeatureSet &features);
+
+    /**
+     * Analyse the samples of the given source, as above.
+     */
+    bool analyse(const Source &source, FeatureSet &features);
+
+    typedef std::vector<NoteHypothesis::Note> Notes;
+
+    /**
+     * Analyse the given n samples as above, but return the f0
+     * estimates and notes as records, in the same order as the
+     * features, with the confidence of each estimate too.
+     */
+    bool analyse(const float *samples, long n,
+                 NoteHypothesis::Estimates &pitches, Notes &notes);
+
+    bool analyse(const Source &source,
+                 NoteHypothesis::Estimates &pitches, Notes &notes);
+
+    /**
+     * Run only the estimate stage over the given n samples, writing
+     * one Frame per frame. This requires hasIndependentEstimates();
+     * return false if it is not, or if the plugin could not be
+     * initialised.
+     */
+    bool estimate(const float *samples, long n, Frames &frames);
+
+    bool estimate(const Source &source, Frames &frames);
+
+    /**
+     * Run only the tracking stage over a series of frame estimates,
+     * returning the features as for analyse().
+     */
+    FeatureSet track(const Frames &frames);
+
+    /**
+     * Run only the tracking stage, returning records as for the
+     * second form of analyse().
+     */
+    void track(const Frames &frames, NoteHypothesis::Estimates &pitches,
+               Notes &notes);
+
+    /**
+     * Return the indices of the frames at which the note tracking,
+     * fed the given frames in order, discards everything it has seen
+     * before. These are the frames with a non-negligible estimate
+     * that comes more than the maximum gap allowed within a note,
+     * under the given rules, after the previous one. Every hypothesis
+     * is out of date for such a frame, so the current note ends and
+     * all candidates are dropped, leaving the same state as a new
+     * AgentFeeder would have after it. Tracking the frames from each
+     * of these points separately, and concatenating the accepted
+     * hypotheses, gives the same result as tracking them all at
+     * once. The first frame with a non-negligible estimate is always
+     * included.
+     */
+    static std::vector<int> findResetPoints
+    (const Frames &frames,
+     const NoteHypothesis::Rules &rules = NoteHypothesis::Rules());
+
+private:
+    OfflineAnalyser(const OfflineAnalyser &); // not provided
+    OfflineAnalyser &operator=(const OfflineAnalyser &); // not provided
+
+    float m_sampleRate;
+    int m_stepSize;
+    int m_blockSize;
+    std::map<std::string, float> m_params;
+    NoteHypothesis::Rules m_rules;
+    ThreadPool *m_pool;
+
+    class Estimator;
+    class EstimateTask;
+    class TrackTask;
+    class RecordSink;
+
+    CepstralPitchTracker *makeTracker() const;
+    const float *readBlock(const Source &source, long start,
+                           std::vector<float> &buffer) const;
+    std::vector<int> getSegmentBounds(const Frames &frames) const;
+    bool analyseSerially(const Source &source, FeatureSet &features,
+                         ResultSink *sink = 0);
+};
+
+#endif
@@ -0,0 +1,541 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PitchServer.h"
+#include "CepstralPitchTracker.h"
+#include "Seconds.h"
+#include "Stft.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+
+// Largest payload accepted from a client, to bound the memory one
+// misbehaving connection can take
+static const uint32_t maxPayload = 16 << 20;
+
+// Most reply bytes held back for a client that is not reading them.
+// Beyond this, nothing more is read from the client until they have
+// been sent, so that its replies cannot grow without bound
+static const size_t maxOutput = 1 << 20;
+
+// A client that goes away must not kill the server with SIGPIPE. Where
+// send() has no flag to prevent that (OS X), each connection has the
+// SO_NOSIGPIPE option set instead
+#ifdef MSG_NOSIGNAL
+static const int sendFlags = MSG_NOSIGNAL;
+#else
+static const int sendFlags = 0;
+#endif
+
+static bool
+sendAll(int fd, const void *data, size_t length)
+{
+    const char *p = (const char *)data;
+    while (length > 0) {
+        ssize_t n = send(fd, p, length, sendFlags);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool
+receiveAll(int fd, void *data, size_t length)
+{
+    char *p = (char *)data;
+    while (length > 0) {
+        ssize_t n = recv(fd, p, length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool
+PitchServer::writeMessage(int fd, uint32_t tag, const void *payload,
+                          uint32_t length)
+{
+    uint32_t header[2] = { tag, length };
+    return sendAll(fd, header, sizeof(header)) &&
+        (length == 0 || sendAll(fd, payload, length));
+}
+
+bool
+PitchServer::readMessage(int fd, uint32_t &tag, vector<char> &payload)
+{
+    uint32_t header[2];
+    if (!receiveAll(fd, header, sizeof(header))) return false;
+    if (header[1] > maxPayload) return false;
+    tag = header[0];
+    payload.resize(header[1]);
+    return header[1] == 0 || receiveAll(fd, &payload[0], header[1]);
+}
+
+/**
+ * The state of one client connection, and of the stream (if any) in
+ * progress on it.
+ */
+class PitchServer::Connection
+{
+public:
+    Connection(PitchServer *server, int fd) :
+        m_server(server), m_fd(fd), m_tracker(0), m_stft(0),
+        m_kind(PcmInput), m_bufferStart(0), m_frame(0),
+        m_outputSent(0) { }
+
+    ~Connection() {
+        endStream();
+    }
+
+    void run() {
+        uint32_t tag;
+        vector<char> payload;
+        while (PitchServer::readMessage(m_fd, tag, payload)) {
+            if (!handle(tag, payload)) break;
+            if (!flush(m_output.size() - m_outputSent > maxOutput)) break;
+        }
+    }
+
+private:
+    PitchServer *m_server;
+    int m_fd;
+
+    CepstralPitchTracker *m_tracker;
+    Format m_format;
+    Stft *m_stft;
+    InputKind m_kind;
+
+    vector<float> m_buffer;   // PCM samples from m_bufferStart on
+    long m_bufferStart;
+    long m_frame;             // next PCM frame to analyse
+    vector<float> m_spectrum;
+
+    // Replies not yet sent. These are sent as far as the socket will
+    // take them without blocking after each message read, so that a
+    // client that sends a whole stream before reading the replies
+    // does not leave us both blocked in send; they are much smaller
+    // than the input they come from
+    vector<char> m_output;
+    size_t m_outputSent;
+
+    void queue(uint32_t tag, const void *payload, uint32_t length) {
+        uint32_t header[2] = { tag, length };
+        const char *h = (const char *)header;
+        const char *p = (const char *)payload;
+        m_output.insert(m_output.end(), h, h + sizeof(header));
+        m_output.insert(m_output.end(), p, p + length);
+    }
+
+    bool flush(bool wait) {
+        while (m_outputSent < m_output.size()) {
+            ssize_t n = ::send(m_fd, &m_output[m_outputSent],
+                               m_output.size() - m_outputSent,
+                               sendFlags | (wait ? 0 : MSG_DONTWAIT));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && !wait && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            }
+            if (n <= 0) return false;
+            m_outputSent += n;
+        }
+        m_output.clear();
+        m_outputSent = 0;
+        return true;
+    }
+
+    bool fail(string message) {
+        endStream();
+        queue(Error, message.c_str(), message.size());
+        return flush(true);
+    }
+
+    void endStream() {
+        if (m_tracker) {
+            m_server->release(m_format, m_tracker);
+            m_tracker = 0;
+        }
+        delete m_stft;
+        m_stft = 0;
+    }
+
+    bool handle(uint32_t tag, const vector<char> &payload) {
+
+        if (tag == Start) {
+            if (m_tracker) return fail("Stream already started");
+            if (payload.size() != 16) return fail("Invalid start message");
+            float rate;
+            uint32_t values[3];
+            memcpy(&rate, &payload[0], 4);
+            memcpy(values, &payload[4], 12);
+            if (values[0] > (uint32_t)MaxBlockSize) {
+                return fail("Block size too large");
+            }
+            m_format.rate = rate;
+            m_format.block = values[0];
+            m_format.step = values[1];
+            if (values[2] > SpectrumInput) return fail("Unknown input kind");
+            m_kind = InputKind(values[2]);
+
+            // Checked before looking in the pool, whose ordering a
+            // NaN rate would break
+            if (!isSupported(m_format)) {
+                return fail("Unsupported stream format");
+            }
+            m_tracker = m_server->acquire(m_format);
+            if (!m_tracker) return fail("Unsupported stream format");
+            if (m_kind == PcmInput) {
+                m_stft = new Stft(m_format.block);
+            }
+            m_buffer.clear();
+            m_bufferStart = 0;
+            m_frame = 0;
+            m_spectrum.resize(m_format.block + 2);
+            return true;
+        }
+
+        if (!m_tracker) return fail("No stream started");
+
+        if (tag == Pcm && m_kind == PcmInput) {
+            if (payload.size() % 4) return fail("Invalid PCM message");
+            size_t n = payload.size() / 4;
+            size_t at = m_buffer.size();
+            m_buffer.resize(at + n);
+            if (n > 0) memcpy(&m_buffer[at], &payload[0], n * 4);
+            processPcm(false);
+            return true;
+        }
+
+        if (tag == Spectrum && m_kind == SpectrumInput) {
+            size_t values = m_format.block + 2;
+            if (payload.size() != 8 + values * 4) {
+                return fail("Invalid spectrum message");
+            }
+            double t;
+            memcpy(&t, &payload[0], 8);
+            memcpy(&m_spectrum[0], &payload[8], values * 4);
+            const float *in = &m_spectrum[0];
+            FeatureSet fs = m_tracker->process(&in, RealTime::fromSeconds(t));
+            send(fs);
+            return true;
+        }
+
+        if (tag == End) {
+            if (m_kind == PcmInput) processPcm(true);
+            FeatureSet fs = m_tracker->getRemainingFeatures();
+            send(fs);
+            endStream();
+            queue(Done, 0, 0);
+            return flush(true);
+        }
+
+        return fail("Unexpected message");
+    }
+
+    void processPcm(bool ending) {
+
+        // Analyse every frame whose block is complete, or at the end
+        // of the stream, every frame that starts within it
+        int block = m_format.block;
+        int step = m_format.step;
+        long available = m_bufferStart + m_buffer.size();
+        const float *in = &m_spectrum[0];
+
+        vector<float> padded;
+
+        while (true) {
+            long start = m_frame * step;
+            if (ending ? start >= available : start + block > available) {
+                break;
+            }
+            const float *p = &m_buffer[0] + (start - m_bufferStart);
+            if (start + block > available) {
+                padded.assign(block, 0.f);
+                std::copy(m_buffer.begin() + (start - m_bufferStart),
+                          m_buffer.end(), padded.begin());
+                p = &padded[0];
+            }
+            m_stft->process(p, &m_spectrum[0]);
+            RealTime t = RealTime::frame2RealTime
+                (start + block/2, (unsigned int)m_format.rate);
+            FeatureSet fs = m_tracker->process(&in, t);
+            send(fs);
+            ++m_frame;
+        }
+
+        // Drop the samples that no later frame needs
+        long keep = m_frame * step;
+        if (keep > m_bufferStart) {
+            long drop = std::min(keep - m_bufferStart, long(m_buffer.size()));
+            m_buffer.erase(m_buffer.begin(), m_buffer.begin() + drop);
+            m_bufferStart += drop;
+        }
+    }
+
+    void send(FeatureSet &fs) {
+        for (int i = 0; i < (int)fs[0].size(); ++i) {
+            double v[2] = { toSeconds(fs[0][i].timestamp), fs[0][i].values[0] };
+            queue(F0, v, sizeof(v));
+        }
+        for (int i = 0; i < (int)fs[1].size(); ++i) {
+            double v[3] = { toSeconds(fs[1][i].timestamp),
+                            toSeconds(fs[1][i].duration),
+                            fs[1][i].values[0] };
+            queue(Note, v, sizeof(v));
+        }
+    }
+};
+
+PitchServer::PitchServer(string socketPath, int concurrency) :
+    m_path(socketPath),
+    m_concurrency(std::max(1, concurrency)),
+    m_listenFd(-1),
+    m_stopping(false),
+    m_active(0)
+{
+    m_pooledFormat.rate = 44100;
+    m_pooledFormat.block = 1024;
+    m_pooledFormat.step = 256;
+}
+
+PitchServer::~PitchServer()
+{
+    stop();
+    for (std::multimap<Format, CepstralPitchTracker *>::iterator i =
+             m_pool.begin(); i != m_pool.end(); ++i) {
+        delete i->second;
+    }
+}
+
+void
+PitchServer::setParameter(string identifier, float value)
+{
+    m_params[identifier] = value;
+}
+
+void
+PitchServer::setPooledFormat(float sampleRate, int blockSize, int stepSize)
+{
+    m_pooledFormat.rate = sampleRate;
+    m_pooledFormat.block = blockSize;
+    m_pooledFormat.step = stepSize;
+}
+
+bool
+PitchServer::isSupported(const Format &format)
+{
+    return format.rate > 0 && format.rate <= MaxSampleRate &&
+        format.block >= 2 && format.block <= MaxBlockSize &&
+        (format.block & (format.block - 1)) == 0 &&
+        format.step >= 1;
+}
+
+CepstralPitchTracker *
+PitchServer::makeTracker(const Format &format) const
+{
+    if (!isSupported(format)) {
+        return 0;
+    }
+    CepstralPitchTracker *tracker = new CepstralPitchTracker(format.rate);
+    for (std::map<string, float>::const_iterator i = m_params.begin();
+         i != m_params.end(); ++i) {
+        tracker->setParameter(i->first, i->second);
+    }
+    tracker->setNoteRules(m_rules);
+    if (!tracker->initialise(1, format.step, format.block)) {
+        delete tracker;
+        return 0;
+    }
+    return tracker;
+}
+
+CepstralPitchTracker *
+PitchServer::acquire(const Format &format)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::multimap<Format, CepstralPitchTracker *>::iterator i =
+            m_pool.find(format);
+        if (i != m_pool.end()) {
+            CepstralPitchTracker *tracker = i->second;
+            m_pool.erase(i);
+            return tracker;
+        }
+    }
+    return makeTracker(format);
+}
+
+void
+PitchServer::release(const Format &format, CepstralPitchTracker *tracker)
+{
+    // Reset on the way back, so that a stream never waits for it
+    tracker->reset();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if ((int)m_pool.size() < m_concurrency * 2) {
+        m_pool.insert(std::make_pair(format, tracker));
+    } else {
+        delete tracker;
+    }
+}
+
+bool
+PitchServer::start()
+{
+    if (m_listenFd >= 0) {
+        m_error = "Server already started";
+        return false;
+    }
+
+    for (int i = (int)m_pool.size(); i < m_concurrency; ++i) {
+        CepstralPitchTracker *tracker = makeTracker(m_pooledFormat);
+        if (!tracker) {
+            m_error = "Failed to initialise tracker for pooled format";
+            return false;
+        }
+        m_pool.insert(std::make_pair(m_pooledFormat, tracker));
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (m_path.size() >= sizeof(addr.sun_path)) {
+        m_error = "Socket path too long: " + m_path;
+        return false;
+    }
+    strcpy(addr.sun_path, m_path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        m_error = string("Failed to create socket: ") + strerror(errno);
+        return false;
+    }
+
+    unlink(m_path.c_str());
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 64) < 0) {
+        m_error = "Failed to listen on " + m_path + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    m_listenFd = fd;
+    m_stopping = false;
+    m_acceptThread = std::thread(&PitchServer::acceptLoop, this);
+    return true;
+}
+
+void
+PitchServer::stop()
+{
+    if (m_listenFd < 0) return;
+
+    m_stopping = true;
+    m_acceptThread.join();
+
+    {
+        // Wake any connection waiting for its client
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (std::set<int>::iterator i = m_connections.begin();
+             i != m_connections.end(); ++i) {
+            shutdown(*i, SHUT_RDWR);
+        }
+        while (m_active > 0) {
+            m_condition.wait(lock);
+        }
+    }
+
+    close(m_listenFd);
+    m_listenFd = -1;
+    unlink(m_path.c_str());
+}
+
+void
+PitchServer::acceptLoop()
+{
+    while (!m_stopping) {
+
+        // Hold off accepting while at the connection limit; clients
+        // wait in the listen backlog meanwhile
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_active >= m_concurrency && !m_stopping) {
+                m_condition.wait_for(lock, std::chrono::milliseconds(100));
+            }
+        }
+
+        // Poll with a timeout, so as to notice when we are stopped
+        struct pollfd p;
+        p.fd = m_listenFd;
+        p.events = POLLIN;
+        if (poll(&p, 1, 100) <= 0) continue;
+
+        int fd = accept(m_listenFd, 0, 0);
+        if (fd < 0) continue;
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            close(fd);
+            break;
+        }
+        m_connections.insert(fd);
+        ++m_active;
+        std::thread(&PitchServer::serve, this, fd).detach();
+    }
+}
+
+void
+PitchServer::serve(int fd)
+{
+    {
+        Connection connection(this, fd);
+        connection.run();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_connections.erase(fd);
+    close(fd);
+    --m_active;
+    m_condition.notify_all();
+}
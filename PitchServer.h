@@ -0,0 +1,213 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _PITCH_SERVER_H_
+#define _PITCH_SERVER_H_
+
+#include "NoteHypothesis.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class CepstralPitchTracker;
+
+/**
+ * A server that tracks the pitch of audio streams sent to it over a
+ * Unix domain socket, returning f0 and note events as they are found.
+ *
+ * Each connection carries one stream at a time, and is handled on a
+ * thread of its own, so the events for a stream come back in order.
+ * Up to a given number of connections are handled at once; further
+ * ones wait to be accepted. Streams are analysed by trackers taken
+ * from a pool, initialised in advance for the expected format, and
+ * reset and returned to the pool when the stream ends.
+ *
+ * Every message in either direction is a 4-byte tag, a 32-bit
+ * payload length, and the payload. Numbers are in the machine's byte
+ * order, as both ends are on the same machine. A client sends:
+ *
+ *   STRT  float32 sample rate, uint32 block size, uint32 step size,
+ *         uint32 input kind (0 for PCM, 1 for spectra): begin a stream
+ *         (the block size must be a power of two, at most
+ *         MaxBlockSize, and the rate at most MaxSampleRate)
+ *   PCM   any number of float32 mono samples
+ *   SPEC  float64 timestamp in seconds, then block size + 2 float32
+ *         values: one spectrum, in the plugin's input format
+ *   END   end the stream
+ *
+ * and the server replies with:
+ *
+ *   F0    float64 time, float64 Hz
+ *   NOTE  float64 time, float64 duration, float64 Hz
+ *   DONE  the stream has ended and all its events have been sent
+ *   ERR   text: the stream could not be started or a message was
+ *         invalid; any stream in progress is abandoned
+ *
+ * Events are sent as soon as they are found, but a client need not
+ * read them while still sending: the server holds back what the
+ * socket will not take, rather than blocking. Once a megabyte of
+ * replies is held back, though, the server reads nothing more from
+ * the client until they have been taken.
+ *
+ * PCM input is cut into frames starting every step from the first
+ * sample, with zeros after the last, and timestamped at the centre
+ * of each block, as by OfflineAnalyser. After DONE, or ERR, the
+ * client may start another stream on the same connection.
+ */
+class PitchServer
+{
+public:
+    enum Tag {
+        Start = 0x54525453,     // "STRT"
+        Pcm = 0x204d4350,       // "PCM "
+        Spectrum = 0x43455053,  // "SPEC"
+        End = 0x20444e45,       // "END "
+        F0 = 0x20203046,        // "F0  "
+        Note = 0x45544f4e,      // "NOTE"
+        Done = 0x454e4f44,      // "DONE"
+        Error = 0x20525245      // "ERR "
+    };
+
+    enum InputKind {
+        PcmInput = 0,
+        SpectrumInput = 1
+    };
+
+    /**
+     * The largest block size a stream may start with. Larger ones are
+     * refused before anything is allocated for them.
+     */
+    static const int MaxBlockSize = 65536;
+
+    /**
+     * The highest sample rate a stream may start with, in Hz.
+     */
+    static const int MaxSampleRate = 768000;
+
+    /**
+     * Construct a server that will listen on the given socket path,
+     * handling up to the given number of connections at once.
+     */
+    PitchServer(std::string socketPath, int concurrency = 4);
+    ~PitchServer();
+
+    /**
+     * Set a plugin parameter, applied to every stream. Call before
+     * start().
+     */
+    void setParameter(std::string identifier, float value);
+
+    /**
+     * Set the rules of the note tracking, in place of the defaults,
+     * for every stream. Call before start().
+     */
+    void setNoteRules(const NoteHypothesis::Rules &rules) { m_rules = rules; }
+
+    /**
+     * Set the stream format that the pooled trackers are initialised
+     * for in advance. Streams of other formats are served too, but
+     * start more slowly. Call before start().
+     */
+    void setPooledFormat(float sampleRate, int blockSize, int stepSize);
+
+    /**
+     * Create the socket and start accepting connections. Return
+     * false, with a message available from getError(), on failure.
+     */
+    bool start();
+
+    /**
+     * Stop accepting connections, close those open, and wait for
+     * their threads to finish. The socket file is removed.
+     */
+    void stop();
+
+    std::string getError() const { return m_error; }
+
+    /**
+     * Write a message to the given socket, returning false on error.
+     */
+    static bool writeMessage(int fd, uint32_t tag, const void *payload,
+                             uint32_t length);
+
+    /**
+     * Read a message from the given socket, returning false at end
+     * of file or on error.
+     */
+    static bool readMessage(int fd, uint32_t &tag,
+                            std::vector<char> &payload);
+
+private:
+    PitchServer(const PitchServer &); // not provided
+    PitchServer &operator=(const PitchServer &); // not provided
+
+    struct Format {
+        float rate;
+        int block;
+        int step;
+        bool operator<(const Format &f) const {
+            if (rate != f.rate) return rate < f.rate;
+            if (block != f.block) return block < f.block;
+            return step < f.step;
+        }
+    };
+
+    class Connection;
+
+    std::string m_path;
+    int m_concurrency;
+    std::map<std::string, float> m_params;
+    NoteHypothesis::Rules m_rules;
+    Format m_pooledFormat;
+    std::string m_error;
+
+    int m_listenFd;
+    std::thread m_acceptThread;
+    std::atomic<bool> m_stopping;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::set<int> m_connections;
+    int m_active;
+
+    std::multimap<Format, CepstralPitchTracker *> m_pool;
+
+    void acceptLoop();
+    void serve(int fd);
+
+    CepstralPitchTracker *acquire(const Format &format);
+    void release(const Format &format, CepstralPitchTracker *tracker);
+    static bool isSupported(const Format &format);
+    CepstralPitchTracker *makeTracker(const Format &format) const;
+};
+
+#endif
@@ -0,0 +1,745 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PitchTrackerEngine.h"
+#include "Cepstrum.h"
+#include "MeanFilter.h"
+#include "PeakInterpolator.h"
+#include "AgentFeeder.h"
+#include "Stft.h"
+
+#include "vamp-sdk/FFT.h"
+
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+
+using std::vector;
+using Vamp::RealTime;
+
+constexpr double PitchTrackerEngine::MagnitudeGate;
+constexpr int PitchTrackerEngine::Revision;
+
+PitchTrackerEngine::PitchTrackerEngine(float sampleRate) :
+    m_sampleRate(sampleRate),
+    m_stepSize(256),
+    m_blockSize(1024),
+    m_fmin(50),
+    m_fmax(900),
+    m_vflen(1),
+    m_bandLimit(0),
+    m_cepSize(0),
+    m_cepRate(sampleRate),
+    m_skip(1),
+    m_narrow(false),
+    m_refine(1),
+    m_dual(false),
+    m_binFrom(0),
+    m_binTo(0),
+    m_bins(0),
+    m_nAccepted(0),
+    m_feeder(0),
+    m_sink(0),
+    m_pitchRead(0),
+    m_noteRead(0),
+    m_shortStft(0),
+    m_shortCepSize(0),
+    m_shortCepRate(sampleRate),
+    m_shortBinFrom(0),
+    m_shortBins(0),
+    m_split(0.0),
+    m_lastMagmean(0.0),
+    m_fullNextPeakVal(0.0),
+    m_fullConfidence(0.0),
+    m_sinceFullSearch(0)
+{
+}
+
+PitchTrackerEngine::~PitchTrackerEngine()
+{
+    delete m_feeder;
+    delete m_shortStft;
+}
+
+bool
+PitchTrackerEngine::initialise(int stepSize, int blockSize)
+{
+    // The transforms work only on powers of two
+    if (stepSize < 1 || blockSize < 2 || (blockSize & (blockSize - 1))) {
+        return false;
+    }
+
+    m_stepSize = stepSize;
+    m_blockSize = blockSize;
+
+    // With a bandwidth limit, the cepstrum is the inverse transform
+    // of only the first m_cepSize/2+1 bins of the spectrum, where
+    // m_cepSize is the smallest power of two for which those bins
+    // reach the limit. Its quefrency bins then correspond to a
+    // sample rate scaled down by m_cepSize / m_blockSize.
+
+    m_cepSize = m_blockSize;
+
+    if (m_bandLimit > 0.f) {
+        double limitBin = (m_bandLimit * m_blockSize) / m_sampleRate;
+        while (m_cepSize > 4 && m_cepSize / 4 >= limitBin) {
+            m_cepSize /= 2;
+        }
+    }
+
+    m_cepRate = (m_sampleRate * m_cepSize) / m_blockSize;
+
+    m_binFrom = int(m_cepRate / m_fmax);
+    m_binTo = int(m_cepRate / m_fmin); 
+
+    if (m_binTo >= (int)m_cepSize / 2) {
+        m_binTo = m_cepSize / 2 - 1;
+    }
+    if (m_binFrom >= m_binTo) {
+        // shouldn't happen except for degenerate samplerate / blocksize combos
+        m_binFrom = m_binTo - 1;
+    }
+
+    m_bins = (m_binTo - m_binFrom) + 1;
+
+    // In dual-resolution mode, pitches from m_split upwards may be
+    // estimated from a block of half the size. m_split is the lowest
+    // pitch with four periods in that block; with fewer, the shorter
+    // block gives too many octave and fifth errors.
+
+    delete m_shortStft;
+    m_shortStft = 0;
+
+    int shortSize = m_blockSize / 2;
+    m_split = (4.0 * m_sampleRate) / shortSize;
+
+    if (m_dual && shortSize >= 16 && m_split < m_fmax) {
+
+        m_shortStft = new Stft(shortSize);
+
+        m_shortCepSize = shortSize;
+        if (m_bandLimit > 0.f) {
+            double limitBin = (m_bandLimit * shortSize) / m_sampleRate;
+            while (m_shortCepSize > 4 && m_shortCepSize / 4 >= limitBin) {
+                m_shortCepSize /= 2;
+            }
+        }
+
+        m_shortCepRate = (m_sampleRate * m_shortCepSize) / shortSize;
+
+        m_shortBinFrom = int(m_shortCepRate / m_fmax);
+        int shortBinTo = int(m_shortCepRate / m_split);
+        if (shortBinTo >= m_shortCepSize / 2) {
+            shortBinTo = m_shortCepSize / 2 - 1;
+        }
+        if (m_shortBinFrom >= shortBinTo) {
+            m_shortBinFrom = shortBinTo - 1;
+        }
+        m_shortBins = (shortBinTo - m_shortBinFrom) + 1;
+    }
+
+    reset();
+
+    return true;
+}
+
+void
+PitchTrackerEngine::reset()
+{
+    delete m_feeder;
+    m_feeder = new AgentFeeder(m_rules);
+    m_feeder->setStats(&m_stats);
+    m_feeder->setSink(m_sink);
+    m_nAccepted = 0;
+    m_stats.reset();
+    m_pitches.clear();
+    m_notes.clear();
+    m_pitchRead = 0;
+    m_noteRead = 0;
+    m_pendingSpectra.clear();
+    m_pendingTimes.clear();
+    m_pendingMagmeans.clear();
+    m_lastMagmean = 0.0;
+    m_fullNextPeakVal = 0.0;
+    m_fullConfidence = 0.0;
+    m_sinceFullSearch = 0;
+}
+
+bool
+PitchTrackerEngine::process(const float *in, int length, RealTime timestamp)
+{
+    if (!m_feeder || length != m_blockSize + 2) return false;
+
+    TRACKER_STATS_ADD(&m_stats, frames, 1);
+
+    if (m_skip > 1) {
+        processSkipping(in, timestamp);
+    } else {
+        NoteHypothesis::Estimate e;
+        if (estimate(in, timestamp, e)) {
+            feed(e);
+        }
+    }
+
+    queueAccepted();
+    return true;
+}
+
+void
+PitchTrackerEngine::finish()
+{
+    if (!m_feeder) return;
+
+    flushPending();
+
+    m_feeder->finish();
+
+    queueAccepted();
+}
+
+void
+PitchTrackerEngine::queueAccepted()
+{
+    const AgentFeeder::Hypotheses &accepted = m_feeder->getAcceptedHypotheses();
+
+    int n = accepted.size();
+    if (n == m_nAccepted) return;
+
+    for (int i = m_nAccepted; i < n; ++i) {
+        NoteHypothesis::Estimates es = accepted[i].getAcceptedEstimates();
+        m_pitches.insert(m_pitches.end(), es.begin(), es.end());
+        m_notes.push_back(accepted[i].getAveragedNote());
+    }
+
+    m_nAccepted = n;
+}
+
+void
+PitchTrackerEngine::setResultSink(ResultSink *sink)
+{
+    m_sink = sink;
+    if (m_feeder) m_feeder->setSink(sink);
+}
+
+int
+PitchTrackerEngine::readPitches(Pitch *buffer, int capacity)
+{
+    int n = std::min(capacity, getPitchCount());
+    if (n <= 0) return 0;
+    std::copy(m_pitches.begin() + m_pitchRead,
+              m_pitches.begin() + m_pitchRead + n, buffer);
+    m_pitchRead += n;
+    if (m_pitchRead == (int)m_pitches.size()) {
+        m_pitches.clear();
+        m_pitchRead = 0;
+    }
+    return n;
+}
+
+int
+PitchTrackerEngine::readNotes(Note *buffer, int capacity)
+{
+    int n = std::min(capacity, getNoteCount());
+    if (n <= 0) return 0;
+    std::copy(m_notes.begin() + m_noteRead,
+              m_notes.begin() + m_noteRead + n, buffer);
+    m_noteRead += n;
+    if (m_noteRead == (int)m_notes.size()) {
+        m_notes.clear();
+        m_noteRead = 0;
+    }
+    return n;
+}
+
+int
+PitchTrackerEngine::getCandidateCount() const
+{
+    return m_feeder ? m_feeder->getCandidateCount() : 0;
+}
+
+double
+PitchTrackerEngine::magnitudeMean(const float *in)
+{
+    TRACKER_STATS_TIME(&m_stats, LogMagnitude);
+    return Cepstrum(m_blockSize).magnitudeMean(in);
+}
+
+bool
+PitchTrackerEngine::estimate(const float *in, RealTime timestamp,
+                             NoteHypothesis::Estimate &e)
+{
+    return estimate(in, timestamp, magnitudeMean(in), e);
+}
+
+bool
+PitchTrackerEngine::estimate(const float *in, RealTime timestamp,
+                             double magmean, NoteHypothesis::Estimate &e)
+{
+    e.freq = 0.0;
+    e.time = timestamp;
+    e.confidence = 0.0;
+
+    // Any estimate whose spectrum has a mean magnitude below the gate
+    // gets zero confidence, which means the hypotheses will ignore
+    // its frequency. So we check it first using a cheap pass over
+    // the magnitudes, and skip the transform and peak search for
+    // quiet frames.
+    if (magmean < MagnitudeGate) {
+        TRACKER_STATS_ADD(&m_stats, gatedFrames, 1);
+        // A spectrum that is entirely zero has a flat cepstrum, with
+        // no peak to report. Without the gate we would return no
+        // estimate at all for it, rather than a zero-confidence one,
+        // and that distinction affects the candidate hypotheses
+        return (magmean > 0.0);
+    }
+
+    double *logmag = new double[m_cepSize];
+    {
+        TRACKER_STATS_TIME(&m_stats, LogMagnitude);
+        Cepstrum(m_cepSize).logMagnitude(in, logmag);
+    }
+
+    // Within a note, try a narrow search first, but carry out a full
+    // one at least every fullSearchInterval frames
+    int fullSearchInterval = 8;
+    double noteFreq = m_narrow ? m_feeder->getNoteFrequency() : 0.0;
+
+    if (noteFreq > 0.0 && m_sinceFullSearch < fullSearchInterval &&
+        estimateNear(noteFreq, logmag, e)) {
+        ++m_sinceFullSearch;
+    } else if (!estimateFull(logmag, e)) {
+        delete[] logmag;
+        return false;
+    }
+
+    delete[] logmag;
+
+    // In the upper part of the range, prefer the estimate from the
+    // shorter block, unless it is less confident. (Its confidence is
+    // usually lower where it is less reliable, as its harmonics are
+    // less well resolved.)
+    if (m_shortStft && e.freq >= m_split) {
+        NoteHypothesis::Estimate se;
+        if (estimateShort(in, se) && se.confidence >= e.confidence) {
+            e.freq = se.freq;
+            e.confidence = se.confidence;
+        }
+    }
+
+    return true;
+}
+
+bool
+PitchTrackerEngine::estimateFull(const double *logmag,
+                                 NoteHypothesis::Estimate &e)
+{
+    double q = 0.0, maxval = 0.0, nextPeakVal = 0.0;
+
+    if (!searchCepstrum(logmag, m_cepSize, m_binFrom, m_bins,
+                        q, maxval, nextPeakVal)) {
+        return false;
+    }
+
+    double confidence = 0.0;
+
+    if (nextPeakVal != 0.0) {
+        confidence = (maxval - nextPeakVal) * 10.0;
+    }
+
+    m_fullNextPeakVal = nextPeakVal;
+    m_fullConfidence = confidence;
+    m_sinceFullSearch = 0;
+
+    e.freq = m_cepRate / q;
+    e.confidence = confidence;
+    return true;
+}
+
+bool
+PitchTrackerEngine::estimateShort(const float *in,
+                                  NoteHypothesis::Estimate &e)
+{
+    // Recover the central half of the frame from the host's spectrum,
+    // by inverse transform and division by the host's Hann window
+    // (which is at least 0.5 there, so this is well-conditioned).
+    // Then window and transform it again at half the size.
+
+    int n = m_blockSize;
+    int hn = n / 2;
+    int qn = n / 4;
+
+    double *logmag = new double[m_shortCepSize];
+    {
+        TRACKER_STATS_TIME(&m_stats, LogMagnitude);
+
+        double *ri = new double[n];
+        double *ii = new double[n];
+        double *ro = new double[n];
+        double *io = new double[n];
+
+        for (int i = 0; i <= hn; ++i) {
+            ri[i] = in[i*2];
+            ii[i] = in[i*2+1];
+        }
+        for (int i = hn + 1; i < n; ++i) {
+            ri[i] = ri[n-i];
+            ii[i] = -ii[n-i];
+        }
+
+        Vamp::FFT::inverse(n, ri, ii, ro, io);
+
+        // The host rotated the windowed block by n/2 before its
+        // transform, so block sample j is now at index (j + n/2) % n
+        float *frame = new float[hn];
+        for (int i = 0; i < hn; ++i) {
+            int j = i + qn;
+            double w = 0.5 - 0.5 * cos((2.0 * M_PI * j) / n);
+            frame[i] = float(ro[(j + hn) % n] / w);
+        }
+
+        float *spectrum = new float[hn + 2];
+        m_shortStft->process(frame, spectrum);
+        Cepstrum(m_shortCepSize).logMagnitude(spectrum, logmag);
+
+        delete[] spectrum;
+        delete[] frame;
+        delete[] io;
+        delete[] ro;
+        delete[] ii;
+        delete[] ri;
+    }
+
+    double q = 0.0, maxval = 0.0, nextPeakVal = 0.0;
+    bool found = searchCepstrum(logmag, m_shortCepSize, m_shortBinFrom,
+                                m_shortBins, q, maxval, nextPeakVal);
+
+    delete[] logmag;
+
+    if (!found || nextPeakVal == 0.0 || maxval <= nextPeakVal) {
+        return false;
+    }
+
+    e.freq = m_shortCepRate / q;
+    e.confidence = (maxval - nextPeakVal) * 10.0;
+    return true;
+}
+
+bool
+PitchTrackerEngine::searchCepstrum(const double *logmag, int cepSize,
+                                   int binFrom, int bins, double &q,
+                                   double &maxval, double &nextPeakVal)
+{
+    // Calculate the cepstrum of the given log magnitude, and find its
+    // highest peak, and the next highest, between binFrom and
+    // binFrom + bins - 1. The quefrency of the highest is returned in
+    // q, in bins, interpolated or refined.
+
+    double *rawcep = new double[cepSize];
+    {
+        TRACKER_STATS_TIME(&m_stats, Transform);
+        Cepstrum(cepSize).transform(logmag, rawcep);
+    }
+
+    int n = bins;
+    double *data = new double[n];
+    {
+        TRACKER_STATS_TIME(&m_stats, Filter);
+        MeanFilter(m_vflen).filterSubsequence
+            (rawcep, data, cepSize, n, binFrom);
+    }
+
+    delete[] rawcep;
+
+    TRACKER_STATS_TIME(&m_stats, PeakSearch);
+
+    maxval = 0.0;
+    int maxbin = -1;
+
+    for (int i = 0; i < n; ++i) {
+        if (data[i] > maxval) {
+            maxval = data[i];
+            maxbin = i;
+        }
+    }
+
+    if (maxbin < 0) {
+        delete[] data;
+        return false;
+    }
+
+    nextPeakVal = 0.0;
+    for (int i = 1; i+1 < n; ++i) {
+        if (data[i] > data[i-1] &&
+            data[i] > data[i+1] &&
+            i != maxbin &&
+            data[i] > nextPeakVal) {
+            nextPeakVal = data[i];
+        }
+    }
+
+    if (m_refine > 1) {
+        q = refinePeak(logmag, cepSize, maxbin + binFrom);
+    } else {
+        PeakInterpolator pi;
+        double cimax = pi.findPeakLocation(data, n, maxbin);
+        q = cimax + binFrom;
+    }
+
+    delete[] data;
+    return true;
+}
+
+void
+PitchTrackerEngine::feed(const NoteHypothesis::Estimate &e)
+{
+    {
+        TRACKER_STATS_TIME(&m_stats, Tracking);
+        m_feeder->feed(e);
+    }
+    TRACKER_STATS_ADD(&m_stats, candidates, m_feeder->getCandidateCount());
+}
+
+void
+PitchTrackerEngine::flushPending()
+{
+    // Analyse all held-back frames in full, after all
+    int sz = m_blockSize + 2;
+    for (int i = 0; i < (int)m_pendingTimes.size(); ++i) {
+        NoteHypothesis::Estimate e;
+        if (estimate(&m_pendingSpectra[i * sz], m_pendingTimes[i],
+                     m_pendingMagmeans[i], e)) {
+            feed(e);
+        }
+    }
+    m_pendingSpectra.clear();
+    m_pendingTimes.clear();
+    m_pendingMagmeans.clear();
+}
+
+void
+PitchTrackerEngine::processSkipping(const float *in, RealTime timestamp)
+{
+    // Within a stable note, hold back frames until we have m_skip of
+    // them, then analyse only the last. If its estimate is close to
+    // the one before the held frames, feed the held frames estimates
+    // interpolated between the two; otherwise analyse them all. A
+    // change in level also causes all held frames to be analysed,
+    // as does anything that takes us out of the note.
+
+    // The mean magnitude found here is passed on to estimate(),
+    // rather than found again there
+    double magmean = magnitudeMean(in);
+
+    bool stable =
+        m_feeder->isInNote() &&
+        magmean >= MagnitudeGate &&
+        m_lastMagmean > 0.0 &&
+        magmean < m_lastMagmean * 2.0 &&
+        magmean > m_lastMagmean * 0.5;
+
+    if (!stable) {
+        flushPending();
+    } else if ((int)m_pendingTimes.size() < m_skip - 1) {
+        m_pendingSpectra.insert(m_pendingSpectra.end(), in, in + m_blockSize + 2);
+        m_pendingTimes.push_back(timestamp);
+        m_pendingMagmeans.push_back(magmean);
+        return;
+    }
+
+    NoteHypothesis::Estimate e;
+    bool have = estimate(in, timestamp, magmean, e);
+
+    if (!m_pendingTimes.empty()) {
+
+        double maxCents = 30.0;
+        bool close = false;
+
+        if (have && e.confidence > 0.0 && m_lastEstimate.confidence > 0.0) {
+            double cents = 1200.0 * log(e.freq / m_lastEstimate.freq) / log(2.0);
+            close = (fabs(cents) <= maxCents);
+        }
+
+        if (close) {
+            int n = m_pendingTimes.size();
+            for (int i = 0; i < n; ++i) {
+                double prop = double(i + 1) / double(n + 1);
+                NoteHypothesis::Estimate ie
+                    (m_lastEstimate.freq + prop * (e.freq - m_lastEstimate.freq),
+                     m_pendingTimes[i],
+                     m_lastEstimate.confidence +
+                     prop * (e.confidence - m_lastEstimate.confidence));
+                feed(ie);
+            }
+            TRACKER_STATS_ADD(&m_stats, interpolatedFrames, n);
+            m_pendingSpectra.clear();
+            m_pendingTimes.clear();
+            m_pendingMagmeans.clear();
+        } else {
+            flushPending();
+        }
+    }
+
+    if (have) {
+        feed(e);
+        m_lastEstimate = e;
+        m_lastMagmean = magmean;
+    } else {
+        m_lastMagmean = 0.0;
+    }
+}
+
+bool
+PitchTrackerEngine::estimateNear(double freq, const double *logmag,
+                                 NoteHypothesis::Estimate &e)
+{
+    // Calculate and search only the cepstral bins within 100 cents
+    // of the given frequency (the hypotheses accept 80), plus enough
+    // either side for the mean filter. Fail if the peak is at the
+    // edge of the range, because it may really lie outside it, or if
+    // its confidence is much lower than in the last full search.
+    //
+    // The confidence is usually based on the height of the second
+    // peak across the whole range, which we can't see here, so we
+    // reuse the one found in the last full search.
+
+    if (m_fullNextPeakVal == 0.0) return false;
+
+    double ratio = pow(2.0, 100.0 / 1200.0);
+    int lo = int(floor(m_cepRate / (freq * ratio))) - m_binFrom;
+    int hi = int(ceil((m_cepRate * ratio) / freq)) - m_binFrom;
+    if (lo < 0) lo = 0;
+    if (hi > m_bins - 1) hi = m_bins - 1;
+    if (hi - lo < 2) return false;
+
+    int half = m_vflen / 2;
+    int from = std::max(0, m_binFrom + lo - half);
+    int to = std::min(m_cepSize - 1, m_binFrom + hi + half);
+
+    double *rawcep = new double[to - from + 1];
+    {
+        TRACKER_STATS_TIME(&m_stats, Transform);
+        Cepstrum(m_cepSize).transformRange(logmag, from, to, rawcep);
+    }
+
+    int n = hi - lo + 1;
+    double *data = new double[n];
+    {
+        TRACKER_STATS_TIME(&m_stats, Filter);
+        MeanFilter(m_vflen).filterSubsequence
+            (rawcep, data, to - from + 1, n, m_binFrom + lo - from);
+    }
+
+    delete[] rawcep;
+
+    TRACKER_STATS_TIME(&m_stats, PeakSearch);
+
+    double maxval = 0.0;
+    int maxbin = -1;
+
+    for (int i = 0; i < n; ++i) {
+        if (data[i] > maxval) {
+            maxval = data[i];
+            maxbin = i;
+        }
+    }
+
+    if (maxbin < 1 || maxbin > n - 2) {
+        delete[] data;
+        return false;
+    }
+
+    double confidence = (maxval - m_fullNextPeakVal) * 10.0;
+    if (confidence <= 0.0 || confidence < m_fullConfidence * 0.5) {
+        delete[] data;
+        return false;
+    }
+
+    if (m_refine > 1) {
+        e.freq = m_cepRate /
+            refinePeak(logmag, m_cepSize, lo + maxbin + m_binFrom);
+    } else {
+        PeakInterpolator pi;
+        double cimax = lo + pi.findPeakLocation(data, n, maxbin);
+        e.freq = m_cepRate / (cimax + m_binFrom);
+    }
+
+    delete[] data;
+
+    e.confidence = confidence;
+    return true;
+}
+
+double
+PitchTrackerEngine::refinePeak(const double *logmag, int cepSize, int bin)
+{
+    // Evaluate the mean-filtered cepstrum at m_refine points per bin
+    // between the bins either side of the peak found at the given
+    // bin, and interpolate between the highest of those. This zooms
+    // in on the peak, finding its quefrency with roughly the
+    // precision of a transform m_refine times the size, without the
+    // latency of the larger block or the cost of a full transform.
+    //
+    // The log magnitude is tapered first. Between bins, the
+    // untapered cepstrum ripples with the noise in the low-level
+    // parts of the spectrum, which would pull the peak about; the
+    // taper smooths it without moving a symmetrical peak.
+
+    Cepstrum cepstrum(cepSize);
+
+    int hn = cepSize / 2;
+    double *tapered = new double[hn + 1];
+    for (int k = 0; k <= hn; ++k) {
+        tapered[k] = logmag[k] * 0.5 * (1.0 + cos((M_PI * k) / hn));
+    }
+
+    int half = m_vflen / 2;
+    int n = 2 * m_refine + 1;
+    double *data = new double[n];
+
+    double maxval = 0.0;
+    int maxidx = 0;
+
+    for (int i = 0; i < n; ++i) {
+        double q = (bin - 1) + double(i) / m_refine;
+        double v = 0.0;
+        for (int j = -half; j <= half; ++j) {
+            v += cepstrum.evaluate(tapered, q + j);
+        }
+        data[i] = v / m_vflen;
+        if (i == 0 || data[i] > maxval) {
+            maxval = data[i];
+            maxidx = i;
+        }
+    }
+
+    PeakInterpolator pi;
+    double loc = pi.findPeakLocation(data, n, maxidx);
+
+    delete[] tapered;
+    delete[] data;
+
+    return (bin - 1) + loc / m_refine;
+}
@@ -0,0 +1,311 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _PITCH_TRACKER_ENGINE_H_
+#define _PITCH_TRACKER_ENGINE_H_
+
+#include "NoteHypothesis.h"
+#include "ResultSink.h"
+#include "TrackerStats.h"
+
+#include <vector>
+
+class AgentFeeder;
+class Stft;
+
+/**
+ * The cepstral pitch estimation and note tracking of a single
+ * channel, without the Vamp plugin interface. CepstralPitchTracker
+ * is an adapter over one of these per channel.
+ *
+ * Frames go in through process() and the results come out as plain
+ * records, with no feature sets, strings or per-feature allocations:
+ * each f0 estimate belonging to an accepted note, and each note, is
+ * queued as it is found, and copied out into caller-provided
+ * buffers by readPitches() and readNotes(). Records that do not fit
+ * in the buffers stay queued for the next read.
+ *
+ * The records are in the plugin's output order: the pitches of each
+ * note, in time order, become available together with the note.
+ *
+ * Alternatively a ResultSink may be set, to be called with each note
+ * and estimate as they are found, in which case no records are
+ * queued at all.
+ */
+class PitchTrackerEngine
+{
+public:
+    /**
+     * An f0 estimate of an accepted note. The plugin's f0 output
+     * returns the time and frequency of each of these.
+     */
+    typedef NoteHypothesis::Estimate Pitch;
+
+    /**
+     * A note, as returned on the plugin's notes output.
+     */
+    typedef NoteHypothesis::Note Note;
+
+    PitchTrackerEngine(float sampleRate);
+    ~PitchTrackerEngine();
+
+    /**
+     * Parameters, as described for the plugin. Set these before
+     * calling initialise().
+     */
+    void setBandLimit(float hz) { m_bandLimit = hz; }
+    float getBandLimit() const { return m_bandLimit; }
+    void setSkip(int skip) { m_skip = (skip < 1 ? 1 : skip); }
+    int getSkip() const { return m_skip; }
+    void setRefine(int refine) { m_refine = (refine < 1 ? 1 : refine); }
+    int getRefine() const { return m_refine; }
+    void setDual(bool dual) { m_dual = dual; }
+    bool getDual() const { return m_dual; }
+    void setNarrow(bool narrow) { m_narrow = narrow; }
+    bool getNarrow() const { return m_narrow; }
+
+    /**
+     * The rules of the note tracking. These take effect on the next
+     * initialise() or reset().
+     */
+    void setNoteRules(const NoteHypothesis::Rules &rules) { m_rules = rules; }
+    const NoteHypothesis::Rules &getNoteRules() const { return m_rules; }
+
+    /**
+     * Return the range of pitches the engine looks for, in Hz.
+     */
+    float getMinFrequency() const { return m_fmin; }
+    float getMaxFrequency() const { return m_fmax; }
+
+    /**
+     * Return the layout of the cepstrum searched, as set up by
+     * initialise() for the parameters: its transform size, the
+     * sample rate its quefrency bins correspond to, the first bin
+     * searched and the number of bins, and the length of the mean
+     * filter applied to it.
+     */
+    int getCepstrumSize() const { return m_cepSize; }
+    float getCepstrumRate() const { return m_cepRate; }
+    int getFirstBin() const { return m_binFrom; }
+    int getBinCount() const { return m_bins; }
+    int getFilterLength() const { return m_vflen; }
+
+    /**
+     * Prepare for frames of the given block size, stepping by the
+     * given step size. Return false if they are unsupported: the
+     * block size must be a power of two of at least 2. This also
+     * resets the engine.
+     */
+    bool initialise(int stepSize, int blockSize);
+
+    /**
+     * Discard all state and queued records, ready for a new input.
+     */
+    void reset();
+
+    /**
+     * Process one frame, given as block size + 2 floats holding the
+     * real and imaginary parts of bins 0 to block size / 2 of its
+     * spectrum, as a Vamp host would provide it. Return false,
+     * without processing anything, if the length is not block size
+     * + 2.
+     */
+    bool process(const float *in, int length, Vamp::RealTime timestamp);
+
+    /**
+     * End the input, queueing the records for any note still in
+     * progress. Call reset() before processing any further input.
+     */
+    void finish();
+
+    /**
+     * Set a sink to receive the results as they are found, in place
+     * of queueing records, or 0 to go back to queueing. The sink is
+     * not owned by the engine, and must outlive it or be unset.
+     */
+    void setResultSink(ResultSink *sink);
+
+    /**
+     * Return the number of pitch or note records waiting to be read.
+     */
+    int getPitchCount() const { return int(m_pitches.size()) - m_pitchRead; }
+    int getNoteCount() const { return int(m_notes.size()) - m_noteRead; }
+
+    /**
+     * Copy up to the given number of waiting pitch records into the
+     * buffer, in order, and return how many were copied.
+     */
+    int readPitches(Pitch *buffer, int capacity);
+
+    /**
+     * Copy up to the given number of waiting note records into the
+     * buffer, in order, and return how many were copied.
+     */
+    int readNotes(Note *buffer, int capacity);
+
+    /**
+     * Calculate the pitch estimate for a single frame as process()
+     * would, but without passing it on to the note tracking. Return
+     * false if there is no estimate for the frame.
+     */
+    bool estimateFrame(const float *in, Vamp::RealTime timestamp, Pitch &e) {
+        return estimate(in, timestamp, e);
+    }
+
+    /**
+     * Any frame whose spectrum has a mean magnitude below this gets
+     * an estimate of zero confidence, which the note tracking
+     * ignores, and its cepstrum is never calculated.
+     */
+    static constexpr double MagnitudeGate = 0.1;
+
+    /**
+     * The revision of the estimator. Any change that alters the
+     * estimates for the same input and parameters must increment
+     * this, so that estimates cached by an older build are not used.
+     */
+    static constexpr int Revision = 1;
+
+    /**
+     * Return true if the estimate for each frame is independent of
+     * the note tracking, and so of the frames before it. This is the
+     * case unless the skip or narrow parameters are in use.
+     */
+    bool hasIndependentEstimates() const {
+        return m_skip == 1 && !m_narrow;
+    }
+
+    /**
+     * Return the number of candidate note hypotheses currently live.
+     */
+    int getCandidateCount() const;
+
+    /**
+     * Return the per-stage timings and event counters accumulated
+     * since the last reset. These are only gathered in builds with
+     * WITH_TRACKER_STATS defined, and are all zero otherwise.
+     */
+    const TrackerStats &getStats() const { return m_stats; }
+
+private:
+    PitchTrackerEngine(const PitchTrackerEngine &); // not provided
+    PitchTrackerEngine &operator=(const PitchTrackerEngine &); // not provided
+
+    float m_sampleRate;
+    int m_stepSize;
+    int m_blockSize;
+    float m_fmin;
+    float m_fmax;
+    int m_vflen;
+
+    float m_bandLimit; // Hz, or 0 to use the whole spectrum
+    int m_cepSize;     // transform size used for the cepstrum
+    float m_cepRate;   // sample rate corresponding to m_cepSize
+
+    int m_skip; // analyse every m_skip'th frame within stable notes
+    bool m_narrow; // search only around the current note's pitch
+    int m_refine; // evaluate m_refine points per bin around the peak
+    bool m_dual; // use a shorter block for the upper part of the range
+
+    int m_binFrom;
+    int m_binTo;
+    int m_bins; // count of "interesting" bins, those returned in m_cepOutput
+
+    int m_nAccepted;
+
+    NoteHypothesis::Rules m_rules;
+    AgentFeeder *m_feeder;
+    ResultSink *m_sink;
+
+    // Records queued for reading, from index m_pitchRead and
+    // m_noteRead onwards. The vectors are cleared, keeping their
+    // storage, once everything in them has been read
+    std::vector<Pitch> m_pitches;
+    std::vector<Note> m_notes;
+    int m_pitchRead;
+    int m_noteRead;
+
+    // Half-size block analysis for dual-resolution mode, with its
+    // own cepstrum size and bins, covering pitches from m_split up
+    Stft *m_shortStft;
+    int m_shortCepSize;
+    float m_shortCepRate;
+    int m_shortBinFrom;
+    int m_shortBins;
+    double m_split;
+
+    // Frames held back during stable notes, waiting to see whether
+    // they can be interpolated
+    std::vector<float> m_pendingSpectra;
+    std::vector<Vamp::RealTime> m_pendingTimes;
+    std::vector<double> m_pendingMagmeans;
+    NoteHypothesis::Estimate m_lastEstimate;
+    double m_lastMagmean;
+
+    // Results of the last search across the whole pitch range, used
+    // for the confidence of narrow searches
+    double m_fullNextPeakVal;
+    double m_fullConfidence;
+    int m_sinceFullSearch;
+
+    void feed(const NoteHypothesis::Estimate &e);
+    void processSkipping(const float *in, Vamp::RealTime timestamp);
+    void flushPending();
+    void queueAccepted();
+
+    /**
+     * Calculate the pitch estimate for a single frequency-domain
+     * frame. Return false if there is no estimate at all (as for a
+     * frame of digital silence), in which case nothing should be fed
+     * to the hypotheses.
+     */
+    bool estimate(const float *in, Vamp::RealTime timestamp,
+                  NoteHypothesis::Estimate &e);
+
+    /**
+     * Calculate the estimate as above, given the mean magnitude of
+     * the frame's spectrum already found by magnitudeMean().
+     */
+    bool estimate(const float *in, Vamp::RealTime timestamp, double magmean,
+                  NoteHypothesis::Estimate &e);
+
+    double magnitudeMean(const float *in);
+
+    bool estimateNear(double freq, const double *logmag,
+                      NoteHypothesis::Estimate &e);
+
+    bool estimateFull(const double *logmag, NoteHypothesis::Estimate &e);
+    bool estimateShort(const float *in, NoteHypothesis::Estimate &e);
+
+    bool searchCepstrum(const double *logmag, int cepSize,
+                        int binFrom, int bins, double &q,
+                        double &maxval, double &nextPeakVal);
+
+    double refinePeak(const double *logmag, int cepSize, int bin);
+
+    TrackerStats m_stats;
+};
+
+#endif
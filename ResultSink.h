@@ -0,0 +1,74 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _RESULT_SINK_H_
+#define _RESULT_SINK_H_
+
+#include "NoteHypothesis.h"
+
+/**
+ * Receiver for the results of note tracking as they are found, for
+ * consumers that would rather write them straight to their own
+ * buffers, sockets or files than collect them from the tracker.
+ *
+ * Register a sink with AgentFeeder::setSink(), or with the engine or
+ * plugin that owns the feeder. Its functions are called from within
+ * the feeder, on the thread feeding it, at the moment each note is
+ * accepted, extended and completed. Notes never overlap: each one
+ * runs from onNoteOn() to onNoteComplete(), with an onEstimate() in
+ * between for each of its f0 estimates, and the estimates and notes
+ * passed are exactly those the plugin returns on its f0 and notes
+ * outputs.
+ *
+ * The default implementations do nothing.
+ */
+class ResultSink
+{
+public:
+    virtual ~ResultSink() { }
+
+    /**
+     * A note has begun, having gathered enough consistent estimates
+     * to be accepted. Its time is that of its first estimate, and its
+     * frequency and duration are those of the estimates so far.
+     */
+    virtual void onNoteOn(const NoteHypothesis::Note &) { }
+
+    /**
+     * An estimate belonging to the current note. This is called for
+     * the estimates gathered before the note began straight after
+     * onNoteOn(), and for each later one as it arrives.
+     */
+    virtual void onEstimate(const NoteHypothesis::Estimate &) { }
+
+    /**
+     * The current note has ended. The note given is the one the
+     * plugin returns for it, with the mean frequency of all its
+     * estimates.
+     */
+    virtual void onNoteComplete(const NoteHypothesis::Note &) { }
+};
+
+#endif
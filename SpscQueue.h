@@ -0,0 +1,128 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+
+#include <vector>
+#include <atomic>
+
+/**
+ * A bounded single-producer, single-consumer queue, with no locking,
+ * for passing work between two threads.
+ *
+ * All the elements are constructed up front, and are written and
+ * read in place rather than copied in and out: the producer fills
+ * the slot returned by getWriteSlot() and then calls push(), and the
+ * consumer reads the slot returned by getReadSlot() and then calls
+ * pop(). A slot keeps whatever storage it had when it was last used,
+ * so elements that own buffers need not allocate once the queue has
+ * been round once.
+ *
+ * Only one thread may produce and one consume at a time. Neither
+ * side ever waits: a full or empty queue returns a null slot, and
+ * the caller decides whether to retry, give up or do something else.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    /**
+     * Construct a queue holding up to the given number of elements,
+     * each a copy of the given prototype.
+     */
+    SpscQueue(int capacity, const T &prototype = T()) :
+        m_slots(capacity + 1, prototype), m_read(0), m_write(0) { }
+
+    int getCapacity() const { return int(m_slots.size()) - 1; }
+
+    /**
+     * Return the slot to be filled by the next push(), or 0 if the
+     * queue is full. Producer only.
+     */
+    T *getWriteSlot() {
+        int w = m_write.load(std::memory_order_relaxed);
+        if (next(w) == m_read.load(std::memory_order_acquire)) return 0;
+        return &m_slots[w];
+    }
+
+    /**
+     * Make the slot last returned by getWriteSlot() available to the
+     * consumer. Producer only.
+     */
+    void push() {
+        int w = m_write.load(std::memory_order_relaxed);
+        m_write.store(next(w), std::memory_order_release);
+    }
+
+    /**
+     * Return the slot at the head of the queue, or 0 if the queue is
+     * empty. Consumer only.
+     */
+    T *getReadSlot() {
+        int r = m_read.load(std::memory_order_relaxed);
+        if (r == m_write.load(std::memory_order_acquire)) return 0;
+        return &m_slots[r];
+    }
+
+    /**
+     * Release the slot last returned by getReadSlot() back to the
+     * producer. Consumer only.
+     */
+    void pop() {
+        int r = m_read.load(std::memory_order_relaxed);
+        m_read.store(next(r), std::memory_order_release);
+    }
+
+    /**
+     * Return the number of elements in the queue. This is exact only
+     * when called from the producer or consumer with the other side
+     * idle; otherwise it is a snapshot.
+     */
+    int getSize() const {
+        int n = m_write.load(std::memory_order_acquire) -
+            m_read.load(std::memory_order_acquire);
+        return n < 0 ? n + int(m_slots.size()) : n;
+    }
+
+private:
+    SpscQueue(const SpscQueue &); // not provided
+    SpscQueue &operator=(const SpscQueue &); // not provided
+
+    int next(int i) const {
+        return (i + 1 == int(m_slots.size())) ? 0 : i + 1;
+    }
+
+    std::vector<T> m_slots;
+
+    // Each index is written by one side only. They are kept a cache
+    // line apart, so that the two threads do not contend for a line
+    // on every operation
+    std::atomic<int> m_read;
+    char m_padding[64];
+    std::atomic<int> m_write;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _STFT_H_
+#define _STFT_H_
+
+#include "vamp-sdk/FFT.h"
+
+#include <cmath>
+#include <vector>
+
+/**
+ * Convert blocks of time-domain audio to the frequency-domain format
+ * that Vamp hosts pass to FrequencyDomain plugins (and so that
+ * Cepstrum::process() expects): n/2+1 consecutive pairs of real and
+ * imaginary component floats, n+2 values in total.
+ *
+ * As in the Vamp SDK's PluginInputDomainAdapter, each block is
+ * multiplied by a periodic Hann window and then rotated by n/2 so
+ * that the window centre lies at time zero, before the forward FFT.
+ * The result therefore corresponds to the centre of the block, and
+ * a host would timestamp it at (block start + n/2) samples.
+ */
+class Stft
+{
+public:
+    /**
+     * Construct a converter for blocks of n samples, where n is a
+     * power of two.
+     */
+    Stft(int n) :
+        m_n(n), m_window(n), m_ri(n), m_ro(n), m_io(n) {
+	if (n & (n-1)) {
+	    throw "N must be a power of two";
+	}
+        for (int i = 0; i < n; ++i) {
+            m_window[i] = 0.5 - 0.5 * cos((2.0 * M_PI * i) / n);
+        }
+    }
+    ~Stft() { }
+
+    /**
+     * Window and transform the n samples in "in", writing n+2 values
+     * to "out".
+     */
+    void process(const float *in, float *out) {
+
+        int hn = m_n/2;
+
+        for (int i = 0; i < m_n; ++i) {
+            m_ri[(i + hn) % m_n] = in[i] * m_window[i];
+        }
+
+        Vamp::FFT::forward(m_n, &m_ri[0], 0, &m_ro[0], &m_io[0]);
+
+        for (int i = 0; i <= hn; ++i) {
+            out[i*2] = float(m_ro[i]);
+            out[i*2+1] = float(m_io[i]);
+        }
+    }
+
+private:
+    int m_n;
+    std::vector<double> m_window;
+    std::vector<double> m_ri;
+    std::vector<double> m_ro;
+    std::vector<double> m_io;
+};
+
+#endif
@@ -0,0 +1,308 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "StreamingPipeline.h"
+#include "AgentFeeder.h"
+
+#include <algorithm>
+
+using std::string;
+using Vamp::RealTime;
+
+StreamingPipeline::SpectrumSlot
+StreamingPipeline::makeSpectrumSlot(int blockSize)
+{
+    SpectrumSlot slot;
+    slot.spectrum.resize(blockSize + 2);
+    slot.end = false;
+    return slot;
+}
+
+StreamingPipeline::StreamingPipeline(float sampleRate, int stepSize,
+                                     int blockSize, int queueDepth) :
+    m_sampleRate(sampleRate),
+    m_stepSize(stepSize),
+    m_blockSize(blockSize),
+    m_spectra(queueDepth, makeSpectrumSlot(blockSize)),
+    m_estimates(queueDepth),
+    m_features(queueDepth),
+    m_tracker(0),
+    m_running(false),
+    m_ended(false),
+    m_waiting(0)
+{
+}
+
+StreamingPipeline::~StreamingPipeline()
+{
+    if (m_running) finish();
+    delete m_tracker;
+}
+
+void
+StreamingPipeline::setParameter(string identifier, float value)
+{
+    m_params[identifier] = value;
+}
+
+bool
+StreamingPipeline::start()
+{
+    if (m_running) return false;
+
+    CepstralPitchTracker *tracker = new CepstralPitchTracker(m_sampleRate);
+    for (std::map<string, float>::const_iterator i = m_params.begin();
+         i != m_params.end(); ++i) {
+        tracker->setParameter(i->first, i->second);
+    }
+    if (!tracker->hasIndependentEstimates() ||
+        !tracker->initialise(1, m_stepSize, m_blockSize)) {
+        delete tracker;
+        return false;
+    }
+
+    delete m_tracker;
+    m_tracker = tracker;
+
+    m_running = true;
+    m_ended = false;
+    m_estimateThread = std::thread(&StreamingPipeline::estimateLoop, this);
+    m_trackThread = std::thread(&StreamingPipeline::trackLoop, this);
+    return true;
+}
+
+StreamingPipeline::FeatureSet
+StreamingPipeline::process(const float *spectrum, RealTime timestamp)
+{
+    FeatureSet features;
+    while (m_running && !tryProcess(spectrum, timestamp, features)) {
+        wait(SpectrumRoom);
+    }
+    return features;
+}
+
+bool
+StreamingPipeline::tryProcess(const float *spectrum, RealTime timestamp,
+                              FeatureSet &features)
+{
+    // Collect first: the stages may be waiting on the feature queue,
+    // and the spectrum queue won't empty until they can move on
+    collect(features);
+
+    if (!m_running) return false;
+
+    SpectrumSlot *slot = m_spectra.getWriteSlot();
+    if (!slot) return false;
+
+    std::copy(spectrum, spectrum + m_blockSize + 2, slot->spectrum.begin());
+    slot->time = timestamp;
+    slot->end = false;
+    m_spectra.push();
+    wake();
+    return true;
+}
+
+StreamingPipeline::FeatureSet
+StreamingPipeline::getFeatures()
+{
+    FeatureSet features;
+    collect(features);
+    return features;
+}
+
+StreamingPipeline::FeatureSet
+StreamingPipeline::finish()
+{
+    FeatureSet features;
+    if (!m_running) return features;
+
+    SpectrumSlot *slot = 0;
+    while (!(slot = m_spectra.getWriteSlot())) {
+        collect(features);
+        wait(SpectrumRoom);
+    }
+    slot->end = true;
+    m_spectra.push();
+    wake();
+
+    while (!collect(features)) {
+        wait(FeatureReady);
+    }
+
+    m_estimateThread.join();
+    m_trackThread.join();
+    m_running = false;
+    return features;
+}
+
+bool
+StreamingPipeline::collect(FeatureSet &features)
+{
+    // Append everything waiting in the feature queue to features,
+    // returning true if the end of the stream has been reached
+    FeatureSlot *slot = 0;
+    bool popped = false;
+    while ((slot = m_features.getReadSlot())) {
+        if (slot->end) {
+            m_ended = true;
+        } else {
+            for (FeatureSet::iterator i = slot->features.begin();
+                 i != slot->features.end(); ++i) {
+                Vamp::Plugin::FeatureList &list = features[i->first];
+                list.insert(list.end(), i->second.begin(), i->second.end());
+            }
+        }
+        m_features.pop();
+        popped = true;
+    }
+    if (popped) wake();
+    return m_ended;
+}
+
+bool
+StreamingPipeline::isReady(Condition c)
+{
+    switch (c) {
+    case SpectrumReady: return m_spectra.getReadSlot() != 0;
+    case EstimateRoom: return m_estimates.getWriteSlot() != 0;
+    case EstimateReady: return m_estimates.getReadSlot() != 0;
+    case FeatureRoom: return m_features.getWriteSlot() != 0;
+    case FeatureReady: return m_features.getReadSlot() != 0;
+    case SpectrumRoom:
+        return m_spectra.getWriteSlot() != 0 || m_features.getReadSlot() != 0;
+    }
+    return true;
+}
+
+void
+StreamingPipeline::wait(Condition c)
+{
+    if (isReady(c)) return;
+
+    // Announce the wait before looking again, and wake() looks for
+    // waiters after its push or pop, each with a full fence between,
+    // so that one or other always sees the other's change
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_waiting.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!isReady(c)) {
+        m_condition.wait(lock);
+    }
+    m_waiting.fetch_sub(1);
+}
+
+void
+StreamingPipeline::wake()
+{
+    // Called after every push or pop
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_waiting.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_condition.notify_all();
+    }
+}
+
+void
+StreamingPipeline::estimateLoop()
+{
+    while (true) {
+
+        wait(SpectrumReady);
+        SpectrumSlot *in = m_spectra.getReadSlot();
+
+        wait(EstimateRoom);
+        EstimateSlot *out = m_estimates.getWriteSlot();
+
+        bool end = in->end;
+        out->end = end;
+        if (!end) {
+            out->present = m_tracker->estimateFrame
+                (&in->spectrum[0], in->time, out->estimate);
+        }
+
+        m_estimates.push();
+        m_spectra.pop();
+        wake();
+
+        if (end) return;
+    }
+}
+
+void
+StreamingPipeline::trackLoop()
+{
+    AgentFeeder feeder(m_rules);
+    int nAccepted = 0;
+
+    while (true) {
+
+        wait(EstimateReady);
+        EstimateSlot *in = m_estimates.getReadSlot();
+
+        bool end = in->end;
+        if (end) {
+            feeder.finish();
+        } else if (in->present) {
+            feeder.feed(in->estimate);
+        }
+
+        m_estimates.pop();
+        wake();
+
+        const AgentFeeder::Hypotheses &accepted =
+            feeder.getAcceptedHypotheses();
+
+        if ((int)accepted.size() > nAccepted) {
+
+            wait(FeatureRoom);
+            FeatureSlot *out = m_features.getWriteSlot();
+
+            // Clear the lists rather than the set, to keep their storage
+            for (FeatureSet::iterator i = out->features.begin();
+                 i != out->features.end(); ++i) {
+                i->second.clear();
+            }
+            for (int i = nAccepted; i < (int)accepted.size(); ++i) {
+                CepstralPitchTracker::addFeaturesFrom(accepted[i],
+                                                      out->features);
+            }
+            out->end = false;
+            nAccepted = accepted.size();
+
+            m_features.push();
+            wake();
+        }
+
+        if (end) {
+            wait(FeatureRoom);
+            FeatureSlot *out = m_features.getWriteSlot();
+            out->features.clear();
+            out->end = true;
+            m_features.push();
+            wake();
+            return;
+        }
+    }
+}
@@ -0,0 +1,191 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _STREAMING_PIPELINE_H_
+#define _STREAMING_PIPELINE_H_
+
+#include "CepstralPitchTracker.h"
+#include "NoteHypothesis.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Track the pitch of a single real-time stream with the work split
+ * into stages on separate threads, so that consecutive frames
+ * overlap: while the tracking stage deals with one frame, the
+ * estimate stage is calculating the cepstrum and peak for the next.
+ *
+ * Spectra are passed (in the plugin's input format) to process() on
+ * the caller's thread, which queues them for the estimate stage. Its
+ * estimates are queued in turn for the tracking stage, which feeds
+ * them to an AgentFeeder and queues the features for each accepted
+ * note. The features are returned from later calls to process(), or
+ * from getFeatures() and finish(). The queues are SpscQueues of a
+ * fixed depth, and a stage that finds the next one full waits for
+ * it, so the caller is held up in process() if the pipeline falls
+ * behind, rather than the queues growing. A thread that has to wait,
+ * for room or for work, sleeps on a condition variable until the
+ * thread on the other side of the queue pushes or pops, so an idle
+ * pipeline takes no CPU time.
+ *
+ * The features are exactly those the plugin would return for the
+ * same frames, though they may come out a call or two later. The
+ * pipeline requires estimates that do not depend on the tracking,
+ * so it cannot be used with the skip or narrow parameters.
+ */
+class StreamingPipeline
+{
+public:
+    typedef Vamp::Plugin::FeatureSet FeatureSet;
+
+    /**
+     * Construct a pipeline for input at the given sample rate, step
+     * size and block size, as for the plugin, with each queue
+     * holding up to the given number of frames.
+     */
+    StreamingPipeline(float sampleRate, int stepSize, int blockSize,
+                      int queueDepth = 16);
+    ~StreamingPipeline();
+
+    /**
+     * Set a parameter of the plugin, by its identifier. Takes effect
+     * at the next start().
+     */
+    void setParameter(std::string identifier, float value);
+
+    /**
+     * Set the rules of the note tracking, in place of the defaults.
+     * Takes effect at the next start().
+     */
+    void setNoteRules(const NoteHypothesis::Rules &rules) { m_rules = rules; }
+
+    /**
+     * Start the stage threads. Return false if the plugin could not
+     * be initialised with the sizes and parameters given, or if the
+     * parameters make the estimates depend on the tracking.
+     */
+    bool start();
+
+    /**
+     * Queue a spectrum with its timestamp, waiting for room if the
+     * queue is full, and return any features that have been
+     * completed since the last call. Nothing is queued unless the
+     * pipeline has been started.
+     */
+    FeatureSet process(const float *spectrum, Vamp::RealTime timestamp);
+
+    /**
+     * Queue a spectrum as process() does, but without waiting: if the
+     * queue is full, return false and leave the frame unqueued. Any
+     * completed features are added to the given set either way.
+     */
+    bool tryProcess(const float *spectrum, Vamp::RealTime timestamp,
+                    FeatureSet &features);
+
+    /**
+     * Return any features that have been completed since the last
+     * call, without queueing anything.
+     */
+    FeatureSet getFeatures();
+
+    /**
+     * End the stream, waiting for every queued frame to be dealt
+     * with, and return the remaining features. The stage threads
+     * then exit, and the pipeline may be started again for a new
+     * stream.
+     */
+    FeatureSet finish();
+
+private:
+    StreamingPipeline(const StreamingPipeline &); // not provided
+    StreamingPipeline &operator=(const StreamingPipeline &); // not provided
+
+    struct SpectrumSlot {
+        std::vector<float> spectrum;
+        Vamp::RealTime time;
+        bool end;
+    };
+
+    struct EstimateSlot {
+        NoteHypothesis::Estimate estimate;
+        bool present;
+        bool end;
+    };
+
+    struct FeatureSlot {
+        FeatureSet features;
+        bool end;
+    };
+
+    float m_sampleRate;
+    int m_stepSize;
+    int m_blockSize;
+    std::map<std::string, float> m_params;
+    NoteHypothesis::Rules m_rules;
+
+    SpscQueue<SpectrumSlot> m_spectra;
+    SpscQueue<EstimateSlot> m_estimates;
+    SpscQueue<FeatureSlot> m_features;
+
+    CepstralPitchTracker *m_tracker;
+    std::thread m_estimateThread;
+    std::thread m_trackThread;
+    bool m_running;
+    bool m_ended;
+
+    // What a thread may wait for in wait()
+    enum Condition {
+        SpectrumReady,      // estimate stage: a spectrum to read
+        EstimateRoom,       // estimate stage: room for an estimate
+        EstimateReady,      // tracking stage: an estimate to read
+        FeatureRoom,        // tracking stage: room for features
+        FeatureReady,       // caller: features to read
+        SpectrumRoom        // caller: room for a spectrum, or features
+    };
+
+    // Waiting threads sleep on m_condition. m_waiting counts them, so
+    // that a push or pop need only take the mutex to wake someone
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::atomic<int> m_waiting;
+
+    bool isReady(Condition c);
+    void wait(Condition c);
+    void wake();
+
+    void estimateLoop();
+    void trackLoop();
+    bool collect(FeatureSet &features);
+    static SpectrumSlot makeSpectrumSlot(int blockSize);
+};
+
+#endif
@@ -0,0 +1,118 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threads) :
+    m_task(0),
+    m_count(0),
+    m_next(0),
+    m_busy(0),
+    m_generation(0),
+    m_exiting(false)
+{
+    for (int i = 1; i < threads; ++i) {
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exiting = true;
+    }
+    m_workCondition.notify_all();
+    for (int i = 0; i < (int)m_workers.size(); ++i) {
+        m_workers[i].join();
+    }
+}
+
+void
+ThreadPool::run(Task &task, int n)
+{
+    if (m_workers.empty() || n < 2) {
+        for (int i = 0; i < n; ++i) {
+            task.run(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_count = n;
+        m_next = 0;
+        m_busy = m_workers.size();
+        ++m_generation;
+    }
+    m_workCondition.notify_all();
+
+    work();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_busy > 0) {
+        m_doneCondition.wait(lock);
+    }
+    m_task = 0;
+}
+
+void
+ThreadPool::work()
+{
+    // Take indices one at a time until they run out. The task and
+    // count were set under the mutex before any thread got here
+    while (true) {
+        int i = m_next++;
+        if (i >= m_count) break;
+        m_task->run(i);
+    }
+}
+
+void
+ThreadPool::workerLoop()
+{
+    int seen = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+
+        while (!m_exiting && m_generation == seen) {
+            m_workCondition.wait(lock);
+        }
+        if (m_exiting) return;
+
+        seen = m_generation;
+
+        lock.unlock();
+        work();
+        lock.lock();
+
+        if (--m_busy == 0) {
+            m_doneCondition.notify_one();
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/**
+ * A fixed set of worker threads for running the iterations of a loop
+ * in parallel, such as the per-channel work of a multi-channel
+ * tracker.
+ *
+ * Subclass ThreadPool::Task and pass it to run(), which calls its
+ * run() method once for each index, spread across the pool's threads
+ * and the calling thread, and returns when all calls have
+ * completed. Only one thread may call run() at a time.
+ */
+class ThreadPool
+{
+public:
+    class Task
+    {
+    public:
+        virtual ~Task() { }
+        virtual void run(int index) = 0;
+    };
+
+    /**
+     * Create a pool that runs tasks across the given number of
+     * threads, including the thread that calls run(). A pool of one
+     * thread starts no workers and runs everything in the caller.
+     */
+    ThreadPool(int threads);
+    ~ThreadPool();
+
+    int getThreadCount() const { return int(m_workers.size()) + 1; }
+
+    /**
+     * Call task.run(i) for each i from 0 to n-1, returning when all
+     * have completed.
+     */
+    void run(Task &task, int n);
+
+private:
+    ThreadPool(const ThreadPool &); // not provided
+    ThreadPool &operator=(const ThreadPool &); // not provided
+
+    void work();
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workCondition;
+    std::condition_variable m_doneCondition;
+
+    Task *m_task;
+    int m_count;
+    std::atomic<int> m_next;
+    int m_busy;
+    int m_generation;
+    bool m_exiting;
+};
+
+#endif
@@ -0,0 +1,322 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "TrackFile.h"
+#include "Seconds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+static const uint32_t version = 1;
+static const uint32_t byteOrder = 0x01020304;
+
+static_assert(sizeof(TrackFile::Header) == 72 &&
+              sizeof(TrackFile::NoteRecord) == 24,
+              "track file records must have no padding");
+
+// Returned by the header accessors while no file is open
+static const TrackFile::Header emptyHeader = TrackFile::Header();
+
+static RealTime
+frameTime(long frame, float sampleRate, int stepSize, int blockSize)
+{
+    return RealTime::frame2RealTime
+        (frame * stepSize + blockSize/2, (unsigned int)sampleRate);
+}
+
+// Find the frame whose timestamp is exactly t, or return -1 if there
+// is none
+static long
+frameAt(const RealTime &t, float sampleRate, int stepSize, int blockSize)
+{
+    double sample = toSeconds(t) * (unsigned int)sampleRate;
+    long frame = lrint((sample - blockSize/2) / stepSize);
+    if (frame < 0 ||
+        frameTime(frame, sampleRate, stepSize, blockSize) != t) {
+        return -1;
+    }
+    return frame;
+}
+
+TrackFile::TrackFile() :
+    m_header(&emptyHeader),
+    m_notes(0),
+    m_deltas(0),
+    m_f0(0),
+    m_confidences(0)
+{
+}
+
+TrackFile::~TrackFile()
+{
+    close();
+}
+
+void
+TrackFile::close()
+{
+    m_file.close();
+    m_header = &emptyHeader;
+    m_notes = 0;
+    m_deltas = 0;
+    m_f0 = 0;
+    m_confidences = 0;
+}
+
+bool
+TrackFile::open(string path)
+{
+    close();
+    m_error = "";
+
+    if (!m_file.open(path, MappedFile::Normal)) {
+        m_error = m_file.getError();
+        return false;
+    }
+
+    const unsigned char *base = m_file.getData();
+    size_t size = m_file.getSize();
+
+    if (size < sizeof(Header)) {
+        m_error = path + ": Too short to be a track file";
+        close();
+        return false;
+    }
+
+    const Header *h = (const Header *)base;
+
+    if (memcmp(h->magic, "CPTC", 4)) {
+        m_error = path + ": Not a track file";
+    } else if (h->byteOrder != byteOrder) {
+        m_error = path + ": Written on a machine of different byte order";
+    } else if (h->version != version) {
+        m_error = path + ": Unsupported track file version";
+    } else if (h->encoding != Float && h->encoding != Cents) {
+        m_error = path + ": Unsupported f0 encoding";
+    } else {
+
+        // Each column must lie within the file and be aligned for
+        // its type
+        uint64_t pitches = h->pitchCount;
+        uint64_t offsets[4] = {
+            h->noteOffset, h->deltaOffset, h->f0Offset, h->confidenceOffset
+        };
+        uint64_t lengths[4] = {
+            h->noteCount * uint64_t(sizeof(NoteRecord)),
+            pitches * 2,
+            pitches * (h->encoding == Float ? 4 : 2),
+            pitches * 4
+        };
+        for (int i = 0; i < 4; ++i) {
+            if ((offsets[i] & 7) ||
+                offsets[i] < sizeof(Header) ||
+                offsets[i] > size ||
+                lengths[i] > size - offsets[i]) {
+                m_error = path + ": Truncated or corrupt track file";
+                break;
+            }
+        }
+    }
+
+    if (m_error != "") {
+        close();
+        return false;
+    }
+
+    m_header = h;
+    m_notes = (const NoteRecord *)(base + h->noteOffset);
+    m_deltas = (const uint16_t *)(base + h->deltaOffset);
+    m_f0 = base + h->f0Offset;
+    m_confidences = (const float *)(base + h->confidenceOffset);
+    return true;
+}
+
+const float *
+TrackFile::getFrequencies() const
+{
+    return getEncoding() == Float ? (const float *)m_f0 : 0;
+}
+
+const int16_t *
+TrackFile::getCents() const
+{
+    return getEncoding() == Cents ? (const int16_t *)m_f0 : 0;
+}
+
+RealTime
+TrackFile::getFrameTime(long frame) const
+{
+    return frameTime(frame, getSampleRate(), getStepSize(), getBlockSize());
+}
+
+TrackFile::Note
+TrackFile::getNote(int note) const
+{
+    const NoteRecord &r = m_notes[note];
+    RealTime start = getFrameTime(r.startFrame);
+    return Note(r.frequency, start, getFrameTime(r.endFrame) - start);
+}
+
+int
+TrackFile::readPitches(int note, Pitch *buffer, int capacity) const
+{
+    const NoteRecord &r = m_notes[note];
+
+    // A corrupt record must not take us outside the columns
+    if (r.firstPitch > m_header->pitchCount ||
+        r.pitchCount > m_header->pitchCount - r.firstPitch) {
+        return 0;
+    }
+
+    const float *hz = getFrequencies();
+    const int16_t *cents = getCents();
+
+    int n = std::min(int(r.pitchCount), capacity);
+    long frame = r.startFrame;
+
+    for (int i = 0; i < n; ++i) {
+        int p = r.firstPitch + i;
+        frame += m_deltas[p];
+        buffer[i].time = getFrameTime(frame);
+        buffer[i].freq = (hz ? hz[p] : centsToHz(cents[p]));
+        buffer[i].confidence = m_confidences[p];
+    }
+
+    return n;
+}
+
+double
+TrackFile::centsToHz(int16_t cents)
+{
+    return 440.0 * pow(2.0, cents / 4800.0);
+}
+
+int16_t
+TrackFile::hzToCents(double hz)
+{
+    double q = rint(4800.0 * log2(hz / 440.0));
+    if (!(q > -32768.0)) q = -32768.0; // also catches 0Hz
+    if (q > 32767.0) q = 32767.0;
+    return int16_t(q);
+}
+
+bool
+TrackFile::write(FILE *out, float sampleRate, int stepSize, int blockSize,
+                 Encoding encoding, const vector<Pitch> &pitches,
+                 const vector<Note> &notes)
+{
+    if (sampleRate <= 0.f || stepSize < 1 || blockSize < 2) return false;
+
+    size_t np = pitches.size();
+
+    vector<NoteRecord> records(notes.size());
+    vector<uint16_t> deltas(np);
+    vector<float> hz(encoding == Float ? np : 0);
+    vector<int16_t> cents(encoding == Cents ? np : 0);
+    vector<float> confidences(np);
+
+    // The estimates of each note are those from its start time to
+    // its end time, and come in the same order as the notes
+    size_t p = 0;
+
+    for (size_t i = 0; i < notes.size(); ++i) {
+
+        const Note &n = notes[i];
+        long start = frameAt(n.time, sampleRate, stepSize, blockSize);
+        long end = frameAt(n.time + n.duration,
+                           sampleRate, stepSize, blockSize);
+        if (start < 0 || end < start || end > long(UINT32_MAX)) {
+            return false;
+        }
+
+        NoteRecord &r = records[i];
+        r.startFrame = uint32_t(start);
+        r.endFrame = uint32_t(end);
+        r.firstPitch = uint32_t(p);
+        r.frequency = float(n.freq);
+        r.reserved = 0;
+
+        long prev = start;
+
+        while (p < np && pitches[p].time <= n.time + n.duration) {
+            long frame = frameAt(pitches[p].time,
+                                 sampleRate, stepSize, blockSize);
+            if (frame < prev || frame - prev > 65535) {
+                return false;
+            }
+            deltas[p] = uint16_t(frame - prev);
+            if (encoding == Float) hz[p] = float(pitches[p].freq);
+            else cents[p] = hzToCents(pitches[p].freq);
+            confidences[p] = float(pitches[p].confidence);
+            prev = frame;
+            ++p;
+        }
+
+        r.pitchCount = uint32_t(p - r.firstPitch);
+        if (r.pitchCount == 0 || prev != end) {
+            return false;
+        }
+    }
+
+    if (p != np) {
+        return false;
+    }
+
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "CPTC", 4);
+    h.version = version;
+    h.byteOrder = byteOrder;
+    h.encoding = encoding;
+    h.sampleRate = sampleRate;
+    h.stepSize = stepSize;
+    h.blockSize = blockSize;
+    h.pitchCount = uint32_t(np);
+    h.noteCount = uint32_t(notes.size());
+
+    size_t f0Bytes = (encoding == Float ? 4 : 2) * np;
+
+    h.noteOffset = sizeof(Header);
+    h.deltaOffset = h.noteOffset +
+        MappedFile::padded(records.size() * sizeof(NoteRecord));
+    h.f0Offset = h.deltaOffset + MappedFile::padded(np * 2);
+    h.confidenceOffset = h.f0Offset + MappedFile::padded(f0Bytes);
+
+    const void *f0 = (encoding == Float ?
+                      (const void *)hz.data() : (const void *)cents.data());
+
+    size_t noteBytes = records.size() * sizeof(NoteRecord);
+
+    return MappedFile::writePadded(out, &h, sizeof(h)) &&
+        MappedFile::writePadded(out, records.data(), noteBytes) &&
+        MappedFile::writePadded(out, deltas.data(), np * 2) &&
+        MappedFile::writePadded(out, f0, f0Bytes) &&
+        MappedFile::writePadded(out, confidences.data(), np * 4);
+}
@@ -0,0 +1,181 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _TRACK_FILE_H_
+#define _TRACK_FILE_H_
+
+#include "MappedFile.h"
+#include "NoteHypothesis.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * A compact columnar file of f0 estimates and notes, laid out so
+ * that it may be used straight from a memory mapping, with no
+ * parsing. TrackFile::write() writes one and TrackFile maps one for
+ * reading.
+ *
+ * All values are in the writing machine's byte order, which the
+ * reader checks. The file is:
+ *
+ *   Header      72 bytes, see below
+ *   notes       noteCount x NoteRecord (24 bytes each)
+ *   deltas      pitchCount x uint16, padded to a multiple of 8 bytes
+ *   f0          pitchCount x float32 Hz or int16 cents, padded to 8
+ *   confidence  pitchCount x float32, padded to 8
+ *
+ * Frames are numbered as for OfflineAnalyser: frame i starts at
+ * sample i * step and is timestamped at sample i * step + block / 2.
+ * Each note record gives the frames of its first and last f0
+ * estimates, the index of its first estimate in the columns, and how
+ * many it has. The estimates of each note are consecutive, in time
+ * order, and their frame numbers are held in the deltas column as
+ * the difference from the previous estimate of the same note (so
+ * that the first estimate of each note has delta 0 from its start
+ * frame). Each note's estimates may therefore be decoded without
+ * reading any of the others.
+ *
+ * In the Cents encoding, each f0 is an int16 giving the pitch in
+ * quarter-cents relative to 440Hz, for a range of 3.7Hz to 51kHz
+ * and an error of at most an eighth of a cent. In the Float
+ * encoding it is a float32 in Hz, holding exactly the value the
+ * plugin would return.
+ */
+class TrackFile
+{
+public:
+    typedef NoteHypothesis::Estimate Pitch;
+    typedef NoteHypothesis::Note Note;
+
+    enum Encoding {
+        Float = 0,
+        Cents = 1
+    };
+
+    struct Header {
+        char magic[4];          // "CPTC"
+        uint32_t version;       // 1
+        uint32_t byteOrder;     // 0x01020304, as written
+        uint32_t encoding;      // an Encoding
+        float sampleRate;
+        uint32_t stepSize;
+        uint32_t blockSize;
+        uint32_t pitchCount;
+        uint32_t noteCount;
+        uint32_t reserved;
+        uint64_t noteOffset;    // byte offsets from the start of the file
+        uint64_t deltaOffset;
+        uint64_t f0Offset;
+        uint64_t confidenceOffset;
+    };
+
+    struct NoteRecord {
+        uint32_t startFrame;
+        uint32_t endFrame;
+        uint32_t firstPitch;
+        uint32_t pitchCount;
+        float frequency;        // Hz, in either encoding
+        uint32_t reserved;
+    };
+
+    TrackFile();
+    ~TrackFile();
+
+    /**
+     * Map a file. Return false, with a message available from
+     * getError(), if it cannot be opened or is not a valid track
+     * file written on a machine of the same byte order.
+     */
+    bool open(std::string path);
+
+    void close();
+
+    std::string getError() const { return m_error; }
+
+    float getSampleRate() const { return m_header->sampleRate; }
+    int getStepSize() const { return m_header->stepSize; }
+    int getBlockSize() const { return m_header->blockSize; }
+    Encoding getEncoding() const { return Encoding(m_header->encoding); }
+    int getPitchCount() const { return m_header->pitchCount; }
+    int getNoteCount() const { return m_header->noteCount; }
+
+    /**
+     * The columns, in the mapping. getFrequencies() returns 0 for the
+     * Cents encoding, and getCents() returns 0 for the Float one.
+     */
+    const NoteRecord *getNoteRecords() const { return m_notes; }
+    const uint16_t *getFrameDeltas() const { return m_deltas; }
+    const float *getFrequencies() const;
+    const int16_t *getCents() const;
+    const float *getConfidences() const { return m_confidences; }
+
+    /**
+     * Return the timestamp of the given frame.
+     */
+    Vamp::RealTime getFrameTime(long frame) const;
+
+    /**
+     * Return the given note as the plugin would.
+     */
+    Note getNote(int note) const;
+
+    /**
+     * Decode up to capacity of the f0 estimates of the given note
+     * into the buffer, in order, and return how many were decoded.
+     */
+    int readPitches(int note, Pitch *buffer, int capacity) const;
+
+    static double centsToHz(int16_t cents);
+    static int16_t hzToCents(double hz);
+
+    /**
+     * Write the given f0 estimates and notes, which must be as the
+     * plugin or OfflineAnalyser returns them, for frames laid out as
+     * described above. Return false if the output fails, or if any
+     * time is not that of a frame or any estimate is more than 65535
+     * frames after the one before it in the same note.
+     */
+    static bool write(FILE *out, float sampleRate, int stepSize,
+                      int blockSize, Encoding encoding,
+                      const std::vector<Pitch> &pitches,
+                      const std::vector<Note> &notes);
+
+private:
+    TrackFile(const TrackFile &); // not provided
+    TrackFile &operator=(const TrackFile &); // not provided
+
+    MappedFile m_file;
+    const Header *m_header;
+    const NoteRecord *m_notes;
+    const uint16_t *m_deltas;
+    const void *m_f0;
+    const float *m_confidences;
+    std::string m_error;
+};
+
+#endif
@@ -0,0 +1,149 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _TRACKER_STATS_H_
+#define _TRACKER_STATS_H_
+
+#ifdef WITH_TRACKER_STATS
+#include <chrono>
+#endif
+
+/**
+ * Timing and event counters for the stages of the pitch tracker.
+ *
+ * The counters are only updated if the code is compiled with
+ * WITH_TRACKER_STATS defined. Otherwise the TRACKER_STATS_ macros
+ * below expand to nothing, so that the instrumentation points in the
+ * tracker cost nothing at all, and every counter remains zero.
+ */
+struct TrackerStats
+{
+    enum Stage {
+        LogMagnitude, ///< Magnitude and log-magnitude of the input spectrum
+        Transform,    ///< Inverse FFT from log magnitude to cepstrum
+        Filter,       ///< Mean filter over the interesting cepstral bins
+        PeakSearch,   ///< Peak search, interpolation and confidence
+        Tracking,     ///< Feeding the estimate to the note hypotheses
+        StageCount
+    };
+
+    TrackerStats() { reset(); }
+
+    void reset() {
+        for (int i = 0; i < StageCount; ++i) stageNanos[i] = 0;
+        frames = 0;
+        gatedFrames = 0;
+        interpolatedFrames = 0;
+        candidates = 0;
+        hypothesesAccepted = 0;
+        hypothesesRejected = 0;
+    }
+
+    /// Total time spent in each stage, in nanoseconds
+    unsigned long long stageNanos[StageCount];
+
+    /// Number of frames processed
+    unsigned long long frames;
+
+    /// Number of frames whose mean magnitude was below the threshold
+    /// at which the estimate is given zero confidence
+    unsigned long long gatedFrames;
+
+    /// Number of frames whose estimates were interpolated from their
+    /// neighbours instead of being calculated (with frame skipping)
+    unsigned long long interpolatedFrames;
+
+    /// Sum over all frames of the number of candidate hypotheses
+    /// still alive after that frame was fed
+    unsigned long long candidates;
+
+    /// Number of hypotheses that have been accepted as notes
+    unsigned long long hypothesesAccepted;
+
+    /// Number of candidate hypotheses discarded without being accepted
+    unsigned long long hypothesesRejected;
+
+    static const char *getStageName(Stage s) {
+        switch (s) {
+        case LogMagnitude: return "logmag";
+        case Transform: return "transform";
+        case Filter: return "filter";
+        case PeakSearch: return "peak";
+        case Tracking: return "tracking";
+        case StageCount: break;
+        }
+        return "";
+    }
+
+    /// Return true if the counters are actually updated in this build
+    static bool isEnabled() {
+#ifdef WITH_TRACKER_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+};
+
+#ifdef WITH_TRACKER_STATS
+
+/**
+ * Add the time between construction and destruction to the given
+ * stage of a TrackerStats object.
+ */
+class TrackerStageTimer
+{
+public:
+    TrackerStageTimer(TrackerStats *stats, TrackerStats::Stage stage) :
+        m_stats(stats), m_stage(stage),
+        m_start(std::chrono::steady_clock::now()) { }
+
+    ~TrackerStageTimer() {
+        if (!m_stats) return;
+        m_stats->stageNanos[m_stage] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>
+            (std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    TrackerStats *m_stats;
+    TrackerStats::Stage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#define TRACKER_STATS_TIME(stats, stage) \
+    TrackerStageTimer trackerStageTimer_(stats, TrackerStats::stage)
+
+#define TRACKER_STATS_ADD(stats, counter, n) \
+    do { if (stats) (stats)->counter += (n); } while (0)
+
+#else
+
+#define TRACKER_STATS_TIME(stats, stage)
+#define TRACKER_STATS_ADD(stats, counter, n) do { (void)sizeof(n); } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,167 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sstream>
+
+/**
+ * Minimal timing harness shared by the micro-benchmarks in this
+ * directory. A benchmark is a callable performing one operation; it
+ * is run in batches sized so that each batch takes at least a couple
+ * of milliseconds, and the per-operation time is reported as the
+ * mean, standard deviation and minimum across batches.
+ *
+ * Results are printed to stdout as one JSON object per line.
+ */
+
+struct BenchResult
+{
+    double nsPerOp;
+    double nsVariance;
+    double nsMin;
+    int batches;
+    long opsPerBatch;
+};
+
+/// Somewhere to put results so that the optimiser can't discard them
+static volatile double benchSink = 0.0;
+
+template <typename F>
+BenchResult
+runBench(F &f, int batches = 20)
+{
+    typedef std::chrono::steady_clock clock;
+
+    // calibrate: double the batch size until a batch takes >= 2ms
+    long ops = 1;
+    while (true) {
+        clock::time_point start = clock::now();
+        for (long i = 0; i < ops; ++i) f();
+        double ns = std::chrono::duration<double, std::nano>
+            (clock::now() - start).count();
+        if (ns >= 2e6 || ops >= (1L << 30)) break;
+        ops *= 2;
+    }
+
+    std::vector<double> times;
+    for (int b = 0; b < batches; ++b) {
+        clock::time_point start = clock::now();
+        for (long i = 0; i < ops; ++i) f();
+        double ns = std::chrono::duration<double, std::nano>
+            (clock::now() - start).count();
+        times.push_back(ns / ops);
+    }
+
+    BenchResult r;
+    r.batches = batches;
+    r.opsPerBatch = ops;
+    r.nsPerOp = 0.0;
+    r.nsMin = times[0];
+    for (int b = 0; b < batches; ++b) {
+        r.nsPerOp += times[b];
+        if (times[b] < r.nsMin) r.nsMin = times[b];
+    }
+    r.nsPerOp /= batches;
+    r.nsVariance = 0.0;
+    for (int b = 0; b < batches; ++b) {
+        double d = times[b] - r.nsPerOp;
+        r.nsVariance += d * d;
+    }
+    if (batches > 1) r.nsVariance /= (batches - 1);
+    return r;
+}
+
+/**
+ * Collects the parameters of a single benchmark case and prints its
+ * result as a line of JSON.
+ */
+class BenchReport
+{
+public:
+    BenchReport(std::string name) : m_name(name) { }
+
+    BenchReport &param(std::string key, double value) {
+        std::ostringstream s;
+        s << "\"" << key << "\":" << value;
+        m_params.push_back(s.str());
+        return *this;
+    }
+
+    BenchReport &param(std::string key, std::string value) {
+        m_params.push_back("\"" + key + "\":\"" + value + "\"");
+        return *this;
+    }
+
+    /**
+     * Print the result. itemsPerOp and itemName describe the unit
+     * of throughput, e.g. 513 "bins" per cepstrum.
+     */
+    void print(const BenchResult &r, double itemsPerOp, std::string itemName) {
+        std::string params;
+        for (int i = 0; i < (int)m_params.size(); ++i) {
+            if (i > 0) params += ",";
+            params += m_params[i];
+        }
+        double opsPerSec = 1e9 / r.nsPerOp;
+        printf("{\"benchmark\":\"%s\",\"params\":{%s},"
+               "\"ns_per_op\":%.3f,\"ns_stddev\":%.3f,\"ns_variance\":%.3f,"
+               "\"ns_min\":%.3f,\"ops_per_sec\":%.1f,"
+               "\"throughput\":%.1f,\"throughput_unit\":\"%s/s\","
+               "\"batches\":%d,\"ops_per_batch\":%ld}\n",
+               m_name.c_str(), params.c_str(),
+               r.nsPerOp, sqrt(r.nsVariance), r.nsVariance,
+               r.nsMin, opsPerSec,
+               opsPerSec * itemsPerOp, itemName.c_str(),
+               r.batches, r.opsPerBatch);
+        fflush(stdout);
+    }
+
+private:
+    std::string m_name;
+    std::vector<std::string> m_params;
+};
+
+/**
+ * Return the integer arguments given on the command line, or the
+ * supplied defaults if there are none.
+ */
+static std::vector<int>
+benchArgs(int argc, char **argv, const int *defaults, int ndefaults)
+{
+    std::vector<int> v;
+    for (int i = 1; i < argc; ++i) v.push_back(atoi(argv[i]));
+    if (v.empty()) v = std::vector<int>(defaults, defaults + ndefaults);
+    return v;
+}
+
+#endif
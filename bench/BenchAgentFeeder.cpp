@@ -0,0 +1,92 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "AgentFeeder.h"
+
+#include "Bench.h"
+
+#include <vector>
+
+using Vamp::RealTime;
+
+// Benchmark AgentFeeder::feed with a given maximum number of live
+// candidate hypotheses.
+//
+// Every estimate that is not swallowed by a satisfied hypothesis
+// starts a new candidate, and a candidate needs about 2/confidence
+// estimates to be satisfied. So a stream of steady estimates at
+// confidence 2/K builds up to K live candidates before one of them
+// is satisfied. The stream is divided into notes of K+1 estimates
+// separated by gaps long enough for everything to expire, so that
+// the candidate count cycles between 1 and K.
+
+int main(int argc, char **argv)
+{
+    static const int defaults[] = { 2, 8, 32, 128 };
+    std::vector<int> counts = benchArgs(argc, argv, defaults, 4);
+
+    for (int c = 0; c < (int)counts.size(); ++c) {
+
+        int k = counts[c];
+        double conf = 2.0 / k;
+        int noteLength = k + 2;
+
+        NoteHypothesis::Estimates stream;
+        int ms = 0;
+        for (int note = 0; note < 8; ++note) {
+            double freq = (note % 2) ? 220.0 : 330.0;
+            for (int i = 0; i < noteLength; ++i) {
+                stream.push_back(NoteHypothesis::Estimate
+                                 (freq, RealTime::fromMilliseconds(ms), conf));
+                ms += 5;
+            }
+            ms += 100;
+        }
+
+        AgentFeeder *feeder = new AgentFeeder();
+        int ix = 0;
+        int base = 0;
+
+        auto op = [&]() {
+            if (ix == (int)stream.size()) {
+                // start again a little later, rather than resetting,
+                // so that the accepted list grows as it would in use
+                ix = 0;
+                base += ms;
+            }
+            NoteHypothesis::Estimate e = stream[ix++];
+            e.time = e.time + RealTime::fromMilliseconds(base);
+            feeder->feed(e);
+        };
+
+        BenchResult r = runBench(op);
+        BenchReport("agentfeeder.feed").param("candidates", k)
+            .print(r, 1, "estimates");
+
+        delete feeder;
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "Cepstrum.h"
+
+#include "Bench.h"
+
+#include <vector>
+
+// Benchmark Cepstrum::process across a range of block sizes. The
+// input is a harmonic spectrum with a little noise, much like a
+// frame of sung audio.
+
+int main(int argc, char **argv)
+{
+    static const int defaults[] = { 256, 512, 1024, 2048, 4096, 8192 };
+    std::vector<int> sizes = benchArgs(argc, argv, defaults, 6);
+
+    for (int s = 0; s < (int)sizes.size(); ++s) {
+
+        int n = sizes[s];
+        std::vector<float> in(n + 2);
+        std::vector<double> out(n);
+
+        srand(42);
+        for (int i = 0; i <= n/2; ++i) {
+            double mag = 0.01 * (rand() / double(RAND_MAX));
+            if (i > 0 && i % 12 == 0) mag += 10.0 / (i / 12);
+            in[i*2] = mag;
+            in[i*2+1] = 0.f;
+        }
+
+        Cepstrum cep(n);
+        auto op = [&]() { benchSink += cep.process(&in[0], &out[0]); };
+
+        BenchResult r = runBench(op);
+        BenchReport("cepstrum.process").param("block", n)
+            .print(r, n/2 + 1, "bins");
+    }
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "CepstralPitchTracker.h"
+#include "PitchTrackerEngine.h"
+#include "Stft.h"
+
+#include "SignalGenerator.h"
+
+#include <chrono>
+#include <new>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using Vamp::RealTime;
+
+// Plugin and engine comparison. Runs the note sequence signal,
+// already converted to frequency-domain frames, through the plugin's
+// process(), through a PitchTrackerEngine reading its records into
+// fixed buffers after every frame, and through an engine passing its
+// results to a ResultSink, and reports the time and the heap
+// allocations per frame for each. The STFT is not included.
+//
+// Usage: bench-engine [seconds [blocksize [stepsize]]]
+
+typedef std::chrono::steady_clock Clock;
+
+static bool counting = false;
+static unsigned long long allocations = 0;
+
+void *operator new(size_t n)
+{
+    void *p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    if (counting) ++allocations;
+    return p;
+}
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+class CountingSink : public ResultSink
+{
+public:
+    CountingSink() : notes(0) { }
+    long notes;
+    void onNoteComplete(const NoteHypothesis::Note &) { ++notes; }
+};
+
+static double
+msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>
+        (Clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 60.0;
+    int block = 1024;
+    int step = 256;
+    float rate = 44100.f;
+
+    if (argc > 1) seconds = atof(argv[1]);
+    if (argc > 2) block = atoi(argv[2]);
+    if (argc > 3) step = atoi(argv[3]);
+
+    long samples = long(seconds * rate);
+    int frames = int((samples + step - 1) / step);
+    int fdsize = block + 2;
+
+    std::vector<float> signal(size_t(frames) * step + block, 0.f);
+    SignalGenerator gen(SignalGenerator::Notes, rate);
+    gen.generate(&signal[0], samples);
+
+    std::vector<float> spectra(size_t(frames) * fdsize);
+    std::vector<RealTime> times(frames);
+    Stft stft(block);
+    for (int i = 0; i < frames; ++i) {
+        stft.process(&signal[size_t(i) * step], &spectra[size_t(i) * fdsize]);
+        times[i] = RealTime::frame2RealTime
+            (long(i) * step + block/2, (unsigned int)rate);
+    }
+
+    long notes[3] = { 0, 0, 0 };
+    unsigned long long allocs[3] = { 0, 0, 0 };
+
+    CepstralPitchTracker tracker(rate);
+    tracker.initialise(1, step, block);
+
+    allocations = 0;
+    counting = true;
+    Clock::time_point start = Clock::now();
+
+    for (int i = 0; i < frames; ++i) {
+        const float *in = &spectra[size_t(i) * fdsize];
+        notes[0] += tracker.process(&in, times[i])[1].size();
+    }
+    notes[0] += tracker.getRemainingFeatures()[1].size();
+
+    double plugin = msSince(start);
+    counting = false;
+    allocs[0] = allocations;
+
+    PitchTrackerEngine engine(rate);
+    engine.initialise(step, block);
+
+    const int bufsize = 256;
+    PitchTrackerEngine::Pitch pitches[bufsize];
+    PitchTrackerEngine::Note noteBuffer[bufsize];
+
+    allocations = 0;
+    counting = true;
+    start = Clock::now();
+
+    for (int i = 0; i <= frames; ++i) {
+        if (i < frames) {
+            engine.process(&spectra[size_t(i) * fdsize], fdsize, times[i]);
+        } else {
+            engine.finish();
+        }
+        while (engine.readPitches(pitches, bufsize) > 0) ;
+        int n;
+        while ((n = engine.readNotes(noteBuffer, bufsize)) > 0) {
+            notes[1] += n;
+        }
+    }
+
+    double direct = msSince(start);
+    counting = false;
+    allocs[1] = allocations;
+
+    CountingSink sink;
+    engine.setResultSink(&sink);
+    engine.reset();
+
+    allocations = 0;
+    counting = true;
+    start = Clock::now();
+
+    for (int i = 0; i < frames; ++i) {
+        engine.process(&spectra[size_t(i) * fdsize], fdsize, times[i]);
+    }
+    engine.finish();
+
+    double sunk = msSince(start);
+    counting = false;
+    allocs[2] = allocations;
+    notes[2] = sink.notes;
+
+    printf("{\"benchmark\":\"engine\",\"params\":{\"seconds\":%g,"
+           "\"rate\":%g,\"block\":%d,\"step\":%d},\"frames\":%d,"
+           "\"plugin_ms\":%.3f,\"engine_ms\":%.3f,\"sink_ms\":%.3f,"
+           "\"plugin_allocations_per_frame\":%.3f,"
+           "\"engine_allocations_per_frame\":%.3f,"
+           "\"sink_allocations_per_frame\":%.3f,"
+           "\"plugin_notes\":%ld,\"engine_notes\":%ld,"
+           "\"sink_notes\":%ld}\n",
+           seconds, rate, block, step, frames, plugin, direct, sunk,
+           double(allocs[0]) / frames, double(allocs[1]) / frames,
+           double(allocs[2]) / frames, notes[0], notes[1], notes[2]);
+
+    return 0;
+}
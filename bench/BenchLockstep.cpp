@@ -0,0 +1,148 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "LockstepTracker.h"
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "SignalGenerator.h"
+
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using Vamp::RealTime;
+
+// Multi-stream benchmark. Runs the same set of streams (cycling
+// through the kinds of test signal) first through one
+// CepstralPitchTracker per stream, frame by frame in turn as a server
+// would, and then through a LockstepTracker, and reports the time
+// for each. The STFT is not included in the timing.
+//
+// Usage: bench-lockstep [streams [seconds [blocksize [stepsize]]]]
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>
+        (Clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    int streams = 8;
+    double seconds = 10.0;
+    int block = 1024;
+    int step = 256;
+    float rate = 44100.f;
+
+    if (argc > 1) streams = atoi(argv[1]);
+    if (argc > 2) seconds = atof(argv[2]);
+    if (argc > 3) block = atoi(argv[3]);
+    if (argc > 4) step = atoi(argv[4]);
+
+    long samples = long(seconds * rate);
+    int frames = int((samples + step - 1) / step);
+    int fdsize = block + 2;
+
+    std::vector<std::vector<float> > spectra(streams);
+    std::vector<float> signal(samples + block);
+    Stft stft(block);
+
+    for (int s = 0; s < streams; ++s) {
+        SignalGenerator::Kind kind =
+            SignalGenerator::Kind(s % SignalGenerator::KindCount);
+        SignalGenerator gen(kind, rate);
+        gen.generate(&signal[0], samples);
+        std::fill(signal.begin() + samples, signal.end(), 0.f);
+        spectra[s].resize(size_t(frames) * fdsize);
+        for (int i = 0; i < frames; ++i) {
+            stft.process(&signal[size_t(i) * step],
+                         &spectra[s][size_t(i) * fdsize]);
+        }
+    }
+
+    long features[2] = { 0, 0 };
+    std::vector<const float *> in(streams);
+
+    Clock::time_point start = Clock::now();
+
+    std::vector<CepstralPitchTracker *> trackers;
+    for (int s = 0; s < streams; ++s) {
+        trackers.push_back(new CepstralPitchTracker(rate));
+        trackers[s]->initialise(1, step, block);
+    }
+    for (int i = 0; i < frames; ++i) {
+        RealTime t = RealTime::frame2RealTime
+            (long(i) * step + block/2, (unsigned int)rate);
+        for (int s = 0; s < streams; ++s) {
+            in[s] = &spectra[s][size_t(i) * fdsize];
+            Vamp::Plugin::FeatureSet fs = trackers[s]->process(&in[s], t);
+            features[0] += fs[1].size();
+        }
+    }
+    for (int s = 0; s < streams; ++s) {
+        Vamp::Plugin::FeatureSet fs = trackers[s]->getRemainingFeatures();
+        features[0] += fs[1].size();
+        delete trackers[s];
+    }
+
+    double separate = msSince(start);
+
+    start = Clock::now();
+
+    LockstepTracker lockstep(streams, rate, block);
+    for (int i = 0; i < frames; ++i) {
+        RealTime t = RealTime::frame2RealTime
+            (long(i) * step + block/2, (unsigned int)rate);
+        for (int s = 0; s < streams; ++s) {
+            in[s] = &spectra[s][size_t(i) * fdsize];
+        }
+        std::vector<Vamp::Plugin::FeatureSet> fs = lockstep.process(&in[0], t);
+        for (int s = 0; s < streams; ++s) {
+            features[1] += fs[s][1].size();
+        }
+    }
+    std::vector<Vamp::Plugin::FeatureSet> fs = lockstep.finish();
+    for (int s = 0; s < streams; ++s) {
+        features[1] += fs[s][1].size();
+    }
+
+    double together = msSince(start);
+
+    printf("{\"benchmark\":\"lockstep\",\"params\":{\"streams\":%d,"
+           "\"seconds\":%g,\"rate\":%g,\"block\":%d,\"step\":%d},"
+           "\"frames\":%d,\"separate_ms\":%.3f,\"lockstep_ms\":%.3f,"
+           "\"speedup\":%.2f,\"separate_notes\":%ld,\"lockstep_notes\":%ld}\n",
+           streams, seconds, rate, block, step, frames,
+           separate, together, separate / together,
+           features[0], features[1]);
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "MeanFilter.h"
+
+#include "Bench.h"
+
+#include <vector>
+
+// Benchmark MeanFilter::filterSubsequence over the range of cepstral
+// bins used by the tracker at 44.1kHz (49..882), for a range of
+// filter lengths.
+
+int main(int argc, char **argv)
+{
+    static const int defaults[] = { 1, 3, 5, 9, 15, 31 };
+    std::vector<int> lengths = benchArgs(argc, argv, defaults, 6);
+
+    int m = 2048;
+    int offset = 49;
+    int n = 882 - offset + 1;
+
+    std::vector<double> in(m);
+    std::vector<double> out(n);
+
+    srand(42);
+    for (int i = 0; i < m; ++i) {
+        in[i] = rand() / double(RAND_MAX) - 0.5;
+    }
+
+    for (int l = 0; l < (int)lengths.size(); ++l) {
+
+        int flen = lengths[l];
+        MeanFilter mf(flen);
+        auto op = [&]() {
+            mf.filterSubsequence(&in[0], &out[0], m, n, offset);
+            benchSink += out[n/2];
+        };
+
+        BenchResult r = runBench(op);
+        BenchReport("meanfilter.filterSubsequence")
+            .param("flen", flen).param("bins", n)
+            .print(r, n, "bins");
+    }
+
+    return 0;
+}
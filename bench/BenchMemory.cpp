@@ -0,0 +1,195 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "SignalGenerator.h"
+
+#include <sys/resource.h>
+
+#include <new>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using Vamp::RealTime;
+
+// Heap allocation and peak memory benchmark. Runs the plugin over a
+// long synthetic input (an hour of sung notes by default), streaming
+// the audio so that the input itself takes no significant memory,
+// and counts the heap allocations made inside the plugin's
+// process() and getRemainingFeatures() calls through replacement
+// global operator new and delete. Reports allocations and bytes per
+// frame and per emitted note, the peak live heap, and the peak
+// resident set size, at intervals through the input and at the end.
+//
+// Usage: bench-memory [seconds [signal [blocksize [stepsize]]]]
+
+static bool counting = false;
+static unsigned long long allocations = 0;
+static unsigned long long allocatedBytes = 0;
+static long long liveBytes = 0;
+static long long peakLiveBytes = 0;
+
+// Each block carries its size in a header, so that live bytes can be
+// tracked on delete. The header is 16 bytes to preserve alignment.
+static const size_t headerSize = 16;
+
+static void *
+countedAlloc(size_t n)
+{
+    char *p = (char *)malloc(n + headerSize);
+    if (!p) throw std::bad_alloc();
+    *(size_t *)p = n;
+    if (counting) {
+        ++allocations;
+        allocatedBytes += n;
+    }
+    liveBytes += n;
+    if (liveBytes > peakLiveBytes) peakLiveBytes = liveBytes;
+    return p + headerSize;
+}
+
+static void
+countedFree(void *ptr)
+{
+    if (!ptr) return;
+    char *p = (char *)ptr - headerSize;
+    liveBytes -= *(size_t *)p;
+    free(p);
+}
+
+void *operator new(size_t n) { return countedAlloc(n); }
+void *operator new[](size_t n) { return countedAlloc(n); }
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { countedFree(p); }
+
+static long
+peakRssKB()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+static void
+report(const char *signal, double seconds, long frames, long notes, bool final)
+{
+    printf("{\"benchmark\":\"memory\",\"params\":{\"signal\":\"%s\"},"
+           "\"final\":%s,\"seconds\":%.1f,\"frames\":%ld,\"notes\":%ld,"
+           "\"allocations\":%llu,\"bytes\":%llu,"
+           "\"allocations_per_frame\":%.3f,\"bytes_per_frame\":%.1f,"
+           "\"allocations_per_note\":%.1f,\"bytes_per_note\":%.1f,"
+           "\"peak_heap_bytes\":%lld,\"peak_rss_kb\":%ld}\n",
+           signal, final ? "true" : "false", seconds, frames, notes,
+           allocations, allocatedBytes,
+           frames ? double(allocations) / frames : 0.0,
+           frames ? double(allocatedBytes) / frames : 0.0,
+           notes ? double(allocations) / notes : 0.0,
+           notes ? double(allocatedBytes) / notes : 0.0,
+           peakLiveBytes, peakRssKB());
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 3600.0;
+    SignalGenerator::Kind kind = SignalGenerator::Notes;
+    int block = 1024;
+    int step = 256;
+    float rate = 44100.f;
+
+    if (argc > 1) seconds = atof(argv[1]);
+    if (argc > 2 && !SignalGenerator::parseKind(argv[2], kind)) {
+        fprintf(stderr, "Unknown signal type \"%s\"\n", argv[2]);
+        return 2;
+    }
+    if (argc > 3) block = atoi(argv[3]);
+    if (argc > 4) step = atoi(argv[4]);
+
+    const char *name = SignalGenerator::getKindName(kind);
+
+    long frames = long(seconds * rate) / step;
+    long reportInterval = long(600.0 * rate) / step;
+
+    SignalGenerator gen(kind, rate);
+    Stft stft(block);
+
+    // The block buffer holds the current frame; each step, shift it
+    // along and generate step more samples at the end
+    std::vector<float> buffer(block, 0.f);
+    gen.generate(&buffer[block/2], block - block/2);
+
+    std::vector<float> spectrum(block + 2);
+    const float *in = &spectrum[0];
+
+    CepstralPitchTracker tracker(rate);
+    if (!tracker.initialise(1, step, block)) {
+        fprintf(stderr, "Failed to initialise tracker with step %d, block %d\n",
+                step, block);
+        return 1;
+    }
+
+    long notes = 0;
+
+    for (long i = 0; i < frames; ++i) {
+
+        stft.process(&buffer[0], &spectrum[0]);
+
+        RealTime t = RealTime::frame2RealTime(i * step, (unsigned int)rate);
+
+        counting = true;
+        {
+            Vamp::Plugin::FeatureSet fs = tracker.process(&in, t);
+            notes += fs[1].size();
+        }
+        counting = false;
+
+        std::copy(buffer.begin() + step, buffer.end(), buffer.begin());
+        gen.generate(&buffer[block - step], step);
+
+        if (i > 0 && i % reportInterval == 0) {
+            report(name, double(i) * step / rate, i, notes, false);
+        }
+    }
+
+    counting = true;
+    {
+        Vamp::Plugin::FeatureSet fs = tracker.getRemainingFeatures();
+        notes += fs[1].size();
+    }
+    counting = false;
+
+    report(name, double(frames) * step / rate, frames, notes, true);
+
+    return 0;
+}
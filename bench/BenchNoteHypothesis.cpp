@@ -0,0 +1,82 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "NoteHypothesis.h"
+
+#include "Bench.h"
+
+#include <vector>
+
+using Vamp::RealTime;
+
+// Benchmark NoteHypothesis::accept against a hypothesis that already
+// holds a given number of estimates. The cost of accept() depends on
+// that number, because the mean frequency and confidence are
+// recalculated from all of them.
+
+int main(int argc, char **argv)
+{
+    static const int defaults[] = { 1, 10, 100, 1000 };
+    std::vector<int> lengths = benchArgs(argc, argv, defaults, 4);
+
+    for (int l = 0; l < (int)lengths.size(); ++l) {
+
+        int len = lengths[l];
+
+        // Low confidence so the hypothesis stays Provisional, and the
+        // satisfaction test runs on every accept
+        double conf = 0.001;
+
+        NoteHypothesis base;
+        for (int i = 0; i < len; ++i) {
+            base.accept(NoteHypothesis::Estimate
+                        (440.0, RealTime::fromMilliseconds(i * 5), conf));
+        }
+
+        NoteHypothesis::Estimate e
+            (441.0, RealTime::fromMilliseconds(len * 5), conf);
+
+        // Time the copy separately, so it can be subtracted
+        auto copy = [&]() {
+            NoteHypothesis h(base);
+            benchSink += h.getState();
+        };
+        BenchResult rc = runBench(copy);
+        BenchReport("notehypothesis.copy").param("pending", len)
+            .print(rc, 1, "copies");
+
+        auto op = [&]() {
+            NoteHypothesis h(base);
+            benchSink += h.accept(e);
+        };
+        BenchResult r = runBench(op);
+        r.nsPerOp -= rc.nsPerOp;
+        r.nsMin -= rc.nsMin;
+        BenchReport("notehypothesis.accept").param("pending", len)
+            .print(r, 1, "estimates");
+    }
+
+    return 0;
+}
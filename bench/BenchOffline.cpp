@@ -0,0 +1,121 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "OfflineAnalyser.h"
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "SignalGenerator.h"
+
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+
+using Vamp::RealTime;
+
+// Whole-file benchmark. Analyses one long run of the note sequence
+// signal first with the plugin, a frame at a time, and then with an
+// OfflineAnalyser, and reports the time for each, along with the
+// time the analyser spends in its estimate and tracking stages. The
+// STFT is included in both timings, as the analyser does its own.
+//
+// Usage: bench-offline [seconds [threads [blocksize [stepsize]]]]
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>
+        (Clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 600.0;
+    int threads = 0;
+    int block = 1024;
+    int step = 256;
+    float rate = 44100.f;
+
+    if (argc > 1) seconds = atof(argv[1]);
+    if (argc > 2) threads = atoi(argv[2]);
+    if (argc > 3) block = atoi(argv[3]);
+    if (argc > 4) step = atoi(argv[4]);
+
+    if (threads < 1) threads = std::thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+
+    long samples = long(seconds * rate);
+    int frames = int((samples + step - 1) / step);
+
+    std::vector<float> signal(size_t(frames) * step + block, 0.f);
+    SignalGenerator gen(SignalGenerator::Notes, rate);
+    gen.generate(&signal[0], samples);
+
+    long notes[2] = { 0, 0 };
+
+    Clock::time_point start = Clock::now();
+
+    CepstralPitchTracker tracker(rate);
+    tracker.initialise(1, step, block);
+    Stft stft(block);
+    std::vector<float> spectrum(block + 2);
+    const float *in = &spectrum[0];
+    for (int i = 0; i < frames; ++i) {
+        RealTime t = RealTime::frame2RealTime
+            (long(i) * step + block/2, (unsigned int)rate);
+        stft.process(&signal[size_t(i) * step], &spectrum[0]);
+        notes[0] += tracker.process(&in, t)[1].size();
+    }
+    notes[0] += tracker.getRemainingFeatures()[1].size();
+
+    double serial = msSince(start);
+
+    start = Clock::now();
+
+    OfflineAnalyser analyser(rate, step, block, threads);
+    OfflineAnalyser::Frames estimates;
+    analyser.estimate(&signal[0], samples, estimates);
+
+    double estimated = msSince(start);
+
+    notes[1] = analyser.track(estimates)[1].size();
+
+    double offline = msSince(start);
+
+    printf("{\"benchmark\":\"offline\",\"params\":{\"seconds\":%g,"
+           "\"threads\":%d,\"rate\":%g,\"block\":%d,\"step\":%d},"
+           "\"frames\":%d,\"serial_ms\":%.3f,\"offline_ms\":%.3f,"
+           "\"estimate_ms\":%.3f,\"track_ms\":%.3f,\"speedup\":%.2f,"
+           "\"serial_notes\":%ld,\"offline_notes\":%ld}\n",
+           seconds, threads, rate, block, step, frames,
+           serial, offline, estimated, offline - estimated,
+           serial / offline, notes[0], notes[1]);
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PeakInterpolator.h"
+
+#include "Bench.h"
+
+#include <vector>
+
+// Benchmark both PeakInterpolator::findPeakLocation overloads: the
+// one that scans for the maximum, and the one given the peak index.
+// The arguments are the array sizes to search.
+
+int main(int argc, char **argv)
+{
+    static const int defaults[] = { 64, 256, 834, 2048 };
+    std::vector<int> sizes = benchArgs(argc, argv, defaults, 4);
+
+    PeakInterpolator pi;
+
+    for (int s = 0; s < (int)sizes.size(); ++s) {
+
+        int n = sizes[s];
+        std::vector<double> data(n);
+
+        srand(42);
+        for (int i = 0; i < n; ++i) {
+            data[i] = rand() / double(RAND_MAX);
+        }
+        int peak = n / 3;
+        data[peak] = 2.0;
+
+        auto scan = [&]() { benchSink += pi.findPeakLocation(&data[0], n); };
+        BenchResult r = runBench(scan);
+        BenchReport("peakinterpolator.findPeakLocation")
+            .param("size", n).param("overload", "scan")
+            .print(r, n, "samples");
+
+        auto indexed = [&]() {
+            benchSink += pi.findPeakLocation(&data[0], n, peak);
+        };
+        r = runBench(indexed);
+        BenchReport("peakinterpolator.findPeakLocation")
+            .param("size", n).param("overload", "index")
+            .print(r, 1, "peaks");
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "StreamingPipeline.h"
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "SignalGenerator.h"
+
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using Vamp::RealTime;
+
+// Streaming benchmark. Feeds one stream of the note sequence signal,
+// a frame at a time, first through the plugin and then through a
+// StreamingPipeline, and reports the time for each and how many
+// times faster than real time it is. The STFT is not included in the
+// timing.
+//
+// Usage: bench-pipeline [seconds [queuedepth [blocksize [stepsize]]]]
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>
+        (Clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 60.0;
+    int depth = 16;
+    int block = 1024;
+    int step = 256;
+    float rate = 44100.f;
+
+    if (argc > 1) seconds = atof(argv[1]);
+    if (argc > 2) depth = atoi(argv[2]);
+    if (argc > 3) block = atoi(argv[3]);
+    if (argc > 4) step = atoi(argv[4]);
+
+    long samples = long(seconds * rate);
+    int frames = int((samples + step - 1) / step);
+    int fdsize = block + 2;
+
+    std::vector<float> signal(size_t(frames) * step + block, 0.f);
+    SignalGenerator gen(SignalGenerator::Notes, rate);
+    gen.generate(&signal[0], samples);
+
+    std::vector<float> spectra(size_t(frames) * fdsize);
+    Stft stft(block);
+    for (int i = 0; i < frames; ++i) {
+        stft.process(&signal[size_t(i) * step], &spectra[size_t(i) * fdsize]);
+    }
+
+    long notes[2] = { 0, 0 };
+
+    Clock::time_point start = Clock::now();
+
+    CepstralPitchTracker tracker(rate);
+    tracker.initialise(1, step, block);
+    for (int i = 0; i < frames; ++i) {
+        RealTime t = RealTime::frame2RealTime
+            (long(i) * step + block/2, (unsigned int)rate);
+        const float *in = &spectra[size_t(i) * fdsize];
+        notes[0] += tracker.process(&in, t)[1].size();
+    }
+    notes[0] += tracker.getRemainingFeatures()[1].size();
+
+    double serial = msSince(start);
+
+    start = Clock::now();
+
+    StreamingPipeline pipeline(rate, step, block, depth);
+    pipeline.start();
+    for (int i = 0; i < frames; ++i) {
+        RealTime t = RealTime::frame2RealTime
+            (long(i) * step + block/2, (unsigned int)rate);
+        notes[1] += pipeline.process(&spectra[size_t(i) * fdsize], t)[1].size();
+    }
+    notes[1] += pipeline.finish()[1].size();
+
+    double pipelined = msSince(start);
+
+    printf("{\"benchmark\":\"pipeline\",\"params\":{\"seconds\":%g,"
+           "\"depth\":%d,\"rate\":%g,\"block\":%d,\"step\":%d},"
+           "\"frames\":%d,\"serial_ms\":%.3f,\"pipeline_ms\":%.3f,"
+           "\"serial_realtime\":%.1f,\"pipeline_realtime\":%.1f,"
+           "\"serial_notes\":%ld,\"pipeline_notes\":%ld}\n",
+           seconds, depth, rate, block, step, frames, serial, pipelined,
+           seconds * 1000.0 / serial, seconds * 1000.0 / pipelined,
+           notes[0], notes[1]);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "SignalGenerator.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+using Vamp::RealTime;
+
+// End-to-end benchmark of the plugin on synthetic audio. For each
+// kind of test signal, convert it to frequency-domain frames as a
+// host would, then time CepstralPitchTracker through initialise(),
+// process() for every frame, and getRemainingFeatures(). The STFT
+// itself is not included in the timing.
+//
+// Usage: bench-realtime [seconds [blocksize [stepsize [param=value ...]]]]
+
+typedef std::chrono::steady_clock Clock;
+
+static double
+nsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>
+        (Clock::now() - start).count();
+}
+
+static double
+percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty()) return 0.0;
+    int ix = int(p * (sorted.size() - 1) + 0.5);
+    return sorted[ix];
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 30.0;
+    int block = 1024;
+    int step = 256;
+    float rate = 44100.f;
+
+    if (argc > 1) seconds = atof(argv[1]);
+    if (argc > 2) block = atoi(argv[2]);
+    if (argc > 3) step = atoi(argv[3]);
+
+    std::map<std::string, float> params;
+    std::string paramText;
+    for (int i = 4; i < argc; ++i) {
+        std::string p = argv[i];
+        std::string::size_type eq = p.find('=');
+        if (eq == std::string::npos) {
+            fprintf(stderr, "Expected param=value, not \"%s\"\n", argv[i]);
+            return 2;
+        }
+        params[p.substr(0, eq)] = atof(p.substr(eq + 1).c_str());
+        paramText += ",\"" + p.substr(0, eq) + "\":" + p.substr(eq + 1);
+    }
+
+    long samples = long(seconds * rate);
+    int frames = int((samples + step - 1) / step);
+    int fdsize = block + 2;
+
+    std::vector<float> spectra(size_t(frames) * fdsize);
+    std::vector<float> signal(samples + block);
+    Stft stft(block);
+
+    for (int k = 0; k < SignalGenerator::KindCount; ++k) {
+
+        SignalGenerator::Kind kind = SignalGenerator::Kind(k);
+        SignalGenerator gen(kind, rate);
+        gen.generate(&signal[0], samples);
+        std::fill(signal.begin() + samples, signal.end(), 0.f);
+
+        for (int i = 0; i < frames; ++i) {
+            stft.process(&signal[size_t(i) * step], &spectra[size_t(i) * fdsize]);
+        }
+
+        CepstralPitchTracker tracker(rate);
+        for (std::map<std::string, float>::const_iterator i = params.begin();
+             i != params.end(); ++i) {
+            tracker.setParameter(i->first, i->second);
+        }
+
+        Clock::time_point start = Clock::now();
+
+        if (!tracker.initialise(1, step, block)) {
+            fprintf(stderr, "Failed to initialise tracker with step %d, block %d\n",
+                    step, block);
+            return 1;
+        }
+
+        std::vector<double> latencies;
+        latencies.reserve(frames);
+        long features[2] = { 0, 0 };
+
+        for (int i = 0; i < frames; ++i) {
+            const float *in = &spectra[size_t(i) * fdsize];
+            RealTime t = RealTime::frame2RealTime
+                (long(i) * step + block/2, (unsigned int)rate);
+            Clock::time_point fstart = Clock::now();
+            Vamp::Plugin::FeatureSet fs = tracker.process(&in, t);
+            latencies.push_back(nsSince(fstart));
+            features[0] += fs[0].size();
+            features[1] += fs[1].size();
+        }
+
+        Vamp::Plugin::FeatureSet fs = tracker.getRemainingFeatures();
+        features[0] += fs[0].size();
+        features[1] += fs[1].size();
+
+        double total = nsSince(start);
+
+        std::sort(latencies.begin(), latencies.end());
+
+        printf("{\"benchmark\":\"realtime\",\"params\":{\"signal\":\"%s\","
+               "\"seconds\":%g,\"rate\":%g,\"block\":%d,\"step\":%d%s},"
+               "\"frames\":%d,\"total_ms\":%.3f,\"x_realtime\":%.2f,"
+               "\"frame_ns_p50\":%.0f,\"frame_ns_p90\":%.0f,"
+               "\"frame_ns_p99\":%.0f,\"frame_ns_max\":%.0f,"
+               "\"f0_features\":%ld,\"note_features\":%ld}\n",
+               SignalGenerator::getKindName(kind), seconds, rate, block, step,
+               paramText.c_str(),
+               frames, total / 1e6, (seconds * 1e9) / total,
+               percentile(latencies, 0.5), percentile(latencies, 0.9),
+               percentile(latencies, 0.99), percentile(latencies, 1.0),
+               features[0], features[1]);
+        fflush(stdout);
+    }
+
+    return 0;
+}
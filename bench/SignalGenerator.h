@@ -0,0 +1,166 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _SIGNAL_GENERATOR_H_
+#define _SIGNAL_GENERATOR_H_
+
+#include <cmath>
+#include <string>
+
+/**
+ * Deterministic synthetic test audio for the benchmarks, so that they
+ * can run anywhere without an audio corpus.
+ *
+ * Pitched signals are built from a stack of harmonic sinusoids with
+ * amplitudes falling off as 1/h, which gives the cepstrum a clear
+ * peak at the fundamental period. The signal is produced in pieces
+ * through generate(), so arbitrarily long inputs can be streamed
+ * without holding them in memory.
+ */
+class SignalGenerator
+{
+public:
+    enum Kind {
+        Sine,     ///< Steady 220Hz harmonic tone
+        Vibrato,  ///< Singing-like 330Hz tone with 5.5Hz, 40 cent vibrato
+        Notes,    ///< Sequence of vibrato notes with short gaps between
+        Silence,  ///< Digital silence
+        Noise,    ///< White noise
+        KindCount
+    };
+
+    SignalGenerator(Kind kind, float sampleRate) :
+        m_kind(kind), m_rate(sampleRate), m_n(0), m_phase(0.0),
+        m_seed(1) { }
+
+    static const char *getKindName(Kind k) {
+        switch (k) {
+        case Sine: return "sine";
+        case Vibrato: return "vibrato";
+        case Notes: return "notes";
+        case Silence: return "silence";
+        case Noise: return "noise";
+        case KindCount: break;
+        }
+        return "";
+    }
+
+    static bool parseKind(std::string name, Kind &k) {
+        for (int i = 0; i < KindCount; ++i) {
+            if (name == getKindName(Kind(i))) {
+                k = Kind(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Write the next n samples of the signal to out.
+     */
+    void generate(float *out, int n) {
+        for (int i = 0; i < n; ++i) {
+            out[i] = next();
+        }
+    }
+
+private:
+    Kind m_kind;
+    double m_rate;
+    long m_n;
+    double m_phase;
+    unsigned int m_seed;
+
+    enum { Harmonics = 8 };
+
+    float next() {
+
+        double t = m_n / m_rate;
+        ++m_n;
+
+        double f0 = 0.0;
+        double amp = 0.0;
+
+        switch (m_kind) {
+
+        case Sine:
+            f0 = 220.0;
+            amp = 0.3;
+            break;
+
+        case Vibrato:
+            f0 = 330.0 * pow(2.0, (40.0 / 1200.0) * sin(2 * M_PI * 5.5 * t));
+            amp = 0.3;
+            break;
+
+        case Notes: {
+            // 0.5 sec notes with a 0.1 sec gap after each, and a
+            // 20ms linear attack and release
+            static const int pitches[] = { 57, 60, 62, 64, 65, 67, 64, 60 };
+            double period = 0.6, length = 0.5, ramp = 0.02;
+            int note = int(t / period);
+            double within = t - note * period;
+            if (within < length) {
+                double midi = pitches[note % 8];
+                f0 = 440.0 * pow(2.0, (midi - 69.0) / 12.0);
+                f0 *= pow(2.0, (30.0 / 1200.0) * sin(2 * M_PI * 5.5 * within));
+                amp = 0.3;
+                if (within < ramp) amp *= within / ramp;
+                if (length - within < ramp) amp *= (length - within) / ramp;
+            }
+            break;
+        }
+
+        case Silence:
+            return 0.f;
+
+        case Noise:
+            m_seed = m_seed * 1103515245 + 12345;
+            return float(0.3 * ((m_seed >> 8) / double(1 << 24) * 2.0 - 1.0));
+
+        case KindCount:
+            break;
+        }
+
+        if (f0 == 0.0) {
+            m_phase = 0.0;
+            return 0.f;
+        }
+
+        m_phase += 2 * M_PI * f0 / m_rate;
+        if (m_phase > 2 * M_PI) m_phase -= 2 * M_PI;
+
+        double v = 0.0;
+        double norm = 0.0;
+        for (int h = 1; h <= Harmonics; ++h) {
+            if (h * f0 >= m_rate / 2) break;
+            v += sin(h * m_phase) / h;
+            norm += 1.0 / h;
+        }
+        return float(amp * v / norm);
+    }
+};
+
+#endif
@@ -0,0 +1,267 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cpt.h"
+#include "PitchTrackerEngine.h"
+#include "Seconds.h"
+#include "Stft.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using std::vector;
+using Vamp::RealTime;
+
+struct cpt_tracker
+{
+    cpt_tracker(float rate, int block, int step) :
+        sampleRate(rate), blockSize(block), stepSize(step),
+        engine(rate), frames(0), stft(0) { }
+    ~cpt_tracker() { delete stft; }
+
+    float sampleRate;
+    int blockSize;
+    int stepSize;
+    PitchTrackerEngine engine;
+    long frames; // processed since the last reset, for the timestamps
+
+    // Used only by cpt_analyse(), and created on its first call
+    Stft *stft;
+    vector<float> block;
+    vector<float> spectrum;
+
+    RealTime frameTime(long frame) const {
+        return RealTime::frame2RealTime
+            (frame * stepSize + blockSize/2, (unsigned int)sampleRate);
+    }
+
+    bool restart() {
+        frames = 0;
+        return engine.initialise(stepSize, blockSize);
+    }
+};
+
+// Records are read from the engine through a buffer of this many at
+// a time and converted as they are copied out
+static const int drainBuffer = 64;
+
+// Nothing may throw across the C interface, so each entry point
+// returning int catches everything and reports it as -1
+
+extern "C" {
+
+int
+cpt_api_version(void)
+{
+    return CPT_API_VERSION;
+}
+
+cpt_tracker *
+cpt_create(float sampleRate, int blockSize, int stepSize)
+{
+    if (!(sampleRate > 0.f)) return 0;
+    if (blockSize < 2 || (blockSize & (blockSize - 1))) return 0;
+    try {
+        cpt_tracker *t = new cpt_tracker(sampleRate, blockSize, stepSize);
+        if (!t->restart()) {
+            delete t;
+            return 0;
+        }
+        return t;
+    } catch (...) {
+        return 0;
+    }
+}
+
+void
+cpt_destroy(cpt_tracker *tracker)
+{
+    delete tracker;
+}
+
+int
+cpt_set_parameter(cpt_tracker *tracker, const char *identifier, float value)
+{
+    if (!tracker || !identifier) return -1;
+
+    PitchTrackerEngine &e = tracker->engine;
+
+    if (!strcmp(identifier, "bandlimit")) e.setBandLimit(value);
+    else if (!strcmp(identifier, "skip")) e.setSkip(int(value + 0.5));
+    else if (!strcmp(identifier, "narrow")) e.setNarrow(value > 0.5f);
+    else if (!strcmp(identifier, "refine")) e.setRefine(int(value + 0.5));
+    else if (!strcmp(identifier, "dual")) e.setDual(value > 0.5f);
+    else return -1;
+
+    try {
+        return tracker->restart() ? 0 : -1;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void
+cpt_reset(cpt_tracker *tracker)
+{
+    if (!tracker) return;
+    tracker->frames = 0;
+    tracker->engine.reset();
+}
+
+int
+cpt_process_batch(cpt_tracker *tracker, const float *spectra, int nframes)
+{
+    if (!tracker || nframes < 0 || (nframes > 0 && !spectra)) return -1;
+
+    int fdsize = tracker->blockSize + 2;
+
+    try {
+        for (int i = 0; i < nframes; ++i) {
+            if (!tracker->engine.process(spectra + long(i) * fdsize, fdsize,
+                                         tracker->frameTime(tracker->frames))) {
+                return -1;
+            }
+            ++tracker->frames;
+        }
+    } catch (...) {
+        return -1;
+    }
+
+    return nframes;
+}
+
+void
+cpt_finish(cpt_tracker *tracker)
+{
+    if (!tracker) return;
+    tracker->engine.finish();
+}
+
+int
+cpt_analyse(cpt_tracker *tracker, const float *samples, long n)
+{
+    if (!tracker || n < 0 || (n > 0 && !samples)) return -1;
+
+    int block = tracker->blockSize;
+    int step = tracker->stepSize;
+    long count = (n + step - 1) / step;
+
+    try {
+        if (!tracker->stft) {
+            tracker->stft = new Stft(block);
+            tracker->block.resize(block);
+            tracker->spectrum.resize(block + 2);
+        }
+
+        cpt_reset(tracker);
+
+        for (long i = 0; i < count; ++i) {
+
+            // Frames running past the end of the input are padded
+            long start = i * step;
+            const float *in = samples + start;
+            if (start + block > n) {
+                std::fill(tracker->block.begin(), tracker->block.end(), 0.f);
+                std::copy(in, samples + n, tracker->block.begin());
+                in = &tracker->block[0];
+            }
+
+            tracker->stft->process(in, &tracker->spectrum[0]);
+
+            if (cpt_process_batch(tracker, &tracker->spectrum[0], 1) < 0) {
+                return -1;
+            }
+        }
+
+        tracker->engine.finish();
+
+    } catch (...) {
+        return -1;
+    }
+
+    return int(count);
+}
+
+int
+cpt_pending_pitches(const cpt_tracker *tracker)
+{
+    if (!tracker) return -1;
+    return tracker->engine.getPitchCount();
+}
+
+int
+cpt_pending_notes(const cpt_tracker *tracker)
+{
+    if (!tracker) return -1;
+    return tracker->engine.getNoteCount();
+}
+
+int
+cpt_drain_pitches(cpt_tracker *tracker, cpt_pitch *out, int capacity)
+{
+    if (!tracker || capacity < 0 || (capacity > 0 && !out)) return -1;
+
+    PitchTrackerEngine::Pitch buffer[drainBuffer];
+    int copied = 0;
+
+    while (copied < capacity) {
+        int n = tracker->engine.readPitches
+            (buffer, std::min(drainBuffer, capacity - copied));
+        if (n == 0) break;
+        for (int i = 0; i < n; ++i) {
+            cpt_pitch &p = out[copied++];
+            p.time = toSeconds(buffer[i].time);
+            p.frequency = buffer[i].freq;
+            p.confidence = buffer[i].confidence;
+        }
+    }
+
+    return copied;
+}
+
+int
+cpt_drain_notes(cpt_tracker *tracker, cpt_note *out, int capacity)
+{
+    if (!tracker || capacity < 0 || (capacity > 0 && !out)) return -1;
+
+    PitchTrackerEngine::Note buffer[drainBuffer];
+    int copied = 0;
+
+    while (copied < capacity) {
+        int n = tracker->engine.readNotes
+            (buffer, std::min(drainBuffer, capacity - copied));
+        if (n == 0) break;
+        for (int i = 0; i < n; ++i) {
+            cpt_note &e = out[copied++];
+            e.time = toSeconds(buffer[i].time);
+            e.duration = toSeconds(buffer[i].duration);
+            e.frequency = buffer[i].freq;
+        }
+    }
+
+    return copied;
+}
+
+}
@@ -0,0 +1,162 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _CPT_H_
+#define _CPT_H_
+
+/**
+ * A plain C interface to the pitch and note tracker, for programs
+ * that would otherwise have to load the plugin through a Vamp host
+ * library. It is exported from the cpt shared library, and wraps a
+ * single PitchTrackerEngine.
+ *
+ * Input is passed as flat float arrays, which are read in place, and
+ * results are copied out into arrays of the flat structures below,
+ * supplied by the caller. Nothing returned refers to memory owned by
+ * the tracker. A whole recording may be analysed in one call to
+ * cpt_analyse(), or a stream of spectra passed in batches of any
+ * size to cpt_process_batch().
+ *
+ * A tracker must not be used from more than one thread at a time,
+ * but separate trackers are independent of one another.
+ *
+ * Functions returning int return a negative value on error.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The version of this interface. It changes only if an existing
+ * function or structure changes.
+ */
+#define CPT_API_VERSION 1
+
+/**
+ * An f0 estimate of an accepted note, as returned on the plugin's f0
+ * output. Times are in seconds from the start of the input.
+ */
+typedef struct cpt_pitch {
+    double time;
+    double frequency;
+    double confidence;
+} cpt_pitch;
+
+/**
+ * A note, as returned on the plugin's notes output.
+ */
+typedef struct cpt_note {
+    double time;
+    double duration;
+    double frequency;
+} cpt_note;
+
+typedef struct cpt_tracker cpt_tracker;
+
+/**
+ * Return CPT_API_VERSION as the library was built.
+ */
+int cpt_api_version(void);
+
+/**
+ * Create a tracker for input at the given sample rate, analysed in
+ * blocks of the given size, stepping by the given step size. Return
+ * NULL if these are not supported. The block size must be a power
+ * of two.
+ */
+cpt_tracker *cpt_create(float sampleRate, int blockSize, int stepSize);
+
+/**
+ * Destroy a tracker. NULL is ignored.
+ */
+void cpt_destroy(cpt_tracker *tracker);
+
+/**
+ * Set a parameter, by its plugin identifier ("bandlimit", "skip",
+ * "narrow", "refine" or "dual"). This resets the tracker, discarding
+ * any input and results. Return 0, or -1 for an unknown identifier.
+ */
+int cpt_set_parameter(cpt_tracker *tracker, const char *identifier,
+                      float value);
+
+/**
+ * Discard any input and results, ready for a new input starting
+ * from time zero.
+ */
+void cpt_reset(cpt_tracker *tracker);
+
+/**
+ * Process nframes consecutive frames, given as nframes * (blockSize
+ * + 2) floats: for each frame, the real and imaginary parts of bins
+ * 0 to blockSize / 2 of its windowed spectrum, as a Vamp host would
+ * pass them to the plugin. The frames continue on from those of any
+ * earlier calls since the tracker was created or reset, and the
+ * n'th frame is timestamped at sample n * stepSize + blockSize / 2.
+ * Return the number of frames processed.
+ */
+int cpt_process_batch(cpt_tracker *tracker, const float *spectra,
+                      int nframes);
+
+/**
+ * End the input, making the results of any note still in progress
+ * available. Call cpt_reset() before processing any further input.
+ */
+void cpt_finish(cpt_tracker *tracker);
+
+/**
+ * Reset the tracker and analyse the n mono samples given as a
+ * complete input, then finish it. Frame i covers samples i *
+ * stepSize onwards, with zeros past the end of the input, and there
+ * is a frame starting at every step through the input. Return the
+ * number of frames processed.
+ */
+int cpt_analyse(cpt_tracker *tracker, const float *samples, long n);
+
+/**
+ * Return the number of f0 estimates or notes waiting to be drained.
+ */
+int cpt_pending_pitches(const cpt_tracker *tracker);
+int cpt_pending_notes(const cpt_tracker *tracker);
+
+/**
+ * Copy up to capacity waiting f0 estimates into the given array, in
+ * time order, and return how many were copied. Any that do not fit
+ * stay waiting for the next call. The estimates of each note become
+ * available together with the note.
+ */
+int cpt_drain_pitches(cpt_tracker *tracker, cpt_pitch *out, int capacity);
+
+/**
+ * Copy up to capacity waiting notes into the given array, in time
+ * order, and return how many were copied. Any that do not fit stay
+ * waiting for the next call.
+ */
+int cpt_drain_notes(cpt_tracker *tracker, cpt_note *out, int capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,188 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+  Query a note index, as written by cepstral-pitchtrack --index,
+  through a memory mapping. See NoteIndex.h for the index format.
+
+  Usage:
+    cepstral-pitchquery <index> --list
+    cepstral-pitchquery <index> [--file <name>] [--from <t>] [--to <t>]
+    cepstral-pitchquery <index> [--file <name>] [--from <t>] [--to <t>]
+                        --near <hz> [--cents <c>]
+
+  Options:
+    --list              list the indexed files and their note counts
+    --file <name>       only the notes of the given file, named as
+                        when the index was written
+    --from <t>          notes ending at or after time t (default 0)
+    --to <t>            notes starting at or before time t (default
+                        the end)
+    --near <hz>         notes within some cents of the given pitch
+    --cents <c>         the distance for --near (default 50)
+
+  Times may be given in seconds or as [[hh:]mm:]ss, with a fraction
+  of a second if wanted. Notes are written one per line, with times
+  in seconds:
+    <file>,<time>,<duration>,<hz>
+  in order of start time within each file for a time range, and in
+  order of frequency for --near. --list writes lines of
+    <file>,<notes>
+*/
+
+#include "NoteIndex.h"
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+
+using std::string;
+using std::vector;
+using std::cerr;
+using std::endl;
+
+static void
+usage(const char *name)
+{
+    cerr << "Usage: " << name << " <index> --list" << endl;
+    cerr << "       " << name << " <index> [--file <name>]"
+         << " [--from <time>] [--to <time>]" << endl;
+    cerr << "       " << name << " <index> [--file <name>]"
+         << " [--from <time>] [--to <time>] --near <hz> [--cents <c>]" << endl;
+    exit(2);
+}
+
+// Parse seconds or [[hh:]mm:]ss[.fff], returning false if invalid
+static bool
+parseTime(string s, double &t)
+{
+    t = 0.0;
+    string::size_type from = 0;
+    for (int part = 0; part < 3; ++part) {
+        string::size_type colon = s.find(':', from);
+        string field = s.substr(from, colon == string::npos ?
+                                string::npos : colon - from);
+        char *end = 0;
+        double v = strtod(field.c_str(), &end);
+        if (field == "" || *end || v < 0.0) return false;
+        t = t * 60.0 + v;
+        if (colon == string::npos) return true;
+        from = colon + 1;
+    }
+    return false;
+}
+
+static void
+printNote(const NoteIndex &index, long n)
+{
+    const NoteIndex::NoteRecord &r = index.getNote(n);
+    printf("%s,%.6f,%.6f,%.6f\n", index.getFileName(r.file).c_str(),
+           r.start, r.end - r.start, r.frequency);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) usage(argv[0]);
+
+    string path = argv[1];
+    string file;
+    bool list = false;
+    double from = 0.0, to = DBL_MAX;
+    double near = 0.0, cents = 50.0;
+
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        bool more = (i + 1 < argc);
+        if (arg == "--list") {
+            list = true;
+        } else if (arg == "--file" && more) {
+            file = argv[++i];
+        } else if (arg == "--from" && more) {
+            if (!parseTime(argv[++i], from)) usage(argv[0]);
+        } else if (arg == "--to" && more) {
+            if (!parseTime(argv[++i], to)) usage(argv[0]);
+        } else if (arg == "--near" && more) {
+            near = atof(argv[++i]);
+            if (near <= 0.0) usage(argv[0]);
+        } else if (arg == "--cents" && more) {
+            cents = atof(argv[++i]);
+            if (cents < 0.0) usage(argv[0]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    NoteIndex index;
+    if (!index.open(path)) {
+        cerr << index.getError() << endl;
+        return 1;
+    }
+
+    if (list) {
+        for (int f = 0; f < index.getFileCount(); ++f) {
+            printf("%s,%lu\n", index.getFileName(f).c_str(),
+                   (unsigned long)index.getFile(f).noteCount);
+        }
+        return 0;
+    }
+
+    int only = -1;
+    if (file != "") {
+        only = index.findFile(file);
+        if (only < 0) {
+            cerr << file << " is not in the index" << endl;
+            return 1;
+        }
+    }
+
+    vector<long> notes;
+
+    if (near > 0.0) {
+        if (!index.findNear(near, cents, notes)) {
+            cerr << path << " has no pitch index" << endl;
+            return 1;
+        }
+        for (int i = 0; i < (int)notes.size(); ++i) {
+            const NoteIndex::NoteRecord &r = index.getNote(notes[i]);
+            if (only >= 0 && int(r.file) != only) continue;
+            if (r.end < from || r.start > to) continue;
+            printNote(index, notes[i]);
+        }
+    } else {
+        for (int f = 0; f < index.getFileCount(); ++f) {
+            if (only >= 0 && f != only) continue;
+            notes.clear();
+            index.findOverlapping(f, from, to, notes);
+            for (int i = 0; i < (int)notes.size(); ++i) {
+                printNote(index, notes[i]);
+            }
+        }
+    }
+
+    return 0;
+}
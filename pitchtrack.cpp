@@ -0,0 +1,405 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+  Standalone command-line runner for the tracker, for batch jobs that
+  would otherwise need a Vamp host.
+
+  Maps the input file, converts it to mono, and runs it through an
+  OfflineAnalyser on all CPU cores, writing the f0 and notes outputs
+  in CSV, binary or columnar form.
+
+  Usage:
+    cepstral-pitchtrack [options] <input>
+    cepstral-pitchtrack [options] --manifest <file> -o <prefix>
+
+  With --manifest, every file listed in the manifest (one path per
+  line) is analysed, on one thread per core, and the results are
+  written to <prefix>.<n>.csv, one file per thread. See CorpusRunner.h
+  for the format of those.
+
+  Options:
+    -o <file>           write to the given file (default standard output)
+    --index <file>      also write a note index of the results, for
+                        cepstral-pitchquery (see NoteIndex.h)
+    --progress <s>      with --manifest, report progress every s seconds
+                        (default 5, or 0 for none)
+    --format <f>        csv (default), binary, columnar or columnar-cents
+    --raw <rate>        input is raw 32-bit float samples at the given
+                        rate, rather than a WAVE file
+    --raw-channels <n>  channel count of raw input (default 1)
+    --channel <n>       track only channel n, counting from 0, rather
+                        than a mixdown of all channels
+    --block <n>         block size, a power of two (default 1024)
+    --step <n>          step size (default 256)
+    --threads <n>       thread count (default one per CPU core)
+    --param <id>=<v>    set a plugin parameter (repeatable)
+    --rule <id>=<v>     set a note tracking rule (repeatable): one of
+                        last-tolerance and mean-tolerance (cents),
+                        max-gap (ms) or required-confidence; see
+                        NoteHypothesis::Rules
+    --cache <dir>       keep the per-frame estimates in the given
+                        directory, keyed by the audio and the analysis
+                        settings, and reuse them when present
+    --track-only        with --cache, only run the note tracking over
+                        cached estimates, failing if there are none
+
+  The estimate cache makes it cheap to run the note tracking again
+  with other rules. It cannot be used with the skip or narrow
+  parameters, which make the estimates depend on the tracking, or
+  with --manifest.
+
+  CSV output has one line per f0 feature and one per note, in that
+  order, with times in seconds:
+    f0,<time>,<hz>
+    note,<time>,<duration>,<hz>
+
+  Binary output, in the machine's byte order, is:
+    char[4]   "CPT1"
+    uint32    f0 feature count F
+    uint32    note count N
+    F x { float64 time, float64 hz }
+    N x { float64 time, float64 duration, float64 hz }
+
+  Columnar output is a track file, as described in TrackFile.h, with
+  f0 in Hz or (for columnar-cents) in quarter-cents. It also holds the
+  confidence of each f0 estimate, and may be read through a memory
+  mapping with no parsing.
+*/
+
+#include "AudioFile.h"
+#include "AudioFileSource.h"
+#include "CorpusRunner.h"
+#include "EstimateCache.h"
+#include "NoteIndex.h"
+#include "OfflineAnalyser.h"
+#include "Seconds.h"
+#include "TrackFile.h"
+
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+using Vamp::RealTime;
+using std::string;
+using std::vector;
+using std::cerr;
+using std::endl;
+
+typedef Vamp::Plugin::FeatureList FeatureList;
+
+static void
+writeCsv(FILE *out, const FeatureList &f0, const FeatureList &notes)
+{
+    for (int i = 0; i < (int)f0.size(); ++i) {
+        fprintf(out, "f0,%.6f,%.6f\n",
+                toSeconds(f0[i].timestamp), f0[i].values[0]);
+    }
+    for (int i = 0; i < (int)notes.size(); ++i) {
+        fprintf(out, "note,%.6f,%.6f,%.6f\n",
+                toSeconds(notes[i].timestamp), toSeconds(notes[i].duration),
+                notes[i].values[0]);
+    }
+}
+
+static void
+writeBinary(FILE *out, const FeatureList &f0, const FeatureList &notes)
+{
+    uint32_t counts[2] = { uint32_t(f0.size()), uint32_t(notes.size()) };
+    fwrite("CPT1", 1, 4, out);
+    fwrite(counts, sizeof(counts[0]), 2, out);
+    for (int i = 0; i < (int)f0.size(); ++i) {
+        double r[2] = { toSeconds(f0[i].timestamp), f0[i].values[0] };
+        fwrite(r, sizeof(r[0]), 2, out);
+    }
+    for (int i = 0; i < (int)notes.size(); ++i) {
+        double r[3] = { toSeconds(notes[i].timestamp),
+                        toSeconds(notes[i].duration), notes[i].values[0] };
+        fwrite(r, sizeof(r[0]), 3, out);
+    }
+}
+
+static bool
+setRule(string r, NoteHypothesis::Rules &rules)
+{
+    string::size_type eq = r.find('=');
+    if (eq == string::npos) return false;
+    return rules.set(r.substr(0, eq), atof(r.substr(eq + 1).c_str()));
+}
+
+static void
+usage(const char *name)
+{
+    cerr << "Usage: " << name << " [-o <file>]"
+         << " [--format csv|binary|columnar|columnar-cents]"
+         << " [--raw <rate>] [--raw-channels <n>] [--channel <n>]"
+         << " [--block <n>] [--step <n>] [--threads <n>]"
+         << " [--param <id>=<value>]... [--rule <id>=<value>]..."
+         << " [--index <file>] [--cache <dir> [--track-only]] <input>" << endl;
+    cerr << "       " << name << " [options] --manifest <file> -o <prefix>"
+         << " [--progress <s>]" << endl;
+    exit(2);
+}
+
+static int
+runCorpus(string manifest, string prefix, string index, float rawRate,
+          int rawChannels, int channel, int block, int step, int threads,
+          double progress, const vector<std::pair<string, float> > &params,
+          const NoteHypothesis::Rules &rules)
+{
+    vector<string> paths;
+    if (!CorpusRunner::readManifest(manifest, paths)) {
+        cerr << "Failed to read manifest " << manifest << endl;
+        return 1;
+    }
+
+    CorpusRunner runner(threads);
+    runner.setBlockSize(block);
+    runner.setStepSize(step);
+    runner.setChannel(channel);
+    runner.setProgressInterval(progress);
+    runner.setIndexPath(index);
+    if (rawRate > 0.f) {
+        runner.setRawInput(rawRate, rawChannels);
+    }
+    for (int i = 0; i < (int)params.size(); ++i) {
+        runner.setParameter(params[i].first, params[i].second);
+    }
+    runner.setNoteRules(rules);
+
+    if (!runner.run(paths, prefix)) {
+        return 1;
+    }
+
+    return runner.getProgress().failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    string input, output, manifest, index, cache;
+    bool trackOnly = false;
+    enum { Csv, Binary, Columnar, ColumnarCents } format = Csv;
+    double progress = 5.0;
+    float rawRate = 0.f;
+    int rawChannels = 1;
+    int channel = -1;
+    int block = 1024;
+    int step = 256;
+    int threads = 0;
+    vector<std::pair<string, float> > params;
+    NoteHypothesis::Rules rules;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool more = (i + 1 < argc);
+        if (arg == "-o" && more) {
+            output = argv[++i];
+        } else if (arg == "--format" && more) {
+            string f = argv[++i];
+            if (f == "binary") format = Binary;
+            else if (f == "columnar") format = Columnar;
+            else if (f == "columnar-cents") format = ColumnarCents;
+            else if (f != "csv") usage(argv[0]);
+        } else if (arg == "--raw" && more) {
+            rawRate = atof(argv[++i]);
+            if (rawRate <= 0.f) usage(argv[0]);
+        } else if (arg == "--raw-channels" && more) {
+            rawChannels = atoi(argv[++i]);
+        } else if (arg == "--channel" && more) {
+            channel = atoi(argv[++i]);
+        } else if (arg == "--block" && more) {
+            block = atoi(argv[++i]);
+        } else if (arg == "--step" && more) {
+            step = atoi(argv[++i]);
+        } else if (arg == "--threads" && more) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "--manifest" && more) {
+            manifest = argv[++i];
+        } else if (arg == "--index" && more) {
+            index = argv[++i];
+        } else if (arg == "--progress" && more) {
+            progress = atof(argv[++i]);
+        } else if (arg == "--param" && more) {
+            string p = argv[++i];
+            string::size_type eq = p.find('=');
+            if (eq == string::npos) usage(argv[0]);
+            params.push_back(std::make_pair
+                             (p.substr(0, eq), float(atof(p.substr(eq + 1).c_str()))));
+        } else if (arg == "--rule" && more) {
+            if (!setRule(argv[++i], rules)) usage(argv[0]);
+        } else if (arg == "--cache" && more) {
+            cache = argv[++i];
+        } else if (arg == "--track-only") {
+            trackOnly = true;
+        } else if (arg != "" && arg[0] != '-' && input == "") {
+            input = arg;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (block < 2 || (block & (block - 1)) || step < 1) usage(argv[0]);
+    if (trackOnly && cache == "") usage(argv[0]);
+
+    if (manifest != "") {
+        if (input != "" || output == "" || format != Csv || cache != "") {
+            usage(argv[0]);
+        }
+        return runCorpus(manifest, output, index, rawRate, rawChannels,
+                         channel, block, step, threads, progress, params,
+                         rules);
+    }
+
+    if (input == "") usage(argv[0]);
+
+    AudioFile file;
+    bool opened = (rawRate > 0.f ?
+                   file.openRaw(input, rawRate, rawChannels) :
+                   file.open(input));
+    if (!opened) {
+        cerr << file.getError() << endl;
+        return 1;
+    }
+
+    if (channel >= file.getChannelCount()) {
+        cerr << input << " has only " << file.getChannelCount()
+             << " channel(s)" << endl;
+        return 1;
+    }
+
+    AudioFileSource source(file, channel);
+
+    OfflineAnalyser analyser(file.getSampleRate(), step, block, threads);
+    std::map<string, float> paramMap;
+    for (int i = 0; i < (int)params.size(); ++i) {
+        analyser.setParameter(params[i].first, params[i].second);
+        paramMap[params[i].first] = params[i].second;
+    }
+    analyser.setNoteRules(rules);
+
+    // With a cache, the estimates come from it when they can, and
+    // only the tracking is run on them
+    OfflineAnalyser::Frames frames;
+    if (cache != "") {
+        if (!analyser.hasIndependentEstimates()) {
+            cerr << "The estimate cache cannot be used with the skip or"
+                 << " narrow parameters" << endl;
+            return 1;
+        }
+        EstimateCache::Key key = EstimateCache::makeKey
+            (source, file.getSampleRate(), step, block, paramMap);
+        string entry = cache + "/" + EstimateCache::getFileName(key);
+        if (!EstimateCache::read(entry, key, frames)) {
+            if (trackOnly) {
+                cerr << "No cached estimates for " << input << " in "
+                     << cache << endl;
+                return 1;
+            }
+            if (!analyser.estimate(source, frames)) {
+                cerr << "Failed to initialise tracker with block size "
+                     << block << ", step size " << step
+                     << " and sample rate " << file.getSampleRate() << endl;
+                return 1;
+            }
+            if (!EstimateCache::write(entry, key, file.getSampleRate(),
+                                      step, block, frames)) {
+                cerr << "Failed to write estimate cache entry " << entry
+                     << endl;
+                return 1;
+            }
+        }
+    }
+
+    // The track file needs the confidences, which the features lack
+    bool columnar = (format == Columnar || format == ColumnarCents);
+    OfflineAnalyser::FeatureSet features;
+    NoteHypothesis::Estimates pitches;
+    OfflineAnalyser::Notes notes;
+    if (cache != "") {
+        if (columnar) analyser.track(frames, pitches, notes);
+        else features = analyser.track(frames);
+    } else if (!(columnar ?
+                 analyser.analyse(source, pitches, notes) :
+                 analyser.analyse(source, features))) {
+        cerr << "Failed to initialise tracker with block size " << block
+             << ", step size " << step << " and sample rate "
+             << file.getSampleRate() << endl;
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (output != "") {
+        out = fopen(output.c_str(), format == Csv ? "w" : "wb");
+        if (!out) {
+            cerr << "Failed to open output file " << output << endl;
+            return 1;
+        }
+    }
+
+    bool written = true;
+
+    if (columnar) {
+        written = TrackFile::write
+            (out, file.getSampleRate(), step, block,
+             format == Columnar ? TrackFile::Float : TrackFile::Cents,
+             pitches, notes);
+    } else if (format == Binary) {
+        writeBinary(out, features[0], features[1]);
+    } else {
+        writeCsv(out, features[0], features[1]);
+    }
+
+    if (!written || fflush(out) != 0 || (out != stdout && fclose(out) != 0)) {
+        cerr << "Failed to write output" << endl;
+        return 1;
+    }
+
+    if (index != "") {
+        vector<NoteIndex::Notes> indexed(1);
+        if (columnar) {
+            indexed[0] = notes;
+        } else {
+            for (int i = 0; i < (int)features[1].size(); ++i) {
+                const Vamp::Plugin::Feature &f = features[1][i];
+                indexed[0].push_back(NoteHypothesis::Note
+                                     (f.values[0], f.timestamp, f.duration));
+            }
+        }
+        FILE *ix = fopen(index.c_str(), "wb");
+        bool ok = ix && NoteIndex::write(ix, vector<string>(1, input),
+                                         indexed, true);
+        if (ix && fclose(ix) != 0) ok = false;
+        if (!ok) {
+            cerr << "Failed to write note index " << index << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
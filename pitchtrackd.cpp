@@ -0,0 +1,143 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+  Daemon serving pitch tracking over a Unix domain socket, so that
+  many short requests can share trackers that are already set up
+  rather than each starting a process. See PitchServer.h for the
+  protocol.
+
+  Usage:
+    cepstral-pitchtrackd [options] --socket <path>
+
+  Options:
+    --socket <path>     socket to listen on (required)
+    --concurrency <n>   streams served at once (default 4)
+    --rate <hz>         sample rate of the pooled trackers (default 44100)
+    --block <n>         block size of the pooled trackers (default 1024)
+    --step <n>          step size of the pooled trackers (default 256)
+    --param <id>=<v>    set a plugin parameter (repeatable)
+    --rule <id>=<v>     set a note tracking rule (repeatable), as for
+                        cepstral-pitchtrack
+
+  Runs until interrupted or terminated, then closes the open
+  connections and removes the socket.
+*/
+
+#include "PitchServer.h"
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <csignal>
+#include <pthread.h>
+#include <cstdlib>
+
+using std::string;
+using std::cerr;
+using std::endl;
+
+static void
+usage(const char *name)
+{
+    cerr << "Usage: " << name << " --socket <path> [--concurrency <n>]"
+         << " [--rate <hz>] [--block <n>] [--step <n>]"
+         << " [--param <id>=<value>]... [--rule <id>=<value>]..." << endl;
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    string path;
+    int concurrency = 4;
+    float rate = 44100.f;
+    int block = 1024;
+    int step = 256;
+
+    // Block the signals we stop on before starting any threads, so
+    // that only sigwait() below sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, 0);
+
+    std::vector<std::pair<string, float> > params;
+    NoteHypothesis::Rules rules;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool more = (i + 1 < argc);
+        if (arg == "--socket" && more) {
+            path = argv[++i];
+        } else if (arg == "--concurrency" && more) {
+            concurrency = atoi(argv[++i]);
+        } else if (arg == "--rate" && more) {
+            rate = atof(argv[++i]);
+        } else if (arg == "--block" && more) {
+            block = atoi(argv[++i]);
+        } else if (arg == "--step" && more) {
+            step = atoi(argv[++i]);
+        } else if (arg == "--param" && more) {
+            string p = argv[++i];
+            string::size_type eq = p.find('=');
+            if (eq == string::npos) usage(argv[0]);
+            params.push_back(std::make_pair
+                             (p.substr(0, eq), float(atof(p.substr(eq + 1).c_str()))));
+        } else if (arg == "--rule" && more) {
+            string r = argv[++i];
+            string::size_type eq = r.find('=');
+            if (eq == string::npos ||
+                !rules.set(r.substr(0, eq), atof(r.substr(eq + 1).c_str()))) {
+                usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (path == "" || concurrency < 1 || !(rate > 0.f) ||
+        block < 2 || (block & (block - 1)) || step < 1) {
+        usage(argv[0]);
+    }
+
+    PitchServer server(path, concurrency);
+    server.setPooledFormat(rate, block, step);
+    for (int i = 0; i < (int)params.size(); ++i) {
+        server.setParameter(params[i].first, params[i].second);
+    }
+    server.setNoteRules(rules);
+
+    if (!server.start()) {
+        cerr << server.getError() << endl;
+        return 1;
+    }
+
+    int sig = 0;
+    sigwait(&signals, &sig);
+
+    server.stop();
+    return 0;
+}
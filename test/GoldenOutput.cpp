@@ -0,0 +1,444 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+  Golden-output regression check for the whole tracker.
+
+  Runs the plugin over a fixed set of synthetic inputs (and optionally
+  some recorded ones) and compares its f0 and notes outputs against
+  those stored in test/golden by a reference build. Frequencies are
+  compared within a tolerance in cents; timestamps, durations and
+  feature counts must match exactly.
+
+  Usage:
+    golden-output [options]              check against test/golden
+    golden-output --write [options]      rewrite the golden files
+    golden-output --compare <a> <b>      compare two golden files
+
+  Options:
+    --dir <dir>         directory of golden files (default test/golden)
+    --cents <c>         frequency tolerance in cents (default 0.5)
+    --channels <n>      run with the same input on n channels, checking
+                        every channel against the golden file
+    --param <id>=<v>    set a plugin parameter before running (repeatable)
+    --raw <file>        also run a recorded input, given as raw 32-bit
+                        float mono samples at 44.1kHz (repeatable)
+
+  To compare an optimised build against a reference build without
+  touching the committed files, --write the output of each into a
+  scratch directory and --compare the results.
+
+  Golden file format: a comment line, then one line per run of f0
+  features on consecutive frames:
+    f <first frame> <hz> <hz> ...
+  and one line per note:
+    n <start frame> <duration in frames> <hz>
+  where frame i has timestamp (i * step + block/2) / rate.
+*/
+
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "bench/SignalGenerator.h"
+
+#include <vector>
+#include <map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using Vamp::RealTime;
+using std::string;
+using std::vector;
+using std::cerr;
+using std::endl;
+
+struct Input {
+    string name;
+    SignalGenerator::Kind kind;
+    string rawFile;
+    float rate;
+    int block;
+    int step;
+    double seconds;
+};
+
+static const Input synthetic[] = {
+    { "sine", SignalGenerator::Sine, "", 44100, 1024, 256, 5 },
+    { "vibrato", SignalGenerator::Vibrato, "", 44100, 1024, 256, 10 },
+    { "notes", SignalGenerator::Notes, "", 44100, 1024, 256, 10 },
+    { "silence", SignalGenerator::Silence, "", 44100, 1024, 256, 2 },
+    { "noise", SignalGenerator::Noise, "", 44100, 1024, 256, 5 },
+    { "notes-22050", SignalGenerator::Notes, "", 22050, 512, 128, 10 },
+    { "notes-48000", SignalGenerator::Notes, "", 48000, 2048, 512, 10 },
+    { "notes-96000", SignalGenerator::Notes, "", 96000, 2048, 512, 10 },
+};
+
+struct Note {
+    int start;
+    int duration;
+    double freq;
+};
+
+struct Output {
+    std::map<int, double> f0; // frame -> Hz
+    vector<Note> notes;
+};
+
+static bool
+readSamples(const Input &in, vector<float> &samples)
+{
+    if (in.rawFile == "") {
+        samples.resize(long(in.seconds * in.rate));
+        SignalGenerator gen(in.kind, in.rate);
+        gen.generate(&samples[0], samples.size());
+        return true;
+    }
+    std::ifstream f(in.rawFile.c_str(), std::ios::binary);
+    if (!f) {
+        cerr << "Failed to open raw input file " << in.rawFile << endl;
+        return false;
+    }
+    float v;
+    samples.clear();
+    while (f.read((char *)&v, sizeof(v))) samples.push_back(v);
+    return true;
+}
+
+static bool
+run(const Input &in, const std::map<string, float> &params, int channels,
+    vector<Output> &outs)
+{
+    vector<float> samples;
+    if (!readSamples(in, samples)) return false;
+
+    int frames = (samples.size() + in.step - 1) / in.step;
+    samples.resize(frames * in.step + in.block, 0.f);
+
+    CepstralPitchTracker tracker(in.rate);
+    for (std::map<string, float>::const_iterator i = params.begin();
+         i != params.end(); ++i) {
+        tracker.setParameter(i->first, i->second);
+    }
+    if (!tracker.initialise(channels, in.step, in.block)) {
+        cerr << "Failed to initialise tracker for input " << in.name << endl;
+        return false;
+    }
+
+    // Every channel gets the same input. The first channel's outputs
+    // are f0 and notes, and each later one's are a pair at the end
+    vector<int> outputOf(channels, 0);
+    int nOutputs = tracker.getOutputDescriptors().size();
+    for (int c = 1; c < channels; ++c) {
+        outputOf[c] = nOutputs - 2 * (channels - c);
+    }
+
+    Stft stft(in.block);
+    vector<float> spectrum(in.block + 2);
+    vector<const float *> sp(channels, &spectrum[0]);
+
+    std::map<RealTime, int> frameOf;
+    vector<Vamp::Plugin::FeatureSet> results;
+
+    for (int i = 0; i < frames; ++i) {
+        RealTime t = RealTime::frame2RealTime
+            (long(i) * in.step + in.block/2, (unsigned int)in.rate);
+        frameOf[t] = i;
+        stft.process(&samples[long(i) * in.step], &spectrum[0]);
+        results.push_back(tracker.process(&sp[0], t));
+    }
+    results.push_back(tracker.getRemainingFeatures());
+
+    outs = vector<Output>(channels);
+
+    for (int i = 0; i < (int)results.size(); ++i) {
+        for (int c = 0; c < channels; ++c) {
+
+            Output &out = outs[c];
+
+            Vamp::Plugin::FeatureList &f0 = results[i][outputOf[c]];
+            for (int j = 0; j < (int)f0.size(); ++j) {
+                if (frameOf.find(f0[j].timestamp) == frameOf.end()) {
+                    cerr << in.name << ": f0 timestamp " << f0[j].timestamp
+                         << " is not on a frame boundary" << endl;
+                    return false;
+                }
+                out.f0[frameOf[f0[j].timestamp]] = f0[j].values[0];
+            }
+
+            Vamp::Plugin::FeatureList &notes = results[i][outputOf[c] + 1];
+            for (int j = 0; j < (int)notes.size(); ++j) {
+                RealTime end = notes[j].timestamp + notes[j].duration;
+                if (frameOf.find(notes[j].timestamp) == frameOf.end() ||
+                    frameOf.find(end) == frameOf.end()) {
+                    cerr << in.name << ": note at " << notes[j].timestamp
+                         << " is not on frame boundaries" << endl;
+                    return false;
+                }
+                Note n;
+                n.start = frameOf[notes[j].timestamp];
+                n.duration = frameOf[end] - n.start;
+                n.freq = notes[j].values[0];
+                out.notes.push_back(n);
+            }
+        }
+    }
+
+    return true;
+}
+
+static void
+write(std::ostream &s, const Input &in, const Output &out)
+{
+    s << "# " << in.name << " rate " << in.rate << " block " << in.block
+      << " step " << in.step << endl;
+
+    char buf[30];
+    int prev = -2;
+    for (std::map<int, double>::const_iterator i = out.f0.begin();
+         i != out.f0.end(); ++i) {
+        if (i->first != prev + 1) {
+            if (prev >= 0) s << endl;
+            s << "f " << i->first;
+        }
+        sprintf(buf, " %.4f", i->second);
+        s << buf;
+        prev = i->first;
+    }
+    if (prev >= 0) s << endl;
+
+    for (int i = 0; i < (int)out.notes.size(); ++i) {
+        sprintf(buf, "%.4f", out.notes[i].freq);
+        s << "n " << out.notes[i].start << " " << out.notes[i].duration
+          << " " << buf << endl;
+    }
+}
+
+static bool
+read(string path, Output &out)
+{
+    std::ifstream f(path.c_str());
+    if (!f) {
+        cerr << "Failed to open golden file " << path << endl;
+        return false;
+    }
+    string line;
+    while (std::getline(f, line)) {
+        if (line == "" || line[0] == '#') continue;
+        std::istringstream ls(line);
+        string type;
+        ls >> type;
+        if (type == "f") {
+            int frame;
+            double hz;
+            ls >> frame;
+            while (ls >> hz) out.f0[frame++] = hz;
+        } else if (type == "n") {
+            Note n;
+            ls >> n.start >> n.duration >> n.freq;
+            out.notes.push_back(n);
+        } else {
+            cerr << "Unexpected line in golden file " << path << ": "
+                 << line << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static double
+centsBetween(double a, double b)
+{
+    if (a <= 0.0 || b <= 0.0) return (a == b) ? 0.0 : 1e9;
+    return fabs(1200.0 * log(a / b) / log(2.0));
+}
+
+/// Compare outputs, printing differences; return the number found
+static int
+compare(string name, const Output &ref, const Output &test, double tolerance)
+{
+    int diffs = 0;
+    int reported = 0;
+    double worst = 0.0;
+
+    if (ref.f0.size() != test.f0.size()) {
+        cerr << name << ": f0 count " << test.f0.size()
+             << " differs from reference " << ref.f0.size() << endl;
+        ++diffs;
+    }
+    for (std::map<int, double>::const_iterator i = ref.f0.begin();
+         i != ref.f0.end(); ++i) {
+        std::map<int, double>::const_iterator j = test.f0.find(i->first);
+        if (j == test.f0.end()) {
+            if (reported++ < 10) {
+                cerr << name << ": reference f0 at frame " << i->first
+                     << " is missing" << endl;
+            }
+            ++diffs;
+            continue;
+        }
+        double c = centsBetween(i->second, j->second);
+        if (c > worst) worst = c;
+        if (c > tolerance) {
+            if (reported++ < 10) {
+                cerr << name << ": f0 at frame " << i->first << " is "
+                     << j->second << "Hz, reference " << i->second
+                     << "Hz (" << c << " cents)" << endl;
+            }
+            ++diffs;
+        }
+    }
+
+    if (ref.notes.size() != test.notes.size()) {
+        cerr << name << ": note count " << test.notes.size()
+             << " differs from reference " << ref.notes.size() << endl;
+        ++diffs;
+    }
+    for (int i = 0; i < (int)ref.notes.size() &&
+             i < (int)test.notes.size(); ++i) {
+        const Note &r = ref.notes[i];
+        const Note &t = test.notes[i];
+        double c = centsBetween(r.freq, t.freq);
+        if (c > worst) worst = c;
+        if (r.start != t.start || r.duration != t.duration || c > tolerance) {
+            if (reported++ < 10) {
+                cerr << name << ": note " << i << " is " << t.start << "+"
+                     << t.duration << " at " << t.freq << "Hz, reference "
+                     << r.start << "+" << r.duration << " at " << r.freq
+                     << "Hz" << endl;
+            }
+            ++diffs;
+        }
+    }
+
+    cerr << name << ": " << test.f0.size() << " f0, " << test.notes.size()
+         << " notes, worst deviation " << worst << " cents, "
+         << diffs << " difference(s)" << endl;
+
+    return diffs;
+}
+
+static void
+usage(const char *name)
+{
+    cerr << "Usage: " << name << " [--write] [--dir <dir>] [--cents <c>]"
+         << " [--channels <n>] [--param <id>=<value>]... [--raw <file>]..."
+         << endl;
+    cerr << "       " << name << " --compare <golden-a> <golden-b> [--cents <c>]"
+         << endl;
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    string dir = "test/golden";
+    double tolerance = 0.5;
+    bool writing = false;
+    int channels = 1;
+    string compareA, compareB;
+    std::map<string, float> params;
+    vector<Input> inputs(synthetic,
+                         synthetic + sizeof(synthetic) / sizeof(synthetic[0]));
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--write") {
+            writing = true;
+        } else if (arg == "--dir" && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (arg == "--cents" && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (arg == "--channels" && i + 1 < argc) {
+            channels = atoi(argv[++i]);
+            if (channels < 1) usage(argv[0]);
+        } else if (arg == "--param" && i + 1 < argc) {
+            string p = argv[++i];
+            string::size_type eq = p.find('=');
+            if (eq == string::npos) usage(argv[0]);
+            params[p.substr(0, eq)] = atof(p.substr(eq + 1).c_str());
+        } else if (arg == "--raw" && i + 1 < argc) {
+            Input in;
+            in.rawFile = argv[++i];
+            in.name = in.rawFile.substr(in.rawFile.find_last_of('/') + 1);
+            in.kind = SignalGenerator::Silence;
+            in.rate = 44100;
+            in.block = 1024;
+            in.step = 256;
+            in.seconds = 0;
+            inputs.push_back(in);
+        } else if (arg == "--compare" && i + 2 < argc) {
+            compareA = argv[++i];
+            compareB = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (compareA != "") {
+        Output a, b;
+        if (!read(compareA, a) || !read(compareB, b)) return 2;
+        return compare(compareB, a, b, tolerance) ? 1 : 0;
+    }
+
+    int failures = 0;
+
+    for (int i = 0; i < (int)inputs.size(); ++i) {
+
+        const Input &in = inputs[i];
+        string path = dir + "/" + in.name + ".txt";
+
+        vector<Output> outs;
+        if (!run(in, params, channels, outs)) return 2;
+        const Output &out = outs[0];
+
+        if (writing) {
+            std::ofstream f(path.c_str());
+            if (!f) {
+                cerr << "Failed to open " << path << " for writing" << endl;
+                return 2;
+            }
+            write(f, in, out);
+            cerr << "Wrote " << path << endl;
+        } else {
+            Output ref;
+            if (!read(path, ref)) return 2;
+            for (int c = 0; c < channels; ++c) {
+                string name = in.name;
+                if (channels > 1) {
+                    std::ostringstream cs;
+                    cs << name << " (channel " << c + 1 << ")";
+                    name = cs.str();
+                }
+                if (compare(name, ref, outs[c], tolerance)) ++failures;
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -29,12 +29,18 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 static Vamp::RealTime ms(int n) { return Vamp::RealTime::fromMilliseconds(n); }
 
 static const int low = 500, high = 700;
 
 typedef NoteHypothesis::Estimate Est;
 
+static bool earlier(const Est &a, const Est &b) { return a.time < b.time; }
+
 BOOST_AUTO_TEST_SUITE(TestAgentFeeder)
 
 BOOST_AUTO_TEST_CASE(feederEmpty)
@@ -258,5 +264,66 @@ BOOST_AUTO_TEST_CASE(feederPairContaining)
     ++i;
 }
         
+// Records the calls made to it, as a string of 'n' (note on), 'e'
+// (estimate) and 'c' (note complete), along with what was passed
+class RecordingSink : public ResultSink
+{
+public:
+    std::string calls;
+    NoteHypothesis::Estimates estimates;
+    std::vector<NoteHypothesis::Note> notes;
+
+    void onNoteOn(const NoteHypothesis::Note &) {
+        calls += 'n';
+    }
+    void onEstimate(const NoteHypothesis::Estimate &e) {
+        calls += 'e';
+        estimates.push_back(e);
+    }
+    void onNoteComplete(const NoteHypothesis::Note &n) {
+        calls += 'c';
+        notes.push_back(n);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(feederSink)
+{
+    // The overlapping case from feederPairOverlappingLong, followed
+    // by an unsatisfied blip and a note that lasts until the end
+    NoteHypothesis::Estimates es;
+    int eTimes[] = { 0, 10, 20, 30 };
+    int fTimes[] = { 20, 30, 40, 50, 60, 70, 80 };
+    for (int i = 0; i < 4; ++i) es.push_back(Est(low, ms(eTimes[i]), 1));
+    for (int i = 0; i < 7; ++i) es.push_back(Est(high, ms(fTimes[i]), 1));
+    std::stable_sort(es.begin(), es.end(), earlier);
+    es.push_back(Est(low, ms(200), 1));
+    for (int i = 0; i < 5; ++i) es.push_back(Est(high, ms(400 + i * 10), 1));
+
+    AgentFeeder plain;
+    AgentFeeder sunk;
+    RecordingSink sink;
+    sunk.setSink(&sink);
+    for (int i = 0; i < (int)es.size(); ++i) {
+        plain.feed(es[i]);
+        sunk.feed(es[i]);
+    }
+    plain.finish();
+    sunk.finish();
+
+    BOOST_CHECK(sunk.getAcceptedHypotheses().empty());
+    BOOST_CHECK_EQUAL(sink.calls, "neeeecneeeeeeecneeeeec");
+
+    AgentFeeder::Hypotheses accepted = plain.getAcceptedHypotheses();
+    BOOST_REQUIRE_EQUAL(accepted.size(), size_t(3));
+    BOOST_REQUIRE_EQUAL(sink.notes.size(), accepted.size());
+
+    NoteHypothesis::Estimates expected;
+    for (int i = 0; i < (int)accepted.size(); ++i) {
+        BOOST_CHECK(sink.notes[i] == accepted[i].getAveragedNote());
+        NoteHypothesis::Estimates a = accepted[i].getAcceptedEstimates();
+        expected.insert(expected.end(), a.begin(), a.end());
+    }
+    BOOST_CHECK(sink.estimates == expected);
+}
+        
 BOOST_AUTO_TEST_SUITE_END()
-
@@ -0,0 +1,231 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "AudioFile.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+
+BOOST_AUTO_TEST_SUITE(TestAudioFile)
+
+typedef std::vector<unsigned char> Bytes;
+
+static void
+put(Bytes &b, unsigned int v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) {
+        b.push_back((v >> (8 * i)) & 0xff);
+    }
+}
+
+static void
+put(Bytes &b, const char *s)
+{
+    b.insert(b.end(), s, s + 4);
+}
+
+// A WAVE file of the given format with a junk chunk before the
+// format chunk, as some writers produce
+static Bytes
+wave(int format, int channels, int rate, int bits, const Bytes &data,
+     bool extensible = false)
+{
+    Bytes fmt;
+    put(fmt, extensible ? 0xfffe : format, 2);
+    put(fmt, channels, 2);
+    put(fmt, rate, 4);
+    put(fmt, rate * channels * bits / 8, 4);
+    put(fmt, channels * bits / 8, 2);
+    put(fmt, bits, 2);
+    if (extensible) {
+        put(fmt, 22, 2);
+        put(fmt, bits, 2);
+        put(fmt, 0, 4);
+        put(fmt, format, 2);
+        for (int i = 0; i < 14; ++i) fmt.push_back(0);
+    }
+
+    Bytes b;
+    put(b, "RIFF");
+    put(b, 4 + 8 + 3 + 1 + 8 + fmt.size() + 8 + data.size(), 4);
+    put(b, "WAVE");
+    put(b, "junk");
+    put(b, 3, 4);
+    put(b, 0, 3);
+    b.push_back(0); // pad byte for odd-length chunk
+    put(b, "fmt ");
+    put(b, fmt.size(), 4);
+    b.insert(b.end(), fmt.begin(), fmt.end());
+    put(b, "data");
+    put(b, data.size(), 4);
+    b.insert(b.end(), data.begin(), data.end());
+    return b;
+}
+
+struct TempFile {
+    TempFile(const Bytes &b) {
+        char name[] = "/tmp/testaudiofileXXXXXX";
+        int fd = mkstemp(name);
+        path = name;
+        if (fd >= 0) {
+            if (write(fd, &b[0], b.size()) != (ssize_t)b.size()) path = "";
+            close(fd);
+        }
+    }
+    ~TempFile() { unlink(path.c_str()); }
+    std::string path;
+};
+
+BOOST_AUTO_TEST_CASE(int16Stereo)
+{
+    Bytes data;
+    put(data, 16384, 2); put(data, 0xc000, 2); // 0.5, -0.5
+    put(data, 32767, 2); put(data, 32767, 2);
+    TempFile f(wave(1, 2, 22050, 16, data));
+
+    AudioFile af;
+    BOOST_REQUIRE(af.open(f.path));
+    BOOST_CHECK_EQUAL(af.getSampleRate(), 22050);
+    BOOST_CHECK_EQUAL(af.getChannelCount(), 2);
+    BOOST_CHECK_EQUAL(af.getFrameCount(), 2);
+    BOOST_CHECK(!af.getMonoFloatData());
+
+    float out[3];
+    af.readMono(0, 3, out);
+    BOOST_CHECK_EQUAL(out[0], 0.f);
+    BOOST_CHECK_CLOSE(out[1], 32767.f / 32768.f, 1e-4);
+    BOOST_CHECK_EQUAL(out[2], 0.f); // beyond the end
+
+    af.readMono(0, 1, out, 1);
+    BOOST_CHECK_EQUAL(out[0], -0.5f);
+}
+
+BOOST_AUTO_TEST_CASE(int24Extensible)
+{
+    Bytes data;
+    put(data, 0x400000, 3); // 0.5
+    put(data, 0xe00000, 3); // -0.25
+    TempFile f(wave(1, 1, 44100, 24, data, true));
+
+    AudioFile af;
+    BOOST_REQUIRE(af.open(f.path));
+    BOOST_CHECK_EQUAL(af.getFrameCount(), 2);
+    float out[2];
+    af.readMono(0, 2, out);
+    BOOST_CHECK_EQUAL(out[0], 0.5f);
+    BOOST_CHECK_EQUAL(out[1], -0.25f);
+}
+
+BOOST_AUTO_TEST_CASE(floatMono)
+{
+    float samples[] = { 0.25f, -1.f, 0.125f };
+    Bytes data((unsigned char *)samples, (unsigned char *)(samples + 3));
+    TempFile f(wave(3, 1, 48000, 32, data));
+
+    AudioFile af;
+    BOOST_REQUIRE(af.open(f.path));
+    BOOST_CHECK_EQUAL(af.getFrameCount(), 3);
+    const float *p = af.getMonoFloatData();
+    BOOST_REQUIRE(p);
+    for (int i = 0; i < 3; ++i) BOOST_CHECK_EQUAL(p[i], samples[i]);
+}
+
+BOOST_AUTO_TEST_CASE(trailingChunk)
+{
+    // A chunk after the data, as DAWs write for metadata, is not
+    // read as audio
+    Bytes data;
+    put(data, 16384, 2); put(data, 0xc000, 2);
+    Bytes b = wave(1, 1, 44100, 16, data);
+    put(b, "LIST");
+    put(b, 8, 4);
+    put(b, "INFO");
+    put(b, 0x7fff7fff, 4);
+    TempFile f(b);
+
+    AudioFile af;
+    BOOST_REQUIRE(af.open(f.path));
+    BOOST_CHECK_EQUAL(af.getFrameCount(), 2);
+    float out[3];
+    af.readMono(0, 3, out);
+    BOOST_CHECK_EQUAL(out[0], 0.5f);
+    BOOST_CHECK_EQUAL(out[1], -0.5f);
+    BOOST_CHECK_EQUAL(out[2], 0.f);
+
+    // A data chunk claiming more than the file holds is cut short
+    Bytes t = wave(1, 1, 44100, 16, data);
+    t[t.size() - 8] = 0xff;
+    t.pop_back();
+    TempFile g(t);
+    BOOST_REQUIRE(af.open(g.path));
+    BOOST_CHECK_EQUAL(af.getFrameCount(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(raw)
+{
+    float samples[] = { 0.1f, 0.2f, 0.3f, 0.4f, 0.5f };
+    Bytes data((unsigned char *)samples, (unsigned char *)(samples + 5));
+    TempFile f(data);
+
+    AudioFile af;
+    BOOST_REQUIRE(af.openRaw(f.path, 8000));
+    BOOST_CHECK_EQUAL(af.getSampleRate(), 8000);
+    BOOST_CHECK_EQUAL(af.getFrameCount(), 5);
+    BOOST_REQUIRE(af.getMonoFloatData());
+    BOOST_CHECK_EQUAL(af.getMonoFloatData()[4], 0.5f);
+
+    BOOST_REQUIRE(af.openRaw(f.path, 8000, 2));
+    BOOST_CHECK_EQUAL(af.getFrameCount(), 2);
+    BOOST_CHECK(!af.getMonoFloatData());
+    float out[2];
+    af.readMono(0, 2, out);
+    BOOST_CHECK_CLOSE(out[1], 0.35f, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+    AudioFile af;
+    BOOST_CHECK(!af.open("/nonexistent/file.wav"));
+    BOOST_CHECK(af.getError() != "");
+
+    Bytes notWave(64, 0);
+    TempFile f(notWave);
+    BOOST_CHECK(!af.open(f.path));
+
+    Bytes data(4, 0);
+    TempFile g(wave(1, 1, 44100, 8, data));
+    BOOST_CHECK(!af.open(g.path));
+    BOOST_CHECK_EQUAL(af.getFrameCount(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,223 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cpt.h"
+#include "OfflineAnalyser.h"
+#include "Stft.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using Vamp::RealTime;
+
+BOOST_AUTO_TEST_SUITE(TestCApi)
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+
+static const float rate = 44100;
+static const int block = 1024;
+static const int step = 256;
+static const int fdsize = block + 2;
+static const int frames = 4 * rate / step;
+
+static std::vector<float>
+spectra(SignalGenerator::Kind kind)
+{
+    std::vector<float> signal(frames * step + block, 0.f);
+    SignalGenerator gen(kind, rate);
+    gen.generate(&signal[0], frames * step);
+    std::vector<float> out(frames * fdsize);
+    Stft stft(block);
+    for (int i = 0; i < frames; ++i) {
+        stft.process(&signal[i * step], &out[i * fdsize]);
+    }
+    return out;
+}
+
+static FeatureSet
+runPlugin(const std::vector<float> &sp)
+{
+    CepstralPitchTracker tracker(rate);
+    tracker.setParameter("skip", 2);
+    tracker.initialise(1, step, block);
+    FeatureSet all;
+    for (int i = 0; i <= frames; ++i) {
+        FeatureSet fs;
+        if (i < frames) {
+            const float *in = &sp[i * fdsize];
+            fs = tracker.process
+                (&in, RealTime::frame2RealTime(long(i) * step + block/2, rate));
+        } else {
+            fs = tracker.getRemainingFeatures();
+        }
+        for (int o = 0; o < 2; ++o) {
+            all[o].insert(all[o].end(), fs[o].begin(), fs[o].end());
+        }
+    }
+    return all;
+}
+
+static double
+seconds(const RealTime &t)
+{
+    return t.sec + t.nsec / 1000000000.0;
+}
+
+// Drain everything waiting, capacity records at a time
+static void
+drain(cpt_tracker *t, int capacity,
+      std::vector<cpt_pitch> &pitches, std::vector<cpt_note> &notes)
+{
+    std::vector<cpt_pitch> pbuf(capacity);
+    std::vector<cpt_note> nbuf(capacity);
+    int n;
+    while ((n = cpt_drain_pitches(t, &pbuf[0], capacity)) > 0) {
+        pitches.insert(pitches.end(), pbuf.begin(), pbuf.begin() + n);
+    }
+    BOOST_CHECK_EQUAL(n, 0);
+    while ((n = cpt_drain_notes(t, &nbuf[0], capacity)) > 0) {
+        notes.insert(notes.end(), nbuf.begin(), nbuf.begin() + n);
+    }
+    BOOST_CHECK_EQUAL(n, 0);
+    BOOST_CHECK_EQUAL(cpt_pending_pitches(t), 0);
+    BOOST_CHECK_EQUAL(cpt_pending_notes(t), 0);
+}
+
+static void
+checkMatches(FeatureSet &expected, const std::vector<cpt_pitch> &pitches,
+             const std::vector<cpt_note> &notes)
+{
+    BOOST_REQUIRE_EQUAL(pitches.size(), expected[0].size());
+    for (int i = 0; i < (int)pitches.size(); ++i) {
+        BOOST_CHECK_EQUAL(pitches[i].time, seconds(expected[0][i].timestamp));
+        BOOST_CHECK_EQUAL(float(pitches[i].frequency),
+                          expected[0][i].values[0]);
+        BOOST_CHECK(pitches[i].confidence > 0.0);
+    }
+    BOOST_REQUIRE_EQUAL(notes.size(), expected[1].size());
+    for (int i = 0; i < (int)notes.size(); ++i) {
+        BOOST_CHECK_EQUAL(notes[i].time, seconds(expected[1][i].timestamp));
+        BOOST_CHECK_EQUAL(notes[i].duration, seconds(expected[1][i].duration));
+        BOOST_CHECK_EQUAL(float(notes[i].frequency), expected[1][i].values[0]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(batches)
+{
+    // One batch of everything, or batches of a few frames drained in
+    // between, give the plugin's results
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    FeatureSet expected = runPlugin(sp);
+    BOOST_CHECK(expected[1].size() > 4);
+
+    BOOST_CHECK_EQUAL(cpt_api_version(), CPT_API_VERSION);
+
+    cpt_tracker *t = cpt_create(rate, block, step);
+    BOOST_REQUIRE(t);
+    BOOST_CHECK_EQUAL(cpt_set_parameter(t, "skip", 2), 0);
+
+    BOOST_CHECK_EQUAL(cpt_process_batch(t, &sp[0], frames), frames);
+    cpt_finish(t);
+    std::vector<cpt_pitch> pitches;
+    std::vector<cpt_note> notes;
+    drain(t, 1000, pitches, notes);
+    checkMatches(expected, pitches, notes);
+
+    cpt_reset(t);
+    pitches.clear();
+    notes.clear();
+    for (int i = 0; i < frames; i += 7) {
+        int n = std::min(7, frames - i);
+        BOOST_CHECK_EQUAL(cpt_process_batch(t, &sp[i * fdsize], n), n);
+        drain(t, 3, pitches, notes);
+    }
+    cpt_finish(t);
+    drain(t, 3, pitches, notes);
+    checkMatches(expected, pitches, notes);
+
+    cpt_destroy(t);
+}
+
+BOOST_AUTO_TEST_CASE(analyse)
+{
+    // A whole recording in one call, framed as OfflineAnalyser does
+    long n = long(3.5 * rate) + 100;
+    std::vector<float> signal(n);
+    SignalGenerator gen(SignalGenerator::Vibrato, rate);
+    gen.generate(&signal[0], n);
+
+    OfflineAnalyser analyser(rate, step, block, 1);
+    FeatureSet expected;
+    BOOST_REQUIRE(analyser.analyse(&signal[0], n, expected));
+    BOOST_CHECK(!expected[1].empty());
+
+    cpt_tracker *t = cpt_create(rate, block, step);
+    BOOST_REQUIRE(t);
+
+    // Twice over, as each call starts afresh
+    for (int i = 0; i < 2; ++i) {
+        BOOST_CHECK_EQUAL(cpt_analyse(t, &signal[0], n),
+                          analyser.getFrameCount(n));
+        std::vector<cpt_pitch> pitches;
+        std::vector<cpt_note> notes;
+        drain(t, 64, pitches, notes);
+        checkMatches(expected, pitches, notes);
+    }
+
+    cpt_destroy(t);
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+    BOOST_CHECK(!cpt_create(rate, block, 0));
+    BOOST_CHECK(!cpt_create(0, block, step));
+    cpt_destroy(0);
+
+    cpt_tracker *t = cpt_create(rate, block, step);
+    BOOST_REQUIRE(t);
+
+    BOOST_CHECK_EQUAL(cpt_set_parameter(t, "nonesuch", 1), -1);
+    BOOST_CHECK_EQUAL(cpt_set_parameter(t, 0, 1), -1);
+    BOOST_CHECK_EQUAL(cpt_process_batch(t, 0, 1), -1);
+    BOOST_CHECK_EQUAL(cpt_process_batch(t, 0, 0), 0);
+    BOOST_CHECK_EQUAL(cpt_analyse(t, 0, 10), -1);
+    BOOST_CHECK_EQUAL(cpt_analyse(t, 0, 0), 0);
+    BOOST_CHECK_EQUAL(cpt_drain_notes(t, 0, 10), -1);
+    BOOST_CHECK_EQUAL(cpt_drain_notes(t, 0, 0), 0);
+    BOOST_CHECK_EQUAL(cpt_pending_pitches(0), -1);
+
+    cpt_destroy(t);
+
+    // Only a power-of-two block is supported at all
+    BOOST_CHECK(!cpt_create(rate, 1000, step));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -91,5 +91,52 @@ BOOST_AUTO_TEST_CASE(oneHarmonic)
     BOOST_CHECK(out[14] < 0);
 }
 
+BOOST_AUTO_TEST_CASE(magnitudeMean)
+{
+    // magnitudeMean returns the same as process, without the rest
+    float in[] = { 1,2,3,4,5,6,7,8,9,10 };
+    double out[8];
+    double mm = Cepstrum(8).process(in, out);
+    BOOST_CHECK_EQUAL(Cepstrum(8).magnitudeMean(in), mm);
+    float zero[] = { 0,0, 0,0, 0,0 };
+    BOOST_CHECK_EQUAL(Cepstrum(4).magnitudeMean(zero), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(transformRange)
+{
+    // transformRange gives the same bins as transform
+    int n = 64;
+    float in[66];
+    for (int i = 0; i < 66; ++i) in[i] = (i % 8) + 0.5 * (i % 3);
+    double logmag[64], out[64], range[10];
+    Cepstrum c(n);
+    c.logMagnitude(in, logmag);
+    c.transform(logmag, out);
+    c.transformRange(logmag, 27, 36, range);
+    for (int i = 0; i < 10; ++i) {
+        BOOST_CHECK_SMALL(range[i] - out[27 + i], 1e-12);
+    }
+    c.transformRange(logmag, 0, 0, range);
+    BOOST_CHECK_SMALL(range[0] - out[0], 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(evaluateFractional)
+{
+    // The cepstrum of a pure cosine in the log magnitude has its
+    // peak at the cosine's quefrency, and evaluate follows it
+    // between bins
+    int n = 64;
+    double logmag[64];
+    for (int i = 0; i <= n/2; ++i) {
+        logmag[i] = cos(2.0 * M_PI * 5 * i / n);
+    }
+    Cepstrum c(n);
+    BOOST_CHECK_SMALL(c.evaluate(logmag, 5.0) - 0.5, 1e-12);
+    BOOST_CHECK_SMALL(c.evaluate(logmag, 4.0), 1e-12);
+    BOOST_CHECK(c.evaluate(logmag, 4.9) < c.evaluate(logmag, 5.0));
+    BOOST_CHECK(c.evaluate(logmag, 5.1) < c.evaluate(logmag, 5.0));
+    BOOST_CHECK(c.evaluate(logmag, 4.5) > c.evaluate(logmag, 4.0));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
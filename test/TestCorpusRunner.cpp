@@ -0,0 +1,251 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "CorpusRunner.h"
+#include "NoteIndex.h"
+#include "OfflineAnalyser.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+
+BOOST_AUTO_TEST_SUITE(TestCorpusRunner)
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+
+static double
+seconds(const Vamp::RealTime &t)
+{
+    return t.sec + t.nsec / 1e9;
+}
+
+static void
+put(std::ofstream &f, uint32_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) f.put(char((v >> (8 * i)) & 0xff));
+}
+
+static void
+writeWave(string path, const vector<float> &s, int rate)
+{
+    std::ofstream f(path.c_str(), std::ios::binary);
+    uint32_t bytes = s.size() * 4;
+    f.write("RIFF", 4); put(f, 36 + bytes, 4); f.write("WAVE", 4);
+    f.write("fmt ", 4); put(f, 16, 4); put(f, 3, 2); put(f, 1, 2);
+    put(f, rate, 4); put(f, rate * 4, 4); put(f, 4, 2); put(f, 32, 2);
+    f.write("data", 4); put(f, bytes, 4);
+    f.write((const char *)&s[0], bytes);
+}
+
+// The lines CorpusRunner should write for a file, from a fresh
+// OfflineAnalyser
+static string
+expected(int index, const vector<float> &s, int rate)
+{
+    OfflineAnalyser analyser(rate, 256, 1024, 1);
+    FeatureSet fs;
+    analyser.analyse(&s[0], s.size(), fs);
+    std::ostringstream out;
+    char buf[200];
+    for (int i = 0; i < (int)fs[0].size(); ++i) {
+        sprintf(buf, "%d,f0,%.6f,%.6f\n", index,
+                seconds(fs[0][i].timestamp), fs[0][i].values[0]);
+        out << buf;
+    }
+    for (int i = 0; i < (int)fs[1].size(); ++i) {
+        sprintf(buf, "%d,note,%.6f,%.6f,%.6f\n", index,
+                seconds(fs[1][i].timestamp), seconds(fs[1][i].duration),
+                fs[1][i].values[0]);
+        out << buf;
+    }
+    return out.str();
+}
+
+BOOST_AUTO_TEST_CASE(corpus)
+{
+    char dirName[] = "/tmp/testcorpusXXXXXX";
+    BOOST_REQUIRE(mkdtemp(dirName));
+    string dir = dirName;
+
+    // Clips of various signals and lengths, at two sample rates, so
+    // that the workers' analysers are both reused and replaced, plus
+    // one missing file
+    vector<string> paths;
+    std::map<int, string> expect;
+    int kinds = SignalGenerator::KindCount;
+
+    for (int i = 0; i < 24; ++i) {
+        int rate = (i % 5 == 0 ? 22050 : 44100);
+        vector<float> s(long(rate * (0.3 + 0.15 * (i % 7))));
+        SignalGenerator gen(SignalGenerator::Kind(i % kinds), rate);
+        gen.generate(&s[0], s.size());
+        std::ostringstream name;
+        name << dir << "/clip" << i << ".wav";
+        writeWave(name.str(), s, rate);
+        expect[paths.size()] = expected(paths.size(), s, rate);
+        paths.push_back(name.str());
+    }
+    int missing = paths.size();
+    paths.push_back(dir + "/missing.wav");
+
+    CorpusRunner runner(3);
+    runner.setIndexPath(dir + "/index");
+    BOOST_REQUIRE(runner.run(paths, dir + "/out"));
+
+    CorpusRunner::Progress p = runner.getProgress();
+    BOOST_CHECK_EQUAL(p.files, (long)paths.size());
+    BOOST_CHECK_EQUAL(p.done, (long)paths.size());
+    BOOST_CHECK_EQUAL(p.failed, 1);
+    BOOST_CHECK(p.audio > 0.0);
+    BOOST_CHECK(p.frames > 0);
+
+    // Gather each file's lines from whichever output they went to,
+    // checking they are contiguous
+    std::map<int, string> actual;
+    for (int w = 0; w < 3; ++w) {
+        std::ostringstream name;
+        name << dir << "/out." << w << ".csv";
+        std::ifstream f(name.str().c_str());
+        BOOST_REQUIRE(f);
+        string line;
+        int last = -1;
+        std::set<int> seen;
+        while (std::getline(f, line)) {
+            int index = atoi(line.c_str());
+            if (index != last) {
+                BOOST_CHECK(seen.find(index) == seen.end());
+                seen.insert(index);
+                last = index;
+            }
+            actual[index] += line + "\n";
+        }
+        unlink(name.str().c_str());
+    }
+
+    for (std::map<int, string>::const_iterator i = expect.begin();
+         i != expect.end(); ++i) {
+        BOOST_CHECK_EQUAL(actual[i->first], i->second);
+    }
+    BOOST_CHECK_EQUAL(actual[missing].substr(0, 8), "24,error");
+
+    // The index has every file, with the notes of its output
+    NoteIndex index;
+    BOOST_REQUIRE_MESSAGE(index.open(dir + "/index"), index.getError());
+    BOOST_CHECK_EQUAL(index.getFileCount(), (int)paths.size());
+    for (int i = 0; i < (int)paths.size(); ++i) {
+        int f = index.findFile(paths[i]);
+        BOOST_REQUIRE(f >= 0);
+        std::istringstream lines(actual[i]);
+        string line;
+        vector<long> notes;
+        index.findOverlapping(f, 0.0, 1e9, notes);
+        size_t n = 0;
+        while (std::getline(lines, line)) {
+            if (line.find(",note,") == string::npos) continue;
+            BOOST_REQUIRE(n < notes.size());
+            const NoteIndex::NoteRecord &r = index.getNote(notes[n++]);
+            double t, d, hz;
+            BOOST_REQUIRE(sscanf(line.c_str(), "%*d,note,%lf,%lf,%lf",
+                                 &t, &d, &hz) == 3);
+            BOOST_CHECK(fabs(r.start - t) < 1e-6);
+            BOOST_CHECK(fabs(r.end - (t + d)) < 2e-6);
+            BOOST_CHECK(fabs(r.frequency - hz) < 1e-4);
+        }
+        BOOST_CHECK_EQUAL(n, notes.size());
+    }
+    index.close();
+    unlink((dir + "/index").c_str());
+
+    for (int i = 0; i < missing; ++i) unlink(paths[i].c_str());
+    rmdir(dirName);
+}
+
+BOOST_AUTO_TEST_CASE(unsupportedBlock)
+{
+    char dirName[] = "/tmp/testcorpusXXXXXX";
+    BOOST_REQUIRE(mkdtemp(dirName));
+    string dir = dirName;
+
+    vector<float> s(22050);
+    SignalGenerator gen(SignalGenerator::Notes, 44100);
+    gen.generate(&s[0], s.size());
+    vector<string> paths(1, dir + "/clip.wav");
+    writeWave(paths[0], s, 44100);
+
+    // A block size that is not a power of two fails each file,
+    // rather than the whole run
+    CorpusRunner runner(1);
+    runner.setBlockSize(1000);
+    BOOST_REQUIRE(runner.run(paths, dir + "/out"));
+    BOOST_CHECK_EQUAL(runner.getProgress().failed, 1);
+
+    std::ifstream f((dir + "/out.0.csv").c_str());
+    string line;
+    BOOST_REQUIRE(std::getline(f, line));
+    BOOST_CHECK_EQUAL(line.substr(0, 7), "0,error");
+
+    unlink((dir + "/out.0.csv").c_str());
+    unlink(paths[0].c_str());
+    rmdir(dirName);
+}
+
+BOOST_AUTO_TEST_CASE(manifest)
+{
+    char name[] = "/tmp/testmanifestXXXXXX";
+    int fd = mkstemp(name);
+    BOOST_REQUIRE(fd >= 0);
+    string text = "# corpus\na.wav\n\nb c.wav\r\n";
+    BOOST_REQUIRE(write(fd, text.c_str(), text.size()) == (ssize_t)text.size());
+    close(fd);
+
+    vector<string> paths;
+    BOOST_REQUIRE(CorpusRunner::readManifest(name, paths));
+    BOOST_REQUIRE_EQUAL(paths.size(), 2);
+    BOOST_CHECK_EQUAL(paths[0], "a.wav");
+    BOOST_CHECK_EQUAL(paths[1], "b c.wav");
+    unlink(name);
+
+    BOOST_CHECK(!CorpusRunner::readManifest("/nonexistent/manifest", paths));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
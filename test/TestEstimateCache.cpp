@@ -0,0 +1,264 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "EstimateCache.h"
+#include "OfflineAnalyser.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using Vamp::RealTime;
+
+BOOST_AUTO_TEST_SUITE(TestEstimateCache)
+
+typedef std::map<std::string, float> Params;
+
+static const float rate = 44100;
+static const int block = 1024;
+static const int step = 256;
+
+static std::vector<float>
+signal(SignalGenerator::Kind kind, double seconds)
+{
+    std::vector<float> s(long(seconds * rate));
+    SignalGenerator gen(kind, rate);
+    gen.generate(&s[0], s.size());
+    return s;
+}
+
+struct TempPath {
+    TempPath() {
+        char name[] = "/tmp/testestimatecacheXXXXXX";
+        int fd = mkstemp(name);
+        if (fd >= 0) close(fd);
+        path = name;
+    }
+    ~TempPath() {
+        unlink(path.c_str());
+    }
+    long size() const {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? long(st.st_size) : -1;
+    }
+    std::string path;
+};
+
+// A source with no array, so that its samples are read through it
+class CopyingSource : public OfflineAnalyser::Source
+{
+public:
+    CopyingSource(const std::vector<float> &s) : m_s(s) { }
+
+    long getLength() const { return m_s.size(); }
+    void read(long from, long count, float *out) const {
+        std::copy(&m_s[from], &m_s[from] + count, out);
+    }
+
+private:
+    const std::vector<float> &m_s;
+};
+
+BOOST_AUTO_TEST_CASE(keys)
+{
+    std::vector<float> s = signal(SignalGenerator::Vibrato, 1.0);
+    Params params;
+    EstimateCache::Key k = EstimateCache::makeKey
+        (&s[0], s.size(), rate, step, block, params);
+
+    BOOST_CHECK(EstimateCache::makeKey
+                (&s[0], s.size(), rate, step, block, params) == k);
+    BOOST_CHECK_EQUAL(EstimateCache::getFileName(k).size(), 38);
+
+    // Any change to the audio changes the content hash only
+    std::vector<float> t(s);
+    t[1000] += 1e-6f;
+    EstimateCache::Key kt = EstimateCache::makeKey
+        (&t[0], t.size(), rate, step, block, params);
+    BOOST_CHECK(kt.content != k.content);
+    BOOST_CHECK_EQUAL(kt.analysis, k.analysis);
+    kt = EstimateCache::makeKey(&s[0], s.size() - 1, rate, step, block, params);
+    BOOST_CHECK(kt.content != k.content);
+
+    // Samples read from a source with no array hash the same, here
+    // through more than one buffer
+    std::vector<float> l = signal(SignalGenerator::Vibrato, 3.0);
+    BOOST_CHECK(EstimateCache::makeKey
+                (CopyingSource(l), rate, step, block, params) ==
+                EstimateCache::makeKey
+                (&l[0], l.size(), rate, step, block, params));
+
+    // Any change to the analysis changes the analysis hash only
+    EstimateCache::Key ka[4] = {
+        EstimateCache::makeKey(&s[0], s.size(), 48000, step, block, params),
+        EstimateCache::makeKey(&s[0], s.size(), rate, step * 2, block, params),
+        EstimateCache::makeKey(&s[0], s.size(), rate, step, block * 2, params),
+    };
+    params["bandlimit"] = 2000;
+    ka[3] = EstimateCache::makeKey(&s[0], s.size(), rate, step, block, params);
+    for (int i = 0; i < 4; ++i) {
+        BOOST_CHECK_EQUAL(ka[i].content, k.content);
+        BOOST_CHECK(ka[i].analysis != k.analysis);
+        BOOST_CHECK(EstimateCache::getFileName(ka[i]) !=
+                    EstimateCache::getFileName(k));
+    }
+
+    // Parameters are keyed by their effective values, so a default
+    // given explicitly, or a name the plugin does not have, changes
+    // nothing
+    Params defaults;
+    defaults["bandlimit"] = 0;
+    defaults["skip"] = 1;
+    defaults["refine"] = 1;
+    defaults["fmax"] = 1000;
+    BOOST_CHECK(EstimateCache::makeKey
+                (&s[0], s.size(), rate, step, block, defaults) == k);
+
+    // The expected frame count follows the sample count and step
+    OfflineAnalyser analyser(rate, step, block, 1);
+    BOOST_CHECK_EQUAL(k.frameCount, analyser.getFrameCount(s.size()));
+    BOOST_CHECK_EQUAL(ka[1].frameCount,
+                      OfflineAnalyser::getFrameCount(s.size(), step * 2));
+}
+
+BOOST_AUTO_TEST_CASE(roundTrip)
+{
+    // Frames read back are exactly those written, and tracking them
+    // gives exactly the result of analysing the audio
+    std::vector<float> s = signal(SignalGenerator::Notes, 6.0);
+    OfflineAnalyser analyser(rate, step, block, 2);
+    OfflineAnalyser::Frames frames;
+    BOOST_REQUIRE(analyser.estimate(&s[0], s.size(), frames));
+
+    EstimateCache::Key key = EstimateCache::makeKey
+        (&s[0], s.size(), rate, step, block, Params());
+    TempPath tmp;
+    BOOST_REQUIRE(EstimateCache::write(tmp.path, key, rate, step, block,
+                                       frames));
+    BOOST_CHECK_EQUAL(tmp.size(), long(sizeof(EstimateCache::Header) +
+                                       frames.size() * 16));
+
+    OfflineAnalyser::Frames cached;
+    BOOST_REQUIRE(EstimateCache::read(tmp.path, key, cached));
+    BOOST_REQUIRE_EQUAL(cached.size(), frames.size());
+    int present = 0;
+    for (int i = 0; i < (int)frames.size(); ++i) {
+        BOOST_CHECK_EQUAL(cached[i].present, frames[i].present);
+        if (!frames[i].present) continue;
+        BOOST_CHECK(cached[i].estimate == frames[i].estimate);
+        ++present;
+    }
+    BOOST_CHECK(present > 0);
+    BOOST_CHECK(present < (int)frames.size());
+
+    NoteHypothesis::Estimates expectedPitches, pitches;
+    OfflineAnalyser::Notes expectedNotes, notes;
+    BOOST_REQUIRE(analyser.analyse(&s[0], s.size(),
+                                   expectedPitches, expectedNotes));
+    analyser.track(cached, pitches, notes);
+    BOOST_CHECK(!notes.empty());
+    BOOST_CHECK(pitches == expectedPitches);
+    BOOST_CHECK(notes == expectedNotes);
+}
+
+BOOST_AUTO_TEST_CASE(misses)
+{
+    std::vector<float> s = signal(SignalGenerator::Vibrato, 1.0);
+    OfflineAnalyser analyser(rate, step, block, 1);
+    OfflineAnalyser::Frames frames;
+    BOOST_REQUIRE(analyser.estimate(&s[0], s.size(), frames));
+
+    EstimateCache::Key key = EstimateCache::makeKey
+        (&s[0], s.size(), rate, step, block, Params());
+    OfflineAnalyser::Frames cached;
+    BOOST_CHECK(!EstimateCache::read("/nonexistent/entry", key, cached));
+    BOOST_CHECK(!EstimateCache::write("/nonexistent/entry", key,
+                                      rate, step, block, frames));
+
+    TempPath tmp;
+    BOOST_REQUIRE(EstimateCache::write(tmp.path, key, rate, step, block,
+                                       frames));
+    BOOST_CHECK_EQUAL(access((tmp.path + ".tmp").c_str(), F_OK), -1);
+
+    // Another key
+    EstimateCache::Key other = key;
+    other.analysis ^= 1;
+    BOOST_CHECK(!EstimateCache::read(tmp.path, other, cached));
+    BOOST_CHECK(cached.empty());
+
+    // Another expected frame count, for which the header is wrong
+    other = key;
+    other.frameCount += 1;
+    BOOST_CHECK(!EstimateCache::read(tmp.path, other, cached));
+    BOOST_CHECK(cached.empty());
+
+    // Longer than its header says
+    long size = tmp.size();
+    BOOST_REQUIRE_EQUAL(truncate(tmp.path.c_str(), size + 16), 0);
+    BOOST_CHECK(!EstimateCache::read(tmp.path, key, cached));
+    BOOST_CHECK(cached.empty());
+    BOOST_REQUIRE_EQUAL(truncate(tmp.path.c_str(), size), 0);
+    BOOST_CHECK(EstimateCache::read(tmp.path, key, cached));
+
+    // A frame count in the header larger than the file holds is
+    // refused before anything is allocated for it
+    {
+        EstimateCache::Header h;
+        FILE *f = fopen(tmp.path.c_str(), "r+b");
+        BOOST_REQUIRE(f);
+        BOOST_REQUIRE_EQUAL(fread(&h, sizeof(h), 1, f), 1);
+        h.frameCount = 0xffffffffu;
+        fseek(f, 0, SEEK_SET);
+        BOOST_REQUIRE_EQUAL(fwrite(&h, sizeof(h), 1, f), 1);
+        fclose(f);
+        other = key;
+        other.frameCount = h.frameCount;
+        BOOST_CHECK(!EstimateCache::read(tmp.path, other, cached));
+        BOOST_CHECK(cached.empty());
+    }
+
+    // Truncated
+    BOOST_REQUIRE(EstimateCache::write(tmp.path, key, rate, step, block,
+                                       frames));
+    BOOST_REQUIRE_EQUAL(truncate(tmp.path.c_str(), tmp.size() - 8), 0);
+    BOOST_CHECK(!EstimateCache::read(tmp.path, key, cached));
+    BOOST_CHECK(cached.empty());
+
+    // Empty
+    BOOST_REQUIRE_EQUAL(truncate(tmp.path.c_str(), 0), 0);
+    BOOST_CHECK(!EstimateCache::read(tmp.path, key, cached));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
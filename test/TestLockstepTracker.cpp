@@ -0,0 +1,266 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "LockstepTracker.h"
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+using Vamp::RealTime;
+
+BOOST_AUTO_TEST_SUITE(TestLockstepTracker)
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+
+static const float rate = 44100;
+static const int block = 1024;
+static const int step = 256;
+static const int frames = 5 * rate / step;
+
+static std::vector<float>
+spectra(SignalGenerator::Kind kind)
+{
+    std::vector<float> signal(frames * step + block, 0.f);
+    SignalGenerator gen(kind, rate);
+    gen.generate(&signal[0], frames * step);
+    std::vector<float> out(frames * (block + 2));
+    Stft stft(block);
+    for (int i = 0; i < frames; ++i) {
+        stft.process(&signal[i * step], &out[i * (block + 2)]);
+    }
+    return out;
+}
+
+static RealTime
+timeOf(int i)
+{
+    return RealTime::frame2RealTime(long(i) * step + block/2, rate);
+}
+
+static void
+append(FeatureSet &to, FeatureSet &from)
+{
+    for (int o = 0; o < 2; ++o) {
+        to[o].insert(to[o].end(), from[o].begin(), from[o].end());
+    }
+}
+
+static FeatureSet
+runPlugin(const std::vector<float> &sp,
+          const NoteHypothesis::Rules &rules = NoteHypothesis::Rules(),
+          float bandLimit = 0)
+{
+    CepstralPitchTracker tracker(rate);
+    tracker.setNoteRules(rules);
+    tracker.setParameter("bandlimit", bandLimit);
+    tracker.initialise(1, step, block);
+    FeatureSet all;
+    for (int i = 0; i < frames; ++i) {
+        const float *in = &sp[i * (block + 2)];
+        FeatureSet fs = tracker.process(&in, timeOf(i));
+        append(all, fs);
+    }
+    FeatureSet fs = tracker.getRemainingFeatures();
+    append(all, fs);
+    return all;
+}
+
+static void
+checkSame(FeatureSet &expected, FeatureSet &actual)
+{
+    for (int o = 0; o < 2; ++o) {
+        BOOST_REQUIRE_EQUAL(actual[o].size(), expected[o].size());
+        for (int i = 0; i < (int)expected[o].size(); ++i) {
+            BOOST_CHECK_EQUAL(actual[o][i].timestamp, expected[o][i].timestamp);
+            BOOST_CHECK_CLOSE(actual[o][i].values[0],
+                              expected[o][i].values[0], 1e-4);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(matchesPlugin)
+{
+    // One stream per kind of test signal, plus one that never has
+    // any input
+    int kinds = SignalGenerator::KindCount;
+    int streams = kinds + 1;
+
+    std::vector<std::vector<float> > sp;
+    for (int k = 0; k < kinds; ++k) {
+        sp.push_back(spectra(SignalGenerator::Kind(k)));
+    }
+
+    LockstepTracker lt(streams, rate, block);
+    BOOST_CHECK_EQUAL(lt.getStreamCount(), streams);
+
+    std::vector<FeatureSet> results(streams);
+    std::vector<const float *> in(streams, (const float *)0);
+
+    for (int i = 0; i < frames; ++i) {
+        for (int k = 0; k < kinds; ++k) {
+            in[k] = &sp[k][i * (block + 2)];
+        }
+        std::vector<FeatureSet> fs = lt.process(&in[0], timeOf(i));
+        BOOST_REQUIRE_EQUAL((int)fs.size(), streams);
+        for (int s = 0; s < streams; ++s) {
+            append(results[s], fs[s]);
+        }
+    }
+    std::vector<FeatureSet> fs = lt.finish();
+    for (int s = 0; s < streams; ++s) {
+        append(results[s], fs[s]);
+    }
+
+    for (int k = 0; k < kinds; ++k) {
+        FeatureSet expected = runPlugin(sp[k]);
+        checkSame(expected, results[k]);
+    }
+
+    BOOST_CHECK(results[kinds][0].empty());
+    BOOST_CHECK(results[kinds][1].empty());
+
+    // The note sequence should have produced some notes
+    BOOST_CHECK(!results[SignalGenerator::Notes][1].empty());
+}
+
+BOOST_AUTO_TEST_CASE(streamReuse)
+{
+    // A stream that is finished and then given a new input produces
+    // the same features as a fresh one, while another stream runs on
+    std::vector<float> notes = spectra(SignalGenerator::Notes);
+    std::vector<float> vibrato = spectra(SignalGenerator::Vibrato);
+
+    LockstepTracker lt(2, rate, block);
+    std::vector<const float *> in(2);
+    std::vector<RealTime> t(2);
+
+    int firstPart = frames / 3;
+    FeatureSet first, second;
+
+    for (int i = 0; i < firstPart; ++i) {
+        in[0] = &notes[i * (block + 2)];
+        in[1] = &vibrato[i * (block + 2)];
+        std::vector<FeatureSet> fs = lt.process(&in[0], timeOf(i));
+        append(second, fs[1]);
+    }
+    FeatureSet fs0 = lt.finishStream(0);
+    append(first, fs0);
+
+    FeatureSet restarted;
+    for (int i = firstPart; i < frames; ++i) {
+        in[0] = &notes[(i - firstPart) * (block + 2)];
+        in[1] = &vibrato[i * (block + 2)];
+        t[0] = timeOf(i - firstPart);
+        t[1] = timeOf(i);
+        std::vector<FeatureSet> fs = lt.process(&in[0], &t[0]);
+        append(restarted, fs[0]);
+        append(second, fs[1]);
+    }
+    fs0 = lt.finishStream(0);
+    append(restarted, fs0);
+    FeatureSet fs1 = lt.finishStream(1);
+    append(second, fs1);
+
+    LockstepTracker fresh(1, rate, block);
+    FeatureSet expected;
+    for (int i = 0; i < frames - firstPart; ++i) {
+        const float *p = &notes[i * (block + 2)];
+        std::vector<FeatureSet> fs = fresh.process(&p, timeOf(i));
+        append(expected, fs[0]);
+    }
+    std::vector<FeatureSet> fs = fresh.finish();
+    append(expected, fs[0]);
+
+    checkSame(expected, restarted);
+
+    FeatureSet vexpected = runPlugin(vibrato);
+    checkSame(vexpected, second);
+}
+
+BOOST_AUTO_TEST_CASE(rules)
+{
+    // Every stream tracks with the rules given, as the plugin does
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    NoteHypothesis::Rules rules;
+    rules.lastTolerance = 20;
+    rules.requiredConfidence = 8.0;
+    FeatureSet expected = runPlugin(sp, rules);
+    BOOST_CHECK(!expected[1].empty());
+    BOOST_CHECK(expected[0].size() != runPlugin(sp)[0].size());
+
+    LockstepTracker lt(2, rate, block);
+    lt.setNoteRules(rules);
+    std::vector<FeatureSet> results(2);
+    std::vector<const float *> in(2);
+    for (int i = 0; i < frames; ++i) {
+        in[0] = in[1] = &sp[i * (block + 2)];
+        std::vector<FeatureSet> fs = lt.process(&in[0], timeOf(i));
+        for (int s = 0; s < 2; ++s) append(results[s], fs[s]);
+    }
+    std::vector<FeatureSet> fs = lt.finish();
+    for (int s = 0; s < 2; ++s) {
+        append(results[s], fs[s]);
+        checkSame(expected, results[s]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parameters)
+{
+    // The bandwidth limit is applied as the plugin applies it
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    FeatureSet expected = runPlugin(sp, NoteHypothesis::Rules(), 4000);
+    BOOST_CHECK(!expected[1].empty());
+
+    LockstepTracker lt(1, rate, block);
+    BOOST_CHECK(lt.setParameter("bandlimit", 4000));
+    FeatureSet result;
+    for (int i = 0; i < frames; ++i) {
+        const float *p = &sp[i * (block + 2)];
+        std::vector<FeatureSet> fs = lt.process(&p, timeOf(i));
+        append(result, fs[0]);
+    }
+    std::vector<FeatureSet> fs = lt.finish();
+    append(result, fs[0]);
+    checkSame(expected, result);
+
+    // The others are accepted only at their defaults
+    BOOST_CHECK(lt.setParameter("skip", 1));
+    BOOST_CHECK(!lt.setParameter("skip", 3));
+    BOOST_CHECK(lt.setParameter("narrow", 0));
+    BOOST_CHECK(!lt.setParameter("narrow", 1));
+    BOOST_CHECK(!lt.setParameter("refine", 4));
+    BOOST_CHECK(!lt.setParameter("dual", 1));
+    BOOST_CHECK(!lt.setParameter("nonesuch", 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -151,6 +151,40 @@ BOOST_AUTO_TEST_CASE(expiry)
     BOOST_CHECK(!h.accept(e6));
     BOOST_CHECK_EQUAL(h.getState(), NoteHypothesis::Expired);
 }
+
+BOOST_AUTO_TEST_CASE(rules)
+{
+    // With a longer gap allowed, the estimates that were too slow
+    // above belong together; with a larger confidence required,
+    // four of them are not enough to satisfy; and with a smaller
+    // tolerance, a 50-cent step is rejected
+    NoteHypothesis::Rules rules;
+    rules.maximumGap = RealTime::fromMilliseconds(60);
+    rules.requiredConfidence = 4.0;
+    rules.lastTolerance = 40;
+    NoteHypothesis h(rules);
+    BOOST_CHECK_EQUAL(h.getRules().requiredConfidence, 4.0);
+    NoteHypothesis::Estimate e1(500, RealTime::fromMilliseconds(0), 1);
+    NoteHypothesis::Estimate e2(500, RealTime::fromMilliseconds(50), 1);
+    NoteHypothesis::Estimate e3(500, RealTime::fromMilliseconds(60), 1);
+    NoteHypothesis::Estimate e4(514.7, RealTime::fromMilliseconds(70), 1);
+    NoteHypothesis::Estimate e5(500, RealTime::fromMilliseconds(80), 1);
+    NoteHypothesis::Estimate e6(500, RealTime::fromMilliseconds(90), 1);
+    BOOST_CHECK(h.accept(e1));
+    BOOST_CHECK(h.accept(e2));
+    BOOST_CHECK(h.accept(e3));
+    BOOST_CHECK_EQUAL(h.getState(), NoteHypothesis::Provisional);
+    BOOST_CHECK(!h.accept(e4));
+    BOOST_CHECK(h.accept(e5));
+    BOOST_CHECK_EQUAL(h.getState(), NoteHypothesis::Provisional);
+    BOOST_CHECK(h.accept(e6));
+    BOOST_CHECK_EQUAL(h.getState(), NoteHypothesis::Satisfied);
+
+    // The same step is within the default tolerance
+    NoteHypothesis d;
+    BOOST_CHECK(d.accept(e3));
+    BOOST_CHECK(d.accept(e4));
+}
 	
 BOOST_AUTO_TEST_CASE(strayReject1)
 {
@@ -0,0 +1,278 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "NoteIndex.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using Vamp::RealTime;
+using std::string;
+using std::vector;
+
+BOOST_AUTO_TEST_SUITE(TestNoteIndex)
+
+typedef NoteIndex::Note Note;
+typedef NoteIndex::Notes Notes;
+
+struct TempFile {
+    TempFile() {
+        char name[] = "/tmp/testnoteindexXXXXXX";
+        int fd = mkstemp(name);
+        path = name;
+        out = (fd >= 0 ? fdopen(fd, "wb") : 0);
+    }
+    ~TempFile() {
+        if (out) fclose(out);
+        unlink(path.c_str());
+    }
+    void finish() {
+        fclose(out);
+        out = 0;
+    }
+    string path;
+    FILE *out;
+};
+
+static double
+seconds(const RealTime &t)
+{
+    return t.sec + t.nsec / 1000000000.0;
+}
+
+// Notes of a single tracker, which never overlap, with gaps between
+static Notes
+notesFor(int file, int count)
+{
+    Notes notes;
+    srand(file + 1);
+    double t = 0.0;
+    for (int i = 0; i < count; ++i) {
+        t += 0.01 * (rand() % 100);
+        double d = 0.05 + 0.01 * (rand() % 80);
+        double hz = 55.0 * pow(2.0, (rand() % 4800) / 1200.0);
+        notes.push_back(Note(hz, RealTime::fromSeconds(t),
+                             RealTime::fromSeconds(d)));
+        t += d;
+    }
+    return notes;
+}
+
+struct Corpus {
+    vector<string> names;
+    vector<Notes> notes;
+};
+
+static Corpus
+corpus()
+{
+    Corpus c;
+    const char *names[] = { "b.wav", "a/long.wav", "c.wav", "empty.wav" };
+    int counts[] = { 40, 500, 7, 0 };
+    for (int i = 0; i < 4; ++i) {
+        c.names.push_back(names[i]);
+        c.notes.push_back(notesFor(i, counts[i]));
+    }
+    return c;
+}
+
+static bool
+writeIndex(TempFile &tmp, const Corpus &c, bool pitches)
+{
+    if (!tmp.out) return false;
+    bool ok = NoteIndex::write(tmp.out, c.names, c.notes, pitches);
+    tmp.finish();
+    return ok;
+}
+
+BOOST_AUTO_TEST_CASE(files)
+{
+    Corpus c = corpus();
+    TempFile tmp;
+    BOOST_REQUIRE(writeIndex(tmp, c, true));
+
+    NoteIndex index;
+    BOOST_REQUIRE_MESSAGE(index.open(tmp.path), index.getError());
+    BOOST_CHECK_EQUAL(index.getFileCount(), 4);
+    BOOST_CHECK_EQUAL(index.getNoteCount(), 547);
+    BOOST_CHECK(index.hasPitchIndex());
+
+    // Sorted by name
+    BOOST_CHECK_EQUAL(index.getFileName(0), "a/long.wav");
+    BOOST_CHECK_EQUAL(index.getFileName(3), "empty.wav");
+
+    for (int i = 0; i < 4; ++i) {
+        int f = index.findFile(c.names[i]);
+        BOOST_REQUIRE(f >= 0);
+        BOOST_CHECK_EQUAL(index.getFileName(f), c.names[i]);
+        BOOST_CHECK_EQUAL(index.getFile(f).noteCount, c.notes[i].size());
+    }
+    BOOST_CHECK_EQUAL(index.findFile("d.wav"), -1);
+    BOOST_CHECK_EQUAL(index.findFile(""), -1);
+}
+
+BOOST_AUTO_TEST_CASE(timeRanges)
+{
+    Corpus c = corpus();
+    TempFile tmp;
+    BOOST_REQUIRE(writeIndex(tmp, c, false));
+
+    NoteIndex index;
+    BOOST_REQUIRE_MESSAGE(index.open(tmp.path), index.getError());
+    BOOST_CHECK(!index.hasPitchIndex());
+
+    // Every query gives what a scan of the notes would
+    srand(99);
+    for (int q = 0; q < 300; ++q) {
+        int i = q % 4;
+        const Notes &notes = c.notes[i];
+        double from = 0.01 * (rand() % 40000);
+        double to = from + 0.01 * (rand() % 1000);
+
+        vector<long> found;
+        index.findOverlapping(index.findFile(c.names[i]), from, to, found);
+
+        size_t n = 0;
+        for (size_t j = 0; j < notes.size(); ++j) {
+            double start = seconds(notes[j].time);
+            double end = seconds(notes[j].time + notes[j].duration);
+            if (end < from || start > to) continue;
+            BOOST_REQUIRE(n < found.size());
+            const NoteIndex::NoteRecord &r = index.getNote(found[n++]);
+            BOOST_CHECK_EQUAL(r.start, start);
+            BOOST_CHECK_EQUAL(r.frequency, float(notes[j].freq));
+        }
+        BOOST_CHECK_EQUAL(n, found.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(overlappingNotes)
+{
+    // A long note spanning later short ones is still found, and the
+    // notes are sorted by start time
+    Corpus c;
+    c.names.push_back("x");
+    c.notes.resize(1);
+    c.notes[0].push_back(Note(100, RealTime::fromSeconds(5),
+                              RealTime::fromSeconds(1)));
+    c.notes[0].push_back(Note(200, RealTime::fromSeconds(0),
+                              RealTime::fromSeconds(20)));
+    c.notes[0].push_back(Note(300, RealTime::fromSeconds(10),
+                              RealTime::fromSeconds(1)));
+
+    TempFile tmp;
+    BOOST_REQUIRE(writeIndex(tmp, c, true));
+    NoteIndex index;
+    BOOST_REQUIRE_MESSAGE(index.open(tmp.path), index.getError());
+
+    vector<long> found;
+    index.findOverlapping(0, 12, 13, found);
+    BOOST_REQUIRE_EQUAL(found.size(), 1);
+    BOOST_CHECK_EQUAL(index.getNote(found[0]).frequency, 200.f);
+
+    found.clear();
+    index.findOverlapping(0, 5.5, 10, found);
+    BOOST_REQUIRE_EQUAL(found.size(), 3);
+    BOOST_CHECK_EQUAL(index.getNote(found[0]).start, 0.0);
+    BOOST_CHECK_EQUAL(index.getNote(found[1]).start, 5.0);
+    BOOST_CHECK_EQUAL(index.getNote(found[2]).start, 10.0);
+}
+
+BOOST_AUTO_TEST_CASE(pitches)
+{
+    Corpus c = corpus();
+    TempFile tmp;
+    BOOST_REQUIRE(writeIndex(tmp, c, true));
+
+    NoteIndex index;
+    BOOST_REQUIRE_MESSAGE(index.open(tmp.path), index.getError());
+
+    double targets[] = { 55.0, 110.0, 440.0, 443.0, 880.0 };
+    double widths[] = { 0.0, 10.0, 50.0, 200.0 };
+
+    for (int t = 0; t < 5; ++t) {
+        for (int w = 0; w < 4; ++w) {
+            double low = targets[t] * pow(2.0, -widths[w] / 1200.0);
+            double high = targets[t] * pow(2.0, widths[w] / 1200.0);
+            size_t expected = 0;
+            for (int i = 0; i < 4; ++i) {
+                for (size_t j = 0; j < c.notes[i].size(); ++j) {
+                    float hz = float(c.notes[i][j].freq);
+                    if (hz >= low && hz <= high) ++expected;
+                }
+            }
+            vector<long> found;
+            BOOST_REQUIRE(index.findNear(targets[t], widths[w], found));
+            BOOST_CHECK_EQUAL(found.size(), expected);
+            for (size_t k = 0; k < found.size(); ++k) {
+                float hz = index.getNote(found[k]).frequency;
+                BOOST_CHECK(hz >= low && hz <= high);
+                if (k > 0) {
+                    BOOST_CHECK(index.getNote(found[k-1]).frequency <= hz);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(invalid)
+{
+    Corpus c = corpus();
+    c.names[1] = c.names[0];
+    TempFile dup;
+    BOOST_CHECK(!writeIndex(dup, c, true));
+
+    NoteIndex index;
+    BOOST_CHECK(!index.open("/nonexistent/index"));
+    BOOST_CHECK_EQUAL(index.getFileCount(), 0);
+
+    c = corpus();
+    TempFile tmp;
+    BOOST_REQUIRE(writeIndex(tmp, c, true));
+    struct stat st;
+    BOOST_REQUIRE(stat(tmp.path.c_str(), &st) == 0);
+    BOOST_REQUIRE_EQUAL(truncate(tmp.path.c_str(), st.st_size - 16), 0);
+    BOOST_CHECK(!index.open(tmp.path));
+    BOOST_CHECK(index.getError().find("Truncated") != string::npos);
+
+    FILE *out = fopen(tmp.path.c_str(), "wb");
+    BOOST_REQUIRE(out);
+    vector<char> junk(200, 'x');
+    fwrite(&junk[0], 1, junk.size(), out);
+    fclose(out);
+    BOOST_CHECK(!index.open(tmp.path));
+    BOOST_CHECK(index.getError().find("Not a note index") != string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
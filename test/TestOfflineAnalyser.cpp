@@ -0,0 +1,400 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "OfflineAnalyser.h"
+#include "CepstralPitchTracker.h"
+#include "AgentFeeder.h"
+#include "Stft.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+using Vamp::RealTime;
+
+BOOST_AUTO_TEST_SUITE(TestOfflineAnalyser)
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+typedef std::map<std::string, float> Params;
+
+static const float rate = 44100;
+static const int block = 1024;
+static const int step = 256;
+
+// Not a whole number of steps, so that the last frames are padded
+static const long length = long(rate * 6) + 100;
+
+static std::vector<float>
+signal(SignalGenerator::Kind kind)
+{
+    std::vector<float> s(length);
+    SignalGenerator gen(kind, rate);
+    gen.generate(&s[0], length);
+    return s;
+}
+
+static void
+append(FeatureSet &to, FeatureSet &from)
+{
+    for (int o = 0; o < 2; ++o) {
+        to[o].insert(to[o].end(), from[o].begin(), from[o].end());
+    }
+}
+
+static FeatureSet
+runPlugin(const std::vector<float> &s, const Params &params)
+{
+    int frames = (length + step - 1) / step;
+    std::vector<float> padded(s);
+    padded.resize(long(frames) * step + block, 0.f);
+
+    CepstralPitchTracker tracker(rate);
+    for (Params::const_iterator i = params.begin(); i != params.end(); ++i) {
+        tracker.setParameter(i->first, i->second);
+    }
+    tracker.initialise(1, step, block);
+
+    Stft stft(block);
+    std::vector<float> spectrum(block + 2);
+    const float *in = &spectrum[0];
+
+    FeatureSet all;
+    for (int i = 0; i < frames; ++i) {
+        stft.process(&padded[long(i) * step], &spectrum[0]);
+        RealTime t = RealTime::frame2RealTime(long(i) * step + block/2, rate);
+        FeatureSet fs = tracker.process(&in, t);
+        append(all, fs);
+    }
+    FeatureSet fs = tracker.getRemainingFeatures();
+    append(all, fs);
+    return all;
+}
+
+static void
+checkIdentical(FeatureSet &expected, FeatureSet &actual)
+{
+    for (int o = 0; o < 2; ++o) {
+        BOOST_REQUIRE_EQUAL(actual[o].size(), expected[o].size());
+        for (int i = 0; i < (int)expected[o].size(); ++i) {
+            BOOST_CHECK_EQUAL(actual[o][i].timestamp, expected[o][i].timestamp);
+            BOOST_CHECK_EQUAL(actual[o][i].duration, expected[o][i].duration);
+            BOOST_CHECK(actual[o][i].values == expected[o][i].values);
+        }
+    }
+}
+
+static void
+checkAgainstPlugin(const Params &params, bool independent)
+{
+    int threads[] = { 1, 3 };
+
+    for (int k = 0; k < SignalGenerator::KindCount; ++k) {
+
+        std::vector<float> s = signal(SignalGenerator::Kind(k));
+        FeatureSet expected = runPlugin(s, params);
+
+        for (int t = 0; t < 2; ++t) {
+            OfflineAnalyser analyser(rate, step, block, threads[t]);
+            for (Params::const_iterator i = params.begin();
+                 i != params.end(); ++i) {
+                analyser.setParameter(i->first, i->second);
+            }
+            BOOST_CHECK_EQUAL(analyser.hasIndependentEstimates(), independent);
+            FeatureSet actual;
+            BOOST_REQUIRE(analyser.analyse(&s[0], length, actual));
+            checkIdentical(expected, actual);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(defaults)
+{
+    checkAgainstPlugin(Params(), true);
+}
+
+BOOST_AUTO_TEST_CASE(parameters)
+{
+    Params params;
+    params["bandlimit"] = 4000;
+    params["refine"] = 4;
+    params["dual"] = 1;
+    checkAgainstPlugin(params, true);
+}
+
+BOOST_AUTO_TEST_CASE(serialFallback)
+{
+    Params params;
+    params["skip"] = 3;
+    params["narrow"] = 1;
+    checkAgainstPlugin(params, false);
+}
+
+BOOST_AUTO_TEST_CASE(stages)
+{
+    std::vector<float> s = signal(SignalGenerator::Notes);
+
+    OfflineAnalyser analyser(rate, step, block, 2);
+    OfflineAnalyser::Frames frames;
+    BOOST_REQUIRE(analyser.estimate(&s[0], length, frames));
+    BOOST_CHECK_EQUAL((int)frames.size(), analyser.getFrameCount(length));
+    BOOST_CHECK_EQUAL(frames[10].estimate.time, analyser.getFrameTime(10));
+
+    FeatureSet staged = analyser.track(frames);
+    BOOST_CHECK(!staged[1].empty());
+
+    FeatureSet whole;
+    BOOST_REQUIRE(analyser.analyse(&s[0], length, whole));
+    checkIdentical(whole, staged);
+
+    analyser.setParameter("skip", 2);
+    BOOST_CHECK(!analyser.estimate(&s[0], length, frames));
+    BOOST_CHECK(frames.empty());
+}
+
+// A source with no array, so that every block is read through it,
+// noting any read outside the input
+class CopyingSource : public OfflineAnalyser::Source
+{
+public:
+    CopyingSource(const std::vector<float> &s) : m_s(s), m_bad(false) { }
+
+    long getLength() const { return m_s.size(); }
+    void read(long from, long count, float *out) const {
+        if (from < 0 || count < 1 || from + count > getLength()) {
+            m_bad = true;
+            return;
+        }
+        std::copy(&m_s[from], &m_s[from] + count, out);
+    }
+
+    bool hadBadRead() const { return m_bad; }
+
+private:
+    const std::vector<float> &m_s;
+    mutable std::atomic<bool> m_bad;
+};
+
+BOOST_AUTO_TEST_CASE(sources)
+{
+    std::vector<float> s = signal(SignalGenerator::Notes);
+    CopyingSource source(s);
+
+    OfflineAnalyser analyser(rate, step, block, 3);
+    OfflineAnalyser::Frames expectedFrames, actualFrames;
+    BOOST_REQUIRE(analyser.estimate(&s[0], length, expectedFrames));
+    BOOST_REQUIRE(analyser.estimate(source, actualFrames));
+    BOOST_REQUIRE_EQUAL(actualFrames.size(), expectedFrames.size());
+    for (int i = 0; i < (int)expectedFrames.size(); ++i) {
+        const OfflineAnalyser::Frame &e = expectedFrames[i];
+        const OfflineAnalyser::Frame &a = actualFrames[i];
+        BOOST_CHECK_EQUAL(a.present, e.present);
+        BOOST_CHECK_EQUAL(a.estimate.freq, e.estimate.freq);
+        BOOST_CHECK_EQUAL(a.estimate.confidence, e.estimate.confidence);
+    }
+
+    // Both the parallel and the serial analysis
+    for (int serial = 0; serial < 2; ++serial) {
+        if (serial) analyser.setParameter("skip", 3);
+        FeatureSet expected, actual;
+        BOOST_REQUIRE(analyser.analyse(&s[0], length, expected));
+        BOOST_REQUIRE(analyser.analyse(source, actual));
+        checkIdentical(expected, actual);
+    }
+
+    BOOST_CHECK(!source.hadBadRead());
+}
+
+static FeatureSet
+trackSerially(const OfflineAnalyser::Frames &frames,
+              const NoteHypothesis::Rules &rules = NoteHypothesis::Rules())
+{
+    AgentFeeder feeder(rules);
+    for (int i = 0; i < (int)frames.size(); ++i) {
+        if (frames[i].present) feeder.feed(frames[i].estimate);
+    }
+    feeder.finish();
+    FeatureSet fs;
+    for (int i = 0; i < (int)feeder.getAcceptedHypotheses().size(); ++i) {
+        CepstralPitchTracker::addFeaturesFrom
+            (feeder.getAcceptedHypotheses()[i], fs);
+    }
+    return fs;
+}
+
+static OfflineAnalyser::Frame
+frame(double freq, long sample, double confidence)
+{
+    OfflineAnalyser::Frame f;
+    f.estimate = NoteHypothesis::Estimate
+        (freq, RealTime::frame2RealTime(sample, rate), confidence);
+    f.present = true;
+    return f;
+}
+
+BOOST_AUTO_TEST_CASE(resetPoints)
+{
+    // 40ms is 1764 samples: a gap of exactly that is not long enough
+    // to reset, and negligible or missing estimates don't count
+    OfflineAnalyser::Frames frames;
+    frames.push_back(OfflineAnalyser::Frame());    // 0: missing
+    frames.push_back(frame(440, 0, 0.0));          // 1: negligible
+    frames.push_back(frame(440, 256, 0.5));        // 2: first: reset
+    frames.push_back(frame(440, 512, 0.5));        // 3
+    frames.push_back(frame(440, 2276, 0.5));       // 4: gap 1764
+    frames.push_back(frame(440, 4041, 0.0));       // 5: negligible
+    frames.push_back(OfflineAnalyser::Frame());    // 6: missing
+    frames.push_back(frame(440, 4041, 0.5));       // 7: gap 1765: reset
+    frames.push_back(frame(440, 4297, 0.5));       // 8
+
+    std::vector<int> resets = OfflineAnalyser::findResetPoints(frames);
+    BOOST_REQUIRE_EQUAL(resets.size(), 2);
+    BOOST_CHECK_EQUAL(resets[0], 2);
+    BOOST_CHECK_EQUAL(resets[1], 7);
+}
+
+BOOST_AUTO_TEST_CASE(splitTracking)
+{
+    // Random runs of estimates with gaps either side of the maximum,
+    // some negligible and some missing, tracked in parallel segments,
+    // must give exactly the serial result. Half the runs continue at
+    // the pitch of the one before, so that notes may span the gaps
+    unsigned int seed = 1;
+    long sample = 0;
+    double freq = 220;
+    OfflineAnalyser::Frames frames;
+
+    for (int run = 0; run < 400; ++run) {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 20) % 2) freq = 100 + (seed >> 16) % 500;
+        int length = 5 + (seed >> 8) % 60;
+        for (int i = 0; i < length; ++i) {
+            seed = seed * 1103515245 + 12345;
+            int r = (seed >> 16) % 100;
+            double confidence = (r < 10 ? 0.0 : r / 100.0);
+            double f = freq * (1.0 + ((seed >> 8) % 100 - 50) / 5000.0);
+            if (r < 5) {
+                frames.push_back(OfflineAnalyser::Frame());
+            } else {
+                frames.push_back(frame(f, sample, confidence));
+            }
+            sample += 256;
+        }
+        int gaps[] = { 256, 1500, 1764, 1765, 3000 };
+        sample += gaps[(seed >> 4) % 5] - 256;
+    }
+
+    std::vector<int> resets = OfflineAnalyser::findResetPoints(frames);
+    BOOST_CHECK(resets.size() > 50);
+
+    FeatureSet expected = trackSerially(frames);
+    BOOST_CHECK(expected[1].size() > 50);
+
+    int threads[] = { 1, 2, 7 };
+    for (int t = 0; t < 3; ++t) {
+        OfflineAnalyser analyser(rate, step, block, threads[t]);
+        FeatureSet actual = analyser.track(frames);
+        checkIdentical(expected, actual);
+    }
+
+    // And so must splitting at every reset point, rather than only
+    // at the few the analyser chooses
+    FeatureSet pieces;
+    resets[0] = 0;
+    resets.push_back(frames.size());
+    for (int r = 0; r + 1 < (int)resets.size(); ++r) {
+        OfflineAnalyser::Frames piece(frames.begin() + resets[r],
+                                      frames.begin() + resets[r + 1]);
+        FeatureSet fs = trackSerially(piece);
+        append(pieces, fs);
+    }
+    checkIdentical(expected, pieces);
+}
+
+BOOST_AUTO_TEST_CASE(splitSignals)
+{
+    // The same for the estimates from each test signal
+    for (int k = 0; k < SignalGenerator::KindCount; ++k) {
+        std::vector<float> s = signal(SignalGenerator::Kind(k));
+        OfflineAnalyser analyser(rate, step, block, 4);
+        OfflineAnalyser::Frames frames;
+        BOOST_REQUIRE(analyser.estimate(&s[0], length, frames));
+        FeatureSet expected = trackSerially(frames);
+        FeatureSet actual = analyser.track(frames);
+        checkIdentical(expected, actual);
+        if (k == SignalGenerator::Notes) {
+            BOOST_CHECK(OfflineAnalyser::findResetPoints(frames).size() > 4);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rules)
+{
+    // Tracking with other rules changes the notes, and the parallel
+    // tracking, split at the reset points for those rules, still
+    // gives exactly the serial result
+    std::vector<float> s = signal(SignalGenerator::Notes);
+    OfflineAnalyser analyser(rate, step, block, 3);
+    OfflineAnalyser::Frames frames;
+    BOOST_REQUIRE(analyser.estimate(&s[0], length, frames));
+    FeatureSet defaults = analyser.track(frames);
+
+    NoteHypothesis::Rules rules;
+    rules.lastTolerance = 20;
+    rules.meanTolerance = 30;
+    rules.maximumGap = RealTime::fromMilliseconds(100);
+    rules.requiredConfidence = 8.0;
+    analyser.setNoteRules(rules);
+
+    FeatureSet expected = trackSerially(frames, rules);
+    FeatureSet actual = analyser.track(frames);
+    checkIdentical(expected, actual);
+    BOOST_CHECK(!actual[1].empty());
+    BOOST_CHECK(actual[0].size() != defaults[0].size());
+
+    FeatureSet whole;
+    BOOST_REQUIRE(analyser.analyse(&s[0], length, whole));
+    checkIdentical(expected, whole);
+
+    // The reset points follow the gap allowed
+    OfflineAnalyser::Frames gapped;
+    gapped.push_back(frame(440, 0, 0.5));
+    gapped.push_back(frame(440, 1765, 0.5));       // 40ms: reset
+    gapped.push_back(frame(440, 6175, 0.5));       // 100ms
+    gapped.push_back(frame(440, 10586, 0.5));      // 100.02ms: reset
+    BOOST_CHECK_EQUAL(OfflineAnalyser::findResetPoints(gapped).size(), 4);
+    std::vector<int> resets = OfflineAnalyser::findResetPoints(gapped, rules);
+    BOOST_REQUIRE_EQUAL(resets.size(), 2);
+    BOOST_CHECK_EQUAL(resets[1], 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
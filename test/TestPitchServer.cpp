@@ -0,0 +1,410 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PitchServer.h"
+#include "OfflineAnalyser.h"
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using Vamp::RealTime;
+
+BOOST_AUTO_TEST_SUITE(TestPitchServer)
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+
+static const float rate = 44100;
+static const int block = 1024;
+static const int step = 256;
+
+// Events in the order the server sends them: f0 events have a zero
+// duration, and notes come after the f0 events of the same call
+struct Event {
+    bool note;
+    double time;
+    double duration;
+    double hz;
+    bool operator!=(const Event &e) const {
+        return note != e.note || time != e.time ||
+            duration != e.duration || hz != e.hz;
+    }
+};
+
+static std::ostream &
+operator<<(std::ostream &o, const Event &e)
+{
+    return o << (e.note ? "note " : "f0 ") << e.time << " "
+             << e.duration << " " << e.hz;
+}
+
+static double
+seconds(const RealTime &t)
+{
+    return t.sec + t.nsec / 1e9;
+}
+
+static string
+socketPath()
+{
+    char dirName[] = "/tmp/testserverXXXXXX";
+    BOOST_REQUIRE(mkdtemp(dirName));
+    return string(dirName) + "/socket";
+}
+
+// The client functions here avoid the test macros, which are not
+// thread-safe, and return false or -1 on failure instead
+static int
+tryConnect(string path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int
+connectTo(string path)
+{
+    int fd = tryConnect(path);
+    BOOST_REQUIRE(fd >= 0);
+    return fd;
+}
+
+static vector<float>
+signal(SignalGenerator::Kind kind, double secs)
+{
+    vector<float> s(long(rate * secs) + 77);
+    SignalGenerator gen(kind, rate);
+    gen.generate(&s[0], s.size());
+    return s;
+}
+
+static void
+addEvents(vector<Event> &events, FeatureSet &fs)
+{
+    for (int i = 0; i < (int)fs[0].size(); ++i) {
+        Event e = { false, seconds(fs[0][i].timestamp), 0.0,
+                    fs[0][i].values[0] };
+        events.push_back(e);
+    }
+    for (int i = 0; i < (int)fs[1].size(); ++i) {
+        Event e = { true, seconds(fs[1][i].timestamp),
+                    seconds(fs[1][i].duration), fs[1][i].values[0] };
+        events.push_back(e);
+    }
+}
+
+static bool
+sendStart(int fd, int inputKind, int blockSize = block,
+          float sampleRate = rate)
+{
+    char payload[16];
+    float r = sampleRate;
+    uint32_t values[3] = { uint32_t(blockSize), uint32_t(step),
+                           uint32_t(inputKind) };
+    memcpy(payload, &r, 4);
+    memcpy(payload + 4, values, 12);
+    return PitchServer::writeMessage(fd, PitchServer::Start, payload, 16);
+}
+
+// Read events until DONE, returning false if ERR or end of file
+// comes first
+static bool
+receive(int fd, vector<Event> &events)
+{
+    uint32_t tag;
+    vector<char> payload;
+    while (PitchServer::readMessage(fd, tag, payload)) {
+        double v[3] = { 0, 0, 0 };
+        if (tag == PitchServer::F0) {
+            if (payload.size() != 16) return false;
+            memcpy(v, &payload[0], 16);
+            Event e = { false, v[0], 0.0, v[1] };
+            events.push_back(e);
+        } else if (tag == PitchServer::Note) {
+            if (payload.size() != 24) return false;
+            memcpy(v, &payload[0], 24);
+            Event e = { true, v[0], v[1], v[2] };
+            events.push_back(e);
+        } else if (tag == PitchServer::Done) {
+            return true;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+// The events for a PCM stream arrive interleaved call by call, so
+// compare them by kind against the offline analysis
+static void
+checkPcmEvents(const vector<Event> &events, const vector<float> &s,
+               const NoteHypothesis::Rules &rules = NoteHypothesis::Rules())
+{
+    OfflineAnalyser analyser(rate, step, block, 1);
+    analyser.setNoteRules(rules);
+    FeatureSet fs;
+    BOOST_REQUIRE(analyser.analyse(&s[0], s.size(), fs));
+    vector<Event> expected;
+    addEvents(expected, fs);
+
+    vector<Event> sorted;
+    for (int i = 0; i < (int)events.size(); ++i) {
+        if (!events[i].note) sorted.push_back(events[i]);
+    }
+    for (int i = 0; i < (int)events.size(); ++i) {
+        if (events[i].note) sorted.push_back(events[i]);
+    }
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  sorted.begin(), sorted.end());
+}
+
+static bool
+streamPcm(int fd, const vector<float> &s, int chunk, vector<Event> &events)
+{
+    if (!sendStart(fd, PitchServer::PcmInput)) return false;
+    for (long i = 0; i < (long)s.size(); i += chunk) {
+        long n = std::min(long(chunk), long(s.size()) - i);
+        if (!PitchServer::writeMessage(fd, PitchServer::Pcm,
+                                       &s[i], n * sizeof(float))) {
+            return false;
+        }
+    }
+    if (!PitchServer::writeMessage(fd, PitchServer::End, 0, 0)) return false;
+    return receive(fd, events);
+}
+
+BOOST_AUTO_TEST_CASE(pcmStream)
+{
+    string path = socketPath();
+    PitchServer server(path, 2);
+    BOOST_REQUIRE(server.start());
+
+    vector<float> s = signal(SignalGenerator::Notes, 3.0);
+
+    // Chunks smaller than, between, and larger than the block size,
+    // and a second stream on the same connection
+    int fd = connectTo(path);
+    int chunks[] = { 100, 1000, 7777 };
+    for (int i = 0; i < 3; ++i) {
+        vector<Event> events;
+        BOOST_REQUIRE(streamPcm(fd, s, chunks[i], events));
+        BOOST_CHECK(events.size() > 100);
+        checkPcmEvents(events, s);
+    }
+    close(fd);
+
+    server.stop();
+    BOOST_CHECK(access(path.c_str(), F_OK) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(rules)
+{
+    // Streams are tracked with the rules the server is given
+    NoteHypothesis::Rules rules;
+    rules.lastTolerance = 20;
+    rules.requiredConfidence = 8.0;
+
+    string path = socketPath();
+    PitchServer server(path, 1);
+    server.setNoteRules(rules);
+    BOOST_REQUIRE(server.start());
+
+    vector<float> s = signal(SignalGenerator::Notes, 3.0);
+    int fd = connectTo(path);
+    vector<Event> events;
+    BOOST_REQUIRE(streamPcm(fd, s, 4096, events));
+    close(fd);
+    BOOST_CHECK(!events.empty());
+    checkPcmEvents(events, s, rules);
+}
+
+BOOST_AUTO_TEST_CASE(spectrumStream)
+{
+    string path = socketPath();
+    PitchServer server(path, 1);
+    server.setParameter("skip", 4);
+    BOOST_REQUIRE(server.start());
+
+    vector<float> s = signal(SignalGenerator::Vibrato, 3.0);
+    int frames = (s.size() - block) / step;
+
+    CepstralPitchTracker tracker(rate);
+    tracker.setParameter("skip", 4);
+    BOOST_REQUIRE(tracker.initialise(1, step, block));
+
+    int fd = connectTo(path);
+    BOOST_REQUIRE(sendStart(fd, PitchServer::SpectrumInput));
+
+    Stft stft(block);
+    vector<char> payload(8 + (block + 2) * sizeof(float));
+    vector<Event> expected;
+
+    for (int i = 0; i < frames; ++i) {
+        float *spectrum = (float *)&payload[8];
+        stft.process(&s[i * step], spectrum);
+        RealTime t = RealTime::frame2RealTime(i * step + block/2, rate);
+        double secs = seconds(t);
+        memcpy(&payload[0], &secs, 8);
+        BOOST_REQUIRE(PitchServer::writeMessage
+                      (fd, PitchServer::Spectrum,
+                       &payload[0], payload.size()));
+        const float *in = spectrum;
+        FeatureSet fs = tracker.process(&in, RealTime::fromSeconds(secs));
+        addEvents(expected, fs);
+    }
+    FeatureSet fs = tracker.getRemainingFeatures();
+    addEvents(expected, fs);
+
+    BOOST_REQUIRE(PitchServer::writeMessage(fd, PitchServer::End, 0, 0));
+    vector<Event> events;
+    BOOST_REQUIRE(receive(fd, events));
+    close(fd);
+
+    BOOST_CHECK(!expected.empty());
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
+                                  events.begin(), events.end());
+}
+
+BOOST_AUTO_TEST_CASE(concurrentClients)
+{
+    // More clients than the server handles at once, so that some
+    // wait to be accepted, and of other formats than the pooled one
+    string path = socketPath();
+    PitchServer server(path, 2);
+    server.setPooledFormat(rate, 2048, 512);
+    BOOST_REQUIRE(server.start());
+
+    const int clients = 6;
+    vector<vector<float> > signals(clients);
+    vector<vector<Event> > results(clients);
+    bool ok[clients];
+    vector<std::thread> threads;
+
+    for (int i = 0; i < clients; ++i) {
+        signals[i] = signal(SignalGenerator::Kind
+                            (i % SignalGenerator::KindCount), 2.0);
+        ok[i] = false;
+    }
+    for (int i = 0; i < clients; ++i) {
+        threads.push_back(std::thread([&, i]() {
+            int fd = tryConnect(path);
+            if (fd < 0) return;
+            ok[i] = streamPcm(fd, signals[i], 4096, results[i]);
+            close(fd);
+        }));
+    }
+    for (int i = 0; i < clients; ++i) {
+        threads[i].join();
+    }
+
+    for (int i = 0; i < clients; ++i) {
+        BOOST_REQUIRE(ok[i]);
+        checkPcmEvents(results[i], signals[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(errors)
+{
+    string path = socketPath();
+    PitchServer server(path, 1);
+    BOOST_REQUIRE(server.start());
+
+    int fd = connectTo(path);
+    vector<Event> events;
+    float sample = 0.f;
+
+    // Data before any stream is started
+    BOOST_REQUIRE(PitchServer::writeMessage
+                  (fd, PitchServer::Pcm, &sample, sizeof(sample)));
+    BOOST_CHECK(!receive(fd, events));
+
+    // A block size that is not a power of two
+    BOOST_REQUIRE(sendStart(fd, PitchServer::PcmInput, 1000));
+    BOOST_CHECK(!receive(fd, events));
+
+    // Block sizes beyond the limit, refused before allocating
+    BOOST_REQUIRE(sendStart(fd, PitchServer::PcmInput,
+                            PitchServer::MaxBlockSize * 2));
+    BOOST_CHECK(!receive(fd, events));
+    BOOST_REQUIRE(sendStart(fd, PitchServer::SpectrumInput, 1 << 30));
+    BOOST_CHECK(!receive(fd, events));
+
+    // Sample rates that are not a number or out of range
+    BOOST_REQUIRE(sendStart(fd, PitchServer::PcmInput, block, NAN));
+    BOOST_CHECK(!receive(fd, events));
+    BOOST_REQUIRE(sendStart(fd, PitchServer::PcmInput, block, 1e9f));
+    BOOST_CHECK(!receive(fd, events));
+
+    // A spectrum of the wrong size, which abandons the stream
+    BOOST_REQUIRE(sendStart(fd, PitchServer::SpectrumInput));
+    vector<char> payload(8 + block * sizeof(float));
+    BOOST_REQUIRE(PitchServer::writeMessage
+                  (fd, PitchServer::Spectrum, &payload[0], payload.size()));
+    BOOST_CHECK(!receive(fd, events));
+    BOOST_REQUIRE(PitchServer::writeMessage(fd, PitchServer::End, 0, 0));
+    BOOST_CHECK(!receive(fd, events));
+
+    // The connection is still usable after all that
+    BOOST_CHECK(events.empty());
+    vector<float> s = signal(SignalGenerator::Notes, 1.5);
+    BOOST_REQUIRE(streamPcm(fd, s, 512, events));
+    checkPcmEvents(events, s);
+
+    // Stopping closes a connection still open
+    server.stop();
+    uint32_t tag;
+    vector<char> reply;
+    BOOST_CHECK(!PitchServer::readMessage(fd, tag, reply));
+    close(fd);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,362 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PitchTrackerEngine.h"
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+using Vamp::RealTime;
+
+BOOST_AUTO_TEST_SUITE(TestPitchTrackerEngine)
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+typedef std::map<std::string, float> Params;
+typedef PitchTrackerEngine::Pitch Pitch;
+typedef PitchTrackerEngine::Note Note;
+
+static const float rate = 44100;
+static const int block = 1024;
+static const int step = 256;
+static const int fdsize = block + 2;
+static const int frames = 4 * rate / step;
+
+static std::vector<float>
+spectra(SignalGenerator::Kind kind)
+{
+    std::vector<float> signal(frames * step + block, 0.f);
+    SignalGenerator gen(kind, rate);
+    gen.generate(&signal[0], frames * step);
+    std::vector<float> out(frames * fdsize);
+    Stft stft(block);
+    for (int i = 0; i < frames; ++i) {
+        stft.process(&signal[i * step], &out[i * fdsize]);
+    }
+    return out;
+}
+
+static RealTime
+timeOf(int i)
+{
+    return RealTime::frame2RealTime(long(i) * step + block/2, rate);
+}
+
+static void
+setParameters(PitchTrackerEngine &engine, const Params &params)
+{
+    // Through the plugin, so as to check its parameter mapping too
+    CepstralPitchTracker tracker(rate);
+    for (Params::const_iterator i = params.begin(); i != params.end(); ++i) {
+        tracker.setParameter(i->first, i->second);
+    }
+    engine.setBandLimit(tracker.getParameter("bandlimit"));
+    engine.setSkip(int(tracker.getParameter("skip")));
+    engine.setRefine(int(tracker.getParameter("refine")));
+    engine.setDual(tracker.getParameter("dual") > 0.5f);
+    engine.setNarrow(tracker.getParameter("narrow") > 0.5f);
+}
+
+static void
+append(FeatureSet &to, FeatureSet &from)
+{
+    for (int o = 0; o < 2; ++o) {
+        to[o].insert(to[o].end(), from[o].begin(), from[o].end());
+    }
+}
+
+static FeatureSet
+runPlugin(const std::vector<float> &sp, const Params &params)
+{
+    CepstralPitchTracker tracker(rate);
+    for (Params::const_iterator i = params.begin(); i != params.end(); ++i) {
+        tracker.setParameter(i->first, i->second);
+    }
+    tracker.initialise(1, step, block);
+    FeatureSet all;
+    for (int i = 0; i < frames; ++i) {
+        const float *in = &sp[i * fdsize];
+        FeatureSet fs = tracker.process(&in, timeOf(i));
+        append(all, fs);
+    }
+    FeatureSet fs = tracker.getRemainingFeatures();
+    append(all, fs);
+    return all;
+}
+
+// Run the engine, reading at most the given number of records of
+// each kind after each frame, and everything at the end
+static void
+runEngine(PitchTrackerEngine &engine, const std::vector<float> &sp,
+          int capacity, std::vector<Pitch> &pitches, std::vector<Note> &notes)
+{
+    std::vector<Pitch> pbuf(capacity);
+    std::vector<Note> nbuf(capacity);
+    for (int i = 0; i < frames; ++i) {
+        BOOST_REQUIRE(engine.process(&sp[i * fdsize], fdsize, timeOf(i)));
+        int n = engine.readPitches(&pbuf[0], capacity);
+        pitches.insert(pitches.end(), pbuf.begin(), pbuf.begin() + n);
+        n = engine.readNotes(&nbuf[0], capacity);
+        notes.insert(notes.end(), nbuf.begin(), nbuf.begin() + n);
+    }
+    engine.finish();
+    int n;
+    while ((n = engine.readPitches(&pbuf[0], capacity)) > 0) {
+        pitches.insert(pitches.end(), pbuf.begin(), pbuf.begin() + n);
+    }
+    while ((n = engine.readNotes(&nbuf[0], capacity)) > 0) {
+        notes.insert(notes.end(), nbuf.begin(), nbuf.begin() + n);
+    }
+    BOOST_CHECK_EQUAL(engine.getPitchCount(), 0);
+    BOOST_CHECK_EQUAL(engine.getNoteCount(), 0);
+}
+
+static void
+checkMatches(FeatureSet &expected, const std::vector<Pitch> &pitches,
+             const std::vector<Note> &notes)
+{
+    BOOST_REQUIRE_EQUAL(pitches.size(), expected[0].size());
+    for (int i = 0; i < (int)pitches.size(); ++i) {
+        BOOST_CHECK_EQUAL(pitches[i].time, expected[0][i].timestamp);
+        BOOST_CHECK_EQUAL(float(pitches[i].freq), expected[0][i].values[0]);
+        BOOST_CHECK(pitches[i].confidence > 0.0);
+    }
+    BOOST_REQUIRE_EQUAL(notes.size(), expected[1].size());
+    for (int i = 0; i < (int)notes.size(); ++i) {
+        BOOST_CHECK_EQUAL(notes[i].time, expected[1][i].timestamp);
+        BOOST_CHECK_EQUAL(notes[i].duration, expected[1][i].duration);
+        BOOST_CHECK_EQUAL(float(notes[i].freq), expected[1][i].values[0]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(matchesPlugin)
+{
+    std::vector<Params> sets(5);
+    sets[1]["skip"] = 4;
+    sets[2]["narrow"] = 1;
+    sets[3]["dual"] = 1;
+    sets[3]["refine"] = 4;
+    sets[4]["bandlimit"] = 5000;
+
+    for (int k = 0; k < SignalGenerator::KindCount; ++k) {
+        std::vector<float> sp = spectra(SignalGenerator::Kind(k));
+        for (int p = 0; p < (int)sets.size(); ++p) {
+            FeatureSet expected = runPlugin(sp, sets[p]);
+            PitchTrackerEngine engine(rate);
+            setParameters(engine, sets[p]);
+            BOOST_REQUIRE(engine.initialise(step, block));
+            std::vector<Pitch> pitches;
+            std::vector<Note> notes;
+            runEngine(engine, sp, 1000, pitches, notes);
+            checkMatches(expected, pitches, notes);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(smallBuffers)
+{
+    // Records that do not fit stay queued, in order, so reading a
+    // few at a time gives the same as reading everything at once
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    FeatureSet expected = runPlugin(sp, Params());
+    BOOST_CHECK(expected[1].size() > 4);
+
+    int capacities[] = { 1, 3 };
+    for (int c = 0; c < 2; ++c) {
+        PitchTrackerEngine engine(rate);
+        BOOST_REQUIRE(engine.initialise(step, block));
+        std::vector<Pitch> pitches;
+        std::vector<Note> notes;
+        runEngine(engine, sp, capacities[c], pitches, notes);
+        checkMatches(expected, pitches, notes);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(resetAndReuse)
+{
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    FeatureSet expected = runPlugin(sp, Params());
+
+    PitchTrackerEngine engine(rate);
+    BOOST_REQUIRE(engine.initialise(step, block));
+
+    // Abandon a run part way, leaving records unread
+    for (int i = 0; i < frames / 2; ++i) {
+        engine.process(&sp[i * fdsize], fdsize, timeOf(i));
+    }
+    BOOST_CHECK(engine.getPitchCount() > 0);
+    engine.reset();
+    BOOST_CHECK_EQUAL(engine.getPitchCount(), 0);
+    BOOST_CHECK_EQUAL(engine.getNoteCount(), 0);
+
+    std::vector<Pitch> pitches;
+    std::vector<Note> notes;
+    runEngine(engine, sp, 16, pitches, notes);
+    checkMatches(expected, pitches, notes);
+}
+
+BOOST_AUTO_TEST_CASE(invalidInput)
+{
+    std::vector<float> sp = spectra(SignalGenerator::Sine);
+    PitchTrackerEngine engine(rate);
+
+    // Not yet initialised
+    BOOST_CHECK(!engine.process(&sp[0], fdsize, timeOf(0)));
+
+    BOOST_CHECK(!engine.initialise(0, block));
+    BOOST_CHECK(!engine.initialise(step, 1000));
+    CepstralPitchTracker tracker(rate);
+    BOOST_CHECK(!tracker.initialise(1, step, 1000));
+    BOOST_REQUIRE(engine.initialise(step, block));
+    BOOST_CHECK(!engine.process(&sp[0], block, timeOf(0)));
+    BOOST_CHECK(!engine.process(&sp[0], fdsize + 1, timeOf(0)));
+    BOOST_CHECK(engine.process(&sp[0], fdsize, timeOf(0)));
+}
+
+BOOST_AUTO_TEST_CASE(pluginChannels)
+{
+    // Each channel of the plugin is tracked by its own engine, with
+    // the plugin's parameters
+    Params params;
+    params["skip"] = 3;
+    std::vector<float> a = spectra(SignalGenerator::Notes);
+    std::vector<float> b = spectra(SignalGenerator::Vibrato);
+
+    CepstralPitchTracker tracker(rate);
+    tracker.setParameter("skip", 3);
+    BOOST_REQUIRE(tracker.initialise(2, step, block));
+    Vamp::Plugin::OutputList outputs = tracker.getOutputDescriptors();
+    int second = outputs.size() - 2;
+    BOOST_CHECK_EQUAL(outputs[second].identifier, "f0-2");
+
+    FeatureSet all;
+    for (int i = 0; i < frames; ++i) {
+        const float *in[2] = { &a[i * fdsize], &b[i * fdsize] };
+        FeatureSet fs = tracker.process(in, timeOf(i));
+        for (FeatureSet::iterator j = fs.begin(); j != fs.end(); ++j) {
+            all[j->first].insert(all[j->first].end(),
+                                 j->second.begin(), j->second.end());
+        }
+    }
+    FeatureSet fs = tracker.getRemainingFeatures();
+    for (FeatureSet::iterator j = fs.begin(); j != fs.end(); ++j) {
+        all[j->first].insert(all[j->first].end(),
+                             j->second.begin(), j->second.end());
+    }
+
+    for (int c = 0; c < 2; ++c) {
+        PitchTrackerEngine engine(rate);
+        setParameters(engine, params);
+        BOOST_REQUIRE(engine.initialise(step, block));
+        std::vector<Pitch> pitches;
+        std::vector<Note> notes;
+        runEngine(engine, c == 0 ? a : b, 100, pitches, notes);
+        FeatureSet expected;
+        int base = (c == 0 ? 0 : second);
+        expected[0] = all[base];
+        expected[1] = all[base + 1];
+        BOOST_CHECK(!expected[1].empty());
+        checkMatches(expected, pitches, notes);
+    }
+}
+
+class CollectingSink : public ResultSink
+{
+public:
+    CollectingSink() : inNote(false), ok(true) { }
+
+    std::vector<Pitch> pitches;
+    std::vector<Note> notes;
+    bool inNote;
+    bool ok;
+
+    void onNoteOn(const Note &) {
+        if (inNote) ok = false;
+        inNote = true;
+    }
+    void onEstimate(const Pitch &p) {
+        if (!inNote) ok = false;
+        pitches.push_back(p);
+    }
+    void onNoteComplete(const Note &n) {
+        if (!inNote) ok = false;
+        inNote = false;
+        notes.push_back(n);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(resultSink)
+{
+    // With a sink, the plugin returns no features, and the sink gets
+    // the same results the features would have held
+    Params params;
+    params["skip"] = 2;
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    FeatureSet expected = runPlugin(sp, params);
+    BOOST_CHECK(expected[1].size() > 4);
+
+    CepstralPitchTracker tracker(rate);
+    CollectingSink sink;
+    tracker.setResultSink(&sink);
+    tracker.setParameter("skip", 2);
+    BOOST_REQUIRE(tracker.initialise(1, step, block));
+
+    for (int i = 0; i < frames; ++i) {
+        const float *in = &sp[i * fdsize];
+        FeatureSet fs = tracker.process(&in, timeOf(i));
+        BOOST_CHECK(fs[0].empty() && fs[1].empty());
+    }
+    FeatureSet fs = tracker.getRemainingFeatures();
+    BOOST_CHECK(fs[0].empty() && fs[1].empty());
+
+    BOOST_CHECK(sink.ok);
+    BOOST_CHECK(!sink.inNote);
+    checkMatches(expected, sink.pitches, sink.notes);
+
+    // And unsetting it goes back to features
+    tracker.setResultSink(0);
+    tracker.reset();
+    FeatureSet all;
+    for (int i = 0; i < frames; ++i) {
+        const float *in = &sp[i * fdsize];
+        FeatureSet fs = tracker.process(&in, timeOf(i));
+        append(all, fs);
+    }
+    fs = tracker.getRemainingFeatures();
+    append(all, fs);
+    BOOST_CHECK_EQUAL(all[1].size(), expected[1].size());
+    BOOST_CHECK_EQUAL(sink.notes.size(), expected[1].size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "SpscQueue.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(TestSpscQueue)
+
+BOOST_AUTO_TEST_CASE(fillAndEmpty)
+{
+    SpscQueue<int> q(3);
+    BOOST_CHECK_EQUAL(q.getCapacity(), 3);
+    BOOST_CHECK(!q.getReadSlot());
+    for (int i = 0; i < 3; ++i) {
+        int *slot = q.getWriteSlot();
+        BOOST_REQUIRE(slot);
+        *slot = i;
+        q.push();
+    }
+    BOOST_CHECK(!q.getWriteSlot());
+    BOOST_CHECK_EQUAL(q.getSize(), 3);
+    for (int i = 0; i < 3; ++i) {
+        int *slot = q.getReadSlot();
+        BOOST_REQUIRE(slot);
+        BOOST_CHECK_EQUAL(*slot, i);
+        q.pop();
+    }
+    BOOST_CHECK(!q.getReadSlot());
+    BOOST_CHECK_EQUAL(q.getSize(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(slotsKeepStorage)
+{
+    // Elements start as copies of the prototype, and a slot that
+    // comes round again still has the buffer it had before
+    SpscQueue<std::vector<float> > q(2, std::vector<float>(10));
+    std::vector<float> *slot = q.getWriteSlot();
+    BOOST_CHECK_EQUAL(slot->size(), 10);
+    const float *data = &(*slot)[0];
+    bool seen = false;
+    for (int i = 0; i < 4; ++i) {
+        q.push();
+        q.pop();
+        slot = q.getWriteSlot();
+        BOOST_CHECK_EQUAL(slot->size(), 10);
+        if (&(*slot)[0] == data) seen = true;
+    }
+    BOOST_CHECK(seen);
+}
+
+BOOST_AUTO_TEST_CASE(acrossThreads)
+{
+    // Everything pushed arrives, in order, through a queue much
+    // smaller than the number of elements
+    const int n = 200000;
+    SpscQueue<int> q(7);
+    std::vector<int> received;
+    received.reserve(n);
+
+    std::thread consumer([&]() {
+        while ((int)received.size() < n) {
+            int *slot = q.getReadSlot();
+            if (!slot) {
+                std::this_thread::yield();
+                continue;
+            }
+            received.push_back(*slot);
+            q.pop();
+        }
+    });
+
+    for (int i = 0; i < n; ) {
+        int *slot = q.getWriteSlot();
+        if (!slot) {
+            std::this_thread::yield();
+            continue;
+        }
+        *slot = i++;
+        q.push();
+    }
+
+    consumer.join();
+
+    BOOST_REQUIRE_EQUAL((int)received.size(), n);
+    for (int i = 0; i < n; ++i) {
+        if (received[i] != i) BOOST_FAIL("element out of order");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,222 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "StreamingPipeline.h"
+#include "CepstralPitchTracker.h"
+#include "Stft.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+using Vamp::RealTime;
+
+BOOST_AUTO_TEST_SUITE(TestStreamingPipeline)
+
+typedef Vamp::Plugin::FeatureSet FeatureSet;
+typedef std::map<std::string, float> Params;
+
+static const float rate = 44100;
+static const int block = 1024;
+static const int step = 256;
+static const int frames = 5 * rate / step;
+
+static std::vector<float>
+spectra(SignalGenerator::Kind kind)
+{
+    std::vector<float> signal(frames * step + block, 0.f);
+    SignalGenerator gen(kind, rate);
+    gen.generate(&signal[0], frames * step);
+    std::vector<float> out(frames * (block + 2));
+    Stft stft(block);
+    for (int i = 0; i < frames; ++i) {
+        stft.process(&signal[i * step], &out[i * (block + 2)]);
+    }
+    return out;
+}
+
+static RealTime
+timeOf(int i)
+{
+    return RealTime::frame2RealTime(long(i) * step + block/2, rate);
+}
+
+static void
+append(FeatureSet &to, FeatureSet &from)
+{
+    for (int o = 0; o < 2; ++o) {
+        to[o].insert(to[o].end(), from[o].begin(), from[o].end());
+    }
+}
+
+static FeatureSet
+runPlugin(const std::vector<float> &sp, const Params &params,
+          const NoteHypothesis::Rules &rules = NoteHypothesis::Rules())
+{
+    CepstralPitchTracker tracker(rate);
+    for (Params::const_iterator i = params.begin(); i != params.end(); ++i) {
+        tracker.setParameter(i->first, i->second);
+    }
+    tracker.setNoteRules(rules);
+    tracker.initialise(1, step, block);
+    FeatureSet all;
+    for (int i = 0; i < frames; ++i) {
+        const float *in = &sp[i * (block + 2)];
+        FeatureSet fs = tracker.process(&in, timeOf(i));
+        append(all, fs);
+    }
+    FeatureSet fs = tracker.getRemainingFeatures();
+    append(all, fs);
+    return all;
+}
+
+static FeatureSet
+runPipeline(StreamingPipeline &pipeline, const std::vector<float> &sp)
+{
+    FeatureSet all;
+    for (int i = 0; i < frames; ++i) {
+        FeatureSet fs = pipeline.process(&sp[i * (block + 2)], timeOf(i));
+        append(all, fs);
+    }
+    FeatureSet fs = pipeline.finish();
+    append(all, fs);
+    return all;
+}
+
+static void
+checkIdentical(FeatureSet &expected, FeatureSet &actual)
+{
+    for (int o = 0; o < 2; ++o) {
+        BOOST_REQUIRE_EQUAL(actual[o].size(), expected[o].size());
+        for (int i = 0; i < (int)expected[o].size(); ++i) {
+            BOOST_CHECK_EQUAL(actual[o][i].timestamp, expected[o][i].timestamp);
+            BOOST_CHECK_EQUAL(actual[o][i].duration, expected[o][i].duration);
+            BOOST_CHECK(actual[o][i].values == expected[o][i].values);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(matchesPlugin)
+{
+    Params params;
+    params["dual"] = 1;
+    params["refine"] = 4;
+    Params none;
+
+    for (int k = 0; k < SignalGenerator::KindCount; ++k) {
+        std::vector<float> sp = spectra(SignalGenerator::Kind(k));
+        for (int p = 0; p < 2; ++p) {
+            const Params &pp = (p == 0 ? none : params);
+            FeatureSet expected = runPlugin(sp, pp);
+            StreamingPipeline pipeline(rate, step, block);
+            for (Params::const_iterator i = pp.begin(); i != pp.end(); ++i) {
+                pipeline.setParameter(i->first, i->second);
+            }
+            BOOST_REQUIRE(pipeline.start());
+            FeatureSet actual = runPipeline(pipeline, sp);
+            checkIdentical(expected, actual);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shallowQueues)
+{
+    // Queues of a single frame, so that every stage keeps waiting on
+    // the next, and the caller on all of them
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    FeatureSet expected = runPlugin(sp, Params());
+    BOOST_CHECK(!expected[1].empty());
+
+    StreamingPipeline pipeline(rate, step, block, 1);
+    BOOST_REQUIRE(pipeline.start());
+    FeatureSet actual = runPipeline(pipeline, sp);
+    checkIdentical(expected, actual);
+}
+
+BOOST_AUTO_TEST_CASE(tryProcessAndRestart)
+{
+    // Frames refused by tryProcess() can be offered again, and the
+    // pipeline gives the same result when started again
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    FeatureSet expected = runPlugin(sp, Params());
+
+    StreamingPipeline pipeline(rate, step, block, 2);
+    BOOST_REQUIRE(pipeline.start());
+    BOOST_CHECK(!pipeline.start());
+
+    FeatureSet actual;
+    for (int i = 0; i < frames; ) {
+        if (pipeline.tryProcess(&sp[i * (block + 2)], timeOf(i), actual)) {
+            ++i;
+        }
+    }
+    FeatureSet fs = pipeline.finish();
+    append(actual, fs);
+    checkIdentical(expected, actual);
+
+    BOOST_REQUIRE(pipeline.start());
+    FeatureSet again = runPipeline(pipeline, sp);
+    checkIdentical(expected, again);
+}
+
+BOOST_AUTO_TEST_CASE(rules)
+{
+    // The pipeline tracks with the rules it is given, as the plugin
+    // does
+    std::vector<float> sp = spectra(SignalGenerator::Notes);
+    NoteHypothesis::Rules rules;
+    rules.lastTolerance = 20;
+    rules.requiredConfidence = 8.0;
+    FeatureSet expected = runPlugin(sp, Params(), rules);
+    BOOST_CHECK(!expected[1].empty());
+    BOOST_CHECK(expected[0].size() != runPlugin(sp, Params())[0].size());
+
+    StreamingPipeline pipeline(rate, step, block);
+    pipeline.setNoteRules(rules);
+    BOOST_REQUIRE(pipeline.start());
+    FeatureSet actual = runPipeline(pipeline, sp);
+    checkIdentical(expected, actual);
+}
+
+BOOST_AUTO_TEST_CASE(dependentEstimates)
+{
+    StreamingPipeline pipeline(rate, step, block);
+    pipeline.setParameter("skip", 2);
+    BOOST_CHECK(!pipeline.start());
+    std::vector<float> sp(block + 2, 0.f);
+    FeatureSet fs = pipeline.process(&sp[0], timeOf(0));
+    BOOST_CHECK(fs.empty());
+    fs = pipeline.finish();
+    BOOST_CHECK(fs.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
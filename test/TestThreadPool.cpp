@@ -0,0 +1,84 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ThreadPool.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(TestThreadPool)
+
+class Recorder : public ThreadPool::Task
+{
+public:
+    Recorder(int n) : counts(n, 0) { }
+    void run(int index) { counts[index]++; }
+    std::vector<int> counts;
+};
+
+BOOST_AUTO_TEST_CASE(singleThread)
+{
+    ThreadPool pool(1);
+    BOOST_CHECK_EQUAL(pool.getThreadCount(), 1);
+    Recorder r(5);
+    pool.run(r, 5);
+    for (int i = 0; i < 5; ++i) BOOST_CHECK_EQUAL(r.counts[i], 1);
+}
+
+BOOST_AUTO_TEST_CASE(eachIndexOnce)
+{
+    ThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.getThreadCount(), 4);
+    Recorder r(1000);
+    pool.run(r, 1000);
+    for (int i = 0; i < 1000; ++i) BOOST_CHECK_EQUAL(r.counts[i], 1);
+}
+
+BOOST_AUTO_TEST_CASE(fewerIndicesThanThreads)
+{
+    ThreadPool pool(8);
+    Recorder r(3);
+    pool.run(r, 3);
+    for (int i = 0; i < 3; ++i) BOOST_CHECK_EQUAL(r.counts[i], 1);
+    Recorder none(0);
+    pool.run(none, 0);
+}
+
+BOOST_AUTO_TEST_CASE(repeatedRuns)
+{
+    // The pool is reused across many runs, as it is per frame
+    ThreadPool pool(3);
+    Recorder r(16);
+    for (int j = 0; j < 500; ++j) {
+        pool.run(r, 16);
+    }
+    for (int i = 0; i < 16; ++i) BOOST_CHECK_EQUAL(r.counts[i], 500);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,279 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+/*
+    This file is Copyright (c) 2012 Chris Cannam
+  
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "TrackFile.h"
+#include "OfflineAnalyser.h"
+
+#include "bench/SignalGenerator.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using Vamp::RealTime;
+
+BOOST_AUTO_TEST_SUITE(TestTrackFile)
+
+typedef OfflineAnalyser::FeatureSet FeatureSet;
+typedef TrackFile::Pitch Pitch;
+typedef TrackFile::Note Note;
+
+static const float rate = 44100;
+static const int block = 1024;
+static const int step = 256;
+
+static std::vector<float>
+signal(SignalGenerator::Kind kind, double seconds)
+{
+    std::vector<float> s(long(seconds * rate));
+    SignalGenerator gen(kind, rate);
+    gen.generate(&s[0], s.size());
+    return s;
+}
+
+struct Results {
+    NoteHypothesis::Estimates pitches;
+    OfflineAnalyser::Notes notes;
+};
+
+static Results
+analyse(const std::vector<float> &s)
+{
+    OfflineAnalyser analyser(rate, step, block, 2);
+    Results r;
+    BOOST_REQUIRE(analyser.analyse(&s[0], s.size(), r.pitches, r.notes));
+    return r;
+}
+
+struct TempFile {
+    TempFile() {
+        char name[] = "/tmp/testtrackfileXXXXXX";
+        int fd = mkstemp(name);
+        path = name;
+        out = (fd >= 0 ? fdopen(fd, "wb") : 0);
+    }
+    ~TempFile() {
+        if (out) fclose(out);
+        unlink(path.c_str());
+    }
+    void finish() {
+        fclose(out);
+        out = 0;
+    }
+    long size() const {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? long(st.st_size) : -1;
+    }
+    std::string path;
+    FILE *out;
+};
+
+static double
+cents(double a, double b)
+{
+    return fabs(1200.0 * log2(a / b));
+}
+
+BOOST_AUTO_TEST_CASE(recordsMatchFeatures)
+{
+    // The records from OfflineAnalyser match its features, in the
+    // parallel and the serial analysis
+    std::vector<float> s = signal(SignalGenerator::Notes, 6.0);
+
+    for (int skip = 1; skip <= 2; ++skip) {
+        OfflineAnalyser analyser(rate, step, block, 2);
+        analyser.setParameter("skip", skip);
+        FeatureSet features;
+        BOOST_REQUIRE(analyser.analyse(&s[0], s.size(), features));
+        Results r;
+        BOOST_REQUIRE(analyser.analyse(&s[0], s.size(), r.pitches, r.notes));
+
+        BOOST_CHECK(r.notes.size() > 4);
+        BOOST_REQUIRE_EQUAL(r.pitches.size(), features[0].size());
+        for (int i = 0; i < (int)r.pitches.size(); ++i) {
+            BOOST_CHECK_EQUAL(r.pitches[i].time, features[0][i].timestamp);
+            BOOST_CHECK_EQUAL(float(r.pitches[i].freq),
+                              features[0][i].values[0]);
+            BOOST_CHECK(r.pitches[i].confidence > 0.0);
+        }
+        BOOST_REQUIRE_EQUAL(r.notes.size(), features[1].size());
+        for (int i = 0; i < (int)r.notes.size(); ++i) {
+            BOOST_CHECK_EQUAL(r.notes[i].time, features[1][i].timestamp);
+            BOOST_CHECK_EQUAL(r.notes[i].duration, features[1][i].duration);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(roundTrip)
+{
+    std::vector<float> s = signal(SignalGenerator::Notes, 6.0);
+    Results r = analyse(s);
+    BOOST_REQUIRE(r.notes.size() > 4);
+
+    for (int e = 0; e < 2; ++e) {
+
+        TrackFile::Encoding encoding = TrackFile::Encoding(e);
+        TempFile tmp;
+        BOOST_REQUIRE(tmp.out);
+        BOOST_REQUIRE(TrackFile::write(tmp.out, rate, step, block, encoding,
+                                       r.pitches, r.notes));
+        tmp.finish();
+
+        // Header, two bytes of delta, two or four of f0 and four of
+        // confidence per estimate, a record per note, and padding
+        long expected = 72 + 24 * r.notes.size() +
+            (e == 0 ? 10 : 8) * r.pitches.size();
+        BOOST_CHECK(tmp.size() >= expected && tmp.size() < expected + 24);
+
+        TrackFile f;
+        BOOST_REQUIRE_MESSAGE(f.open(tmp.path), f.getError());
+        BOOST_CHECK_EQUAL(f.getSampleRate(), rate);
+        BOOST_CHECK_EQUAL(f.getStepSize(), step);
+        BOOST_CHECK_EQUAL(f.getBlockSize(), block);
+        BOOST_CHECK_EQUAL(f.getEncoding(), encoding);
+        BOOST_CHECK_EQUAL(f.getPitchCount(), int(r.pitches.size()));
+        BOOST_REQUIRE_EQUAL(f.getNoteCount(), int(r.notes.size()));
+        BOOST_CHECK(e == 0 ? f.getFrequencies() && !f.getCents() :
+                    !f.getFrequencies() && f.getCents());
+
+        std::vector<Pitch> buffer(1000);
+        int p = 0;
+
+        for (int i = 0; i < f.getNoteCount(); ++i) {
+            Note n = f.getNote(i);
+            BOOST_CHECK_EQUAL(n.time, r.notes[i].time);
+            BOOST_CHECK_EQUAL(n.duration, r.notes[i].duration);
+            BOOST_CHECK_EQUAL(n.freq, float(r.notes[i].freq));
+
+            int count = f.readPitches(i, &buffer[0], buffer.size());
+            BOOST_CHECK_EQUAL(count, int(f.getNoteRecords()[i].pitchCount));
+            BOOST_REQUIRE(p + count <= int(r.pitches.size()));
+            for (int j = 0; j < count; ++j, ++p) {
+                const Pitch &expected = r.pitches[p];
+                BOOST_CHECK_EQUAL(buffer[j].time, expected.time);
+                if (e == 0) {
+                    BOOST_CHECK_EQUAL(buffer[j].freq, float(expected.freq));
+                } else {
+                    BOOST_CHECK(cents(buffer[j].freq, expected.freq) <= 0.125);
+                }
+                BOOST_CHECK_EQUAL(buffer[j].confidence,
+                                  float(expected.confidence));
+            }
+
+            // A short buffer gets the first of them
+            if (count > 2) {
+                Pitch two[2];
+                BOOST_CHECK_EQUAL(f.readPitches(i, two, 2), 2);
+                BOOST_CHECK_EQUAL(two[1].time, buffer[1].time);
+            }
+        }
+
+        BOOST_CHECK_EQUAL(p, int(r.pitches.size()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(empty)
+{
+    TempFile tmp;
+    BOOST_REQUIRE(TrackFile::write(tmp.out, rate, step, block, TrackFile::Float,
+                                   NoteHypothesis::Estimates(),
+                                   OfflineAnalyser::Notes()));
+    tmp.finish();
+
+    TrackFile f;
+    BOOST_REQUIRE_MESSAGE(f.open(tmp.path), f.getError());
+    BOOST_CHECK_EQUAL(f.getPitchCount(), 0);
+    BOOST_CHECK_EQUAL(f.getNoteCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(unwritable)
+{
+    Results r = analyse(signal(SignalGenerator::Vibrato, 2.0));
+    BOOST_REQUIRE(!r.notes.empty());
+
+    // Times off the frame grid of the sizes given
+    TempFile a;
+    BOOST_CHECK(!TrackFile::write(a.out, rate, step * 3, block,
+                                  TrackFile::Float, r.pitches, r.notes));
+
+    // Estimates not belonging to any note
+    TempFile b;
+    Results extra = r;
+    extra.pitches.push_back(extra.pitches.back());
+    extra.pitches.back().time =
+        extra.pitches.back().time + RealTime::fromSeconds(10);
+    BOOST_CHECK(!TrackFile::write(b.out, rate, step, block,
+                                  TrackFile::Float, extra.pitches, extra.notes));
+}
+
+BOOST_AUTO_TEST_CASE(unreadable)
+{
+    TrackFile f;
+    BOOST_CHECK(!f.open("/nonexistent/track"));
+    BOOST_CHECK(f.getError() != "");
+    BOOST_CHECK_EQUAL(f.getNoteCount(), 0);
+
+    Results r = analyse(signal(SignalGenerator::Vibrato, 2.0));
+
+    TempFile tmp;
+    BOOST_REQUIRE(TrackFile::write(tmp.out, rate, step, block, TrackFile::Float,
+                                   r.pitches, r.notes));
+    tmp.finish();
+
+    // Truncated
+    BOOST_REQUIRE_EQUAL(truncate(tmp.path.c_str(), tmp.size() - 8), 0);
+    BOOST_CHECK(!f.open(tmp.path));
+    BOOST_CHECK(f.getError().find("Truncated") != std::string::npos);
+
+    // Not a track file at all
+    FILE *out = fopen(tmp.path.c_str(), "wb");
+    BOOST_REQUIRE(out);
+    std::vector<char> junk(200, 'x');
+    fwrite(&junk[0], 1, junk.size(), out);
+    fclose(out);
+    BOOST_CHECK(!f.open(tmp.path));
+    BOOST_CHECK(f.getError().find("Not a track file") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(centsConversion)
+{
+    double hz[] = { 27.5, 55.0, 220.0, 440.0, 1234.5, 4000.0 };
+    for (int i = 0; i < 6; ++i) {
+        double back = TrackFile::centsToHz(TrackFile::hzToCents(hz[i]));
+        BOOST_CHECK(cents(back, hz[i]) <= 0.125);
+    }
+    BOOST_CHECK_EQUAL(TrackFile::hzToCents(440.0), 0);
+    BOOST_CHECK_EQUAL(TrackFile::hzToCents(880.0), 4800);
+    BOOST_CHECK_EQUAL(TrackFile::hzToCents(0.0), -32768);
+}
+
+BOOST_AUTO_TEST_SUITE_END()